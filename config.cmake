@@ -3,6 +3,23 @@ set(MCU atmega328p)
 set(F_CPU 16000000)
 set(BAUD 115200)
 
+# connect the SIM800 to the hardware UART (interrupt driven, buffered) instead of a SoftwareSerial
+# diagnostic output then goes to DEBUG_RX/DEBUG_TX (see config.h) or is switched off
+set(SIM800_HW_UART OFF)
+set(SIM800_BAUD 115200)
+
+# diagnostic output: 0 off, 1 error, 2 warn, 3 info, 4 debug (messages above the level are not compiled)
+set(LOG_LEVEL 4)
+# send log records instead of text, decode them with tools/log-decode.py (saves the format strings in flash)
+set(LOG_BINARY OFF)
+
+# avrnacl implementation of the crypto primitives: small, fast (assembly, larger) or 8bitc (C only)
+set(NACL_VARIANT small)
+# single primitives can be taken from another variant, "make nacl-report" shows the trade-off
+#set(NACL_crypto_hashblocks_sha512 fast)
+# Ed25519 key generation and signing with a comb table for the base point (16 KB more flash, much faster)
+set(NACL_SIGN_COMB OFF)
+
 # set the programmer and the device to use (default is to use simavr)
 #set(PROGRAMMER usbasp)
 set(PROGRAMMER arduino)
@@ -9,6 +9,7 @@
 #define AVRNACL_H
 #define AVRNACL_VERSION "2014-07-XXX"
 
+#ifdef __AVR__
 typedef char crypto_int8;
 typedef unsigned char crypto_uint8;
 typedef int crypto_int16;
@@ -17,6 +18,18 @@ typedef long crypto_int32;
 typedef unsigned long crypto_uint32;
 typedef long long crypto_int64;
 typedef unsigned long long crypto_uint64;
+#else
+/* the same widths on the host (host/CMakeLists.txt) */
+#include <stdint.h>
+typedef int8_t crypto_int8;
+typedef uint8_t crypto_uint8;
+typedef int16_t crypto_int16;
+typedef uint16_t crypto_uint16;
+typedef int32_t crypto_int32;
+typedef uint32_t crypto_uint32;
+typedef int64_t crypto_int64;
+typedef uint64_t crypto_uint64;
+#endif
 
 #define crypto_auth_PRIMITIVE "hmacsha512256"
 #define crypto_auth crypto_auth_hmacsha512256
@@ -85,6 +98,38 @@ extern int crypto_hashblocks_sha512(unsigned char *,const unsigned char *,crypto
 #define crypto_hash_BYTES crypto_hash_sha512_BYTES
 #define crypto_hash_sha512_BYTES 64
 extern int crypto_hash_sha512(unsigned char *,const unsigned char *,crypto_uint16);
+#define crypto_hash_verify crypto_hash_sha512_verify
+extern int crypto_hash_sha512_verify(const unsigned char *,const unsigned char *,crypto_uint16);
+
+#define crypto_hash_state crypto_hash_sha512_state
+#define crypto_hash_init crypto_hash_sha512_init
+#define crypto_hash_update crypto_hash_sha512_update
+#define crypto_hash_final crypto_hash_sha512_final
+typedef struct {
+  unsigned char h[crypto_hashblocks_sha512_STATEBYTES];
+  unsigned char buf[crypto_hashblocks_sha512_BLOCKBYTES];
+  crypto_uint32 bytes;
+} crypto_hash_sha512_state;
+extern int crypto_hash_sha512_init(crypto_hash_sha512_state *);
+extern int crypto_hash_sha512_update(crypto_hash_sha512_state *,const unsigned char *,crypto_uint16);
+extern int crypto_hash_sha512_final(crypto_hash_sha512_state *,unsigned char *);
+
+/* the incremental crypto_auth needs crypto_hash_sha512_state */
+#define crypto_auth_MIDSTATEBYTES crypto_auth_hmacsha512256_MIDSTATEBYTES
+#define crypto_auth_state crypto_auth_hmacsha512256_state
+#define crypto_auth_midstate crypto_auth_hmacsha512256_midstate
+#define crypto_auth_init crypto_auth_hmacsha512256_init
+#define crypto_auth_update crypto_auth_hmacsha512256_update
+#define crypto_auth_final crypto_auth_hmacsha512256_final
+#define crypto_auth_hmacsha512256_MIDSTATEBYTES 128
+typedef struct {
+  crypto_hash_sha512_state inner;
+  unsigned char outer[64];
+} crypto_auth_hmacsha512256_state;
+extern int crypto_auth_hmacsha512256_midstate(unsigned char *,const unsigned char *);
+extern int crypto_auth_hmacsha512256_init(crypto_auth_hmacsha512256_state *,const unsigned char *);
+extern int crypto_auth_hmacsha512256_update(crypto_auth_hmacsha512256_state *,const unsigned char *,crypto_uint16);
+extern int crypto_auth_hmacsha512256_final(crypto_auth_hmacsha512256_state *,unsigned char *);
 
 #define crypto_onetimeauth_PRIMITIVE "poly1305"
 #define crypto_onetimeauth crypto_onetimeauth_poly1305
@@ -137,6 +182,8 @@ extern int crypto_secretbox_xsalsa20poly1305_open(unsigned char *,const unsigned
 #define crypto_sign crypto_sign_ed25519
 #define crypto_sign_open crypto_sign_ed25519_open
 #define crypto_sign_keypair crypto_sign_ed25519_keypair
+#define crypto_sign_open_inplace crypto_sign_ed25519_open_inplace
+#define crypto_sign_verify_detached crypto_sign_ed25519_verify_detached
 #define crypto_sign_BYTES crypto_sign_ed25519_BYTES
 #define crypto_sign_PUBLICKEYBYTES crypto_sign_ed25519_PUBLICKEYBYTES
 #define crypto_sign_SECRETKEYBYTES crypto_sign_ed25519_SECRETKEYBYTES
@@ -146,6 +193,15 @@ extern int crypto_secretbox_xsalsa20poly1305_open(unsigned char *,const unsigned
 extern int crypto_sign_ed25519(unsigned char *,crypto_uint16 *,const unsigned char *,crypto_uint16,const unsigned char *);
 extern int crypto_sign_ed25519_open(unsigned char *,crypto_uint16 *,const unsigned char *,crypto_uint16,const unsigned char *);
 extern int crypto_sign_ed25519_keypair(unsigned char *,unsigned char *);
+extern int crypto_sign_ed25519_open_inplace(const unsigned char *,crypto_uint16,const unsigned char *);
+extern int crypto_sign_ed25519_verify_detached(const unsigned char *,const unsigned char *,crypto_uint16,const unsigned char *);
+
+/* Ed25519ph (RFC 8032): signs the SHA-512 of a message that is passed in parts, of any length */
+#define crypto_sign_ed25519ph_state crypto_hash_sha512_state
+extern int crypto_sign_ed25519ph_init(crypto_sign_ed25519ph_state *);
+extern int crypto_sign_ed25519ph_update(crypto_sign_ed25519ph_state *,const unsigned char *,crypto_uint16);
+extern int crypto_sign_ed25519ph_final_create(crypto_sign_ed25519ph_state *,unsigned char *,const unsigned char *);
+extern int crypto_sign_ed25519ph_final_verify(crypto_sign_ed25519ph_state *,const unsigned char *,const unsigned char *);
 
 #define crypto_stream_PRIMITIVE "xsalsa20"
 #define crypto_stream crypto_stream_xsalsa20
@@ -170,5 +226,7 @@ extern int crypto_verify_16(const unsigned char *,const unsigned char *);
 
 #define crypto_verify_32_BYTES 32
 extern int crypto_verify_32(const unsigned char *,const unsigned char *);
+#define crypto_verify_64_BYTES 64
+extern int crypto_verify_64(const unsigned char *,const unsigned char *);
 
 #endif
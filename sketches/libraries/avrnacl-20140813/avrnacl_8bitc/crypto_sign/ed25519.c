@@ -16,15 +16,21 @@
 #else
 #endif
 
-static void get_hram(unsigned char *hram, const unsigned char *sm, const unsigned char *pk, unsigned char *playground, unsigned long long smlen)
-{
-  unsigned long long i;
-
-  for (i =  0;i < 32;++i)    playground[i] = sm[i];
-  for (i = 32;i < 64;++i)    playground[i] = pk[i-32];
-  for (i = 64;i < smlen;++i) playground[i] = sm[i];
+// dom2(1,"") of Ed25519ph (RFC 8032): the phflag 1 and, as terminating zero, the empty context length
+static const unsigned char dom2_ph[34] = "SigEd25519 no Ed25519 collisions\x01";
 
-  crypto_hash_sha512(hram,playground,smlen);
+// H(dom,R,pk,m), the parts are hashed where they are, no copy of the message is needed
+static void get_hram(unsigned char *hram, const unsigned char *dom, const unsigned char *r, const unsigned char *pk, const unsigned char *m, crypto_uint16 mlen)
+{
+  crypto_hash_sha512_state state;
+
+  crypto_hash_sha512_init(&state);
+  if(dom)
+    crypto_hash_sha512_update(&state,dom,sizeof dom2_ph);
+  crypto_hash_sha512_update(&state,r,32);
+  crypto_hash_sha512_update(&state,pk,32);
+  crypto_hash_sha512_update(&state,m,mlen);
+  crypto_hash_sha512_final(&state,hram);
 }
 
 
@@ -54,11 +60,8 @@ int crypto_sign_ed25519_keypair(
   return 0;
 }
 
-int crypto_sign_ed25519(
-    unsigned char *sm,crypto_uint16 *smlen,
-    const unsigned char *m,crypto_uint16 mlen,
-    const unsigned char *sk
-    )
+// writes R,S to sig
+static void sign_detached(unsigned char *sig, const unsigned char *dom, const unsigned char *m, crypto_uint16 mlen, const unsigned char *sk)
 {
   sc25519 sck, scs, scsk;
   ge25519 ger;
@@ -68,19 +71,20 @@ int crypto_sign_ed25519(
   unsigned long long i;
   unsigned char hmg[crypto_hash_sha512_BYTES]; //64 bytes
   unsigned char hram[crypto_hash_sha512_BYTES]; //64 bytes
+  crypto_hash_sha512_state state;
 
   crypto_hash_sha512(extsk, sk, 32);
   extsk[0] &= 248;
   extsk[31] &= 127;
   extsk[31] |= 64;
 
-  *smlen = mlen+64;
-  for(i=0;i<mlen;i++)
-    sm[64 + i] = m[i];
-  for(i=0;i<32;i++)
-    sm[32 + i] = extsk[32+i];
-
-  crypto_hash_sha512(hmg, sm+32, mlen+32); // Generate k as h(extsk[32],...,extsk[63],m) 
+  // Generate k as h(dom,extsk[32],...,extsk[63],m)
+  crypto_hash_sha512_init(&state);
+  if(dom)
+    crypto_hash_sha512_update(&state, dom, sizeof dom2_ph);
+  crypto_hash_sha512_update(&state, extsk+32, 32);
+  crypto_hash_sha512_update(&state, m, mlen);
+  crypto_hash_sha512_final(&state, hmg);
 
   // Computation of R 
   sc25519_from64bytes(&sck, hmg);
@@ -89,9 +93,9 @@ int crypto_sign_ed25519(
 
   // Computation of s 
   for(i=0;i<32;i++)
-    sm[i] = r[i];
+    sig[i] = r[i];
 
-  get_hram(hram, sm, sk+32, sm, mlen+64);
+  get_hram(hram, dom, r, sk+32, m, mlen);
 
   sc25519_from64bytes(&scs, hram);
   sc25519_from32bytes(&scsk, extsk);
@@ -101,36 +105,78 @@ int crypto_sign_ed25519(
 
   sc25519_to32bytes(s,&scs); // cat s
   for(i=0;i<32;i++)
-    sm[32 + i] = s[i];
+    sig[32 + i] = s[i];
+}
+
+int crypto_sign_ed25519(
+    unsigned char *sm,crypto_uint16 *smlen,
+    const unsigned char *m,crypto_uint16 mlen,
+    const unsigned char *sk
+    )
+{
+  crypto_uint16 i;
+
+  sign_detached(sm, 0, m, mlen, sk);
+
+  for(i=0;i<mlen;i++)
+    sm[64 + i] = m[i];
+  *smlen = mlen+64;
 
   return 0;
 }
 
-int crypto_sign_ed25519_open(
-    unsigned char *m,crypto_uint16 *mlen,
-    const unsigned char *sm,crypto_uint16 smlen,
-    const unsigned char *pk
-    )
+static int verify_detached(const unsigned char *sig, const unsigned char *dom, const unsigned char *m, crypto_uint16 mlen, const unsigned char *pk)
 {
-  unsigned int i, ret;
   unsigned char t2[32];
   ge25519 get1, get2;
   sc25519 schram, scs;
   unsigned char hram[crypto_hash_sha512_BYTES];
 
-  if (smlen < crypto_sign_ed25519_BYTES) return -1;
   if (ge25519_unpackneg_vartime(&get1, pk)) return -1;
 
-  get_hram(hram,sm,pk,m,smlen);
+  get_hram(hram,dom,sig,pk,m,mlen);
 
   sc25519_from64bytes(&schram, hram);
 
-  sc25519_from32bytes(&scs, sm+32);
+  sc25519_from32bytes(&scs, sig+32);
 
   ge25519_double_scalarmult_vartime(&get2, &get1, &schram, &ge25519_base, &scs);
   ge25519_pack(t2, &get2);
 
-  ret = crypto_verify_32(sm, t2);
+  return crypto_verify_32(sig, t2);
+}
+
+int crypto_sign_ed25519_verify_detached(
+    const unsigned char *sig,
+    const unsigned char *m,crypto_uint16 mlen,
+    const unsigned char *pk
+    )
+{
+  return verify_detached(sig, 0, m, mlen, pk);
+}
+
+// verifies sm without copying the message, on success it is at sm+crypto_sign_ed25519_BYTES
+int crypto_sign_ed25519_open_inplace(
+    const unsigned char *sm,crypto_uint16 smlen,
+    const unsigned char *pk
+    )
+{
+  if (smlen < crypto_sign_ed25519_BYTES) return -1;
+  return crypto_sign_ed25519_verify_detached(sm, sm+crypto_sign_ed25519_BYTES, smlen-crypto_sign_ed25519_BYTES, pk);
+}
+
+int crypto_sign_ed25519_open(
+    unsigned char *m,crypto_uint16 *mlen,
+    const unsigned char *sm,crypto_uint16 smlen,
+    const unsigned char *pk
+    )
+{
+  unsigned int i;
+  int ret;
+
+  if (smlen < crypto_sign_ed25519_BYTES) return -1;
+
+  ret = crypto_sign_ed25519_open_inplace(sm, smlen, pk);
 
   if (!ret)
   {
@@ -146,3 +192,48 @@ int crypto_sign_ed25519_open(
   }
   return ret;
 }
+
+/*
+ * Ed25519ph: the message is hashed in parts with SHA-512 and only the hash is
+ * signed, so a message of any length (up to 4 GB) can be signed in one pass,
+ * e.g. while it is read from external memory.
+ */
+
+int crypto_sign_ed25519ph_init(crypto_sign_ed25519ph_state *state)
+{
+  return crypto_hash_sha512_init(state);
+}
+
+int crypto_sign_ed25519ph_update(
+    crypto_sign_ed25519ph_state *state,
+    const unsigned char *m,crypto_uint16 mlen
+    )
+{
+  return crypto_hash_sha512_update(state, m, mlen);
+}
+
+int crypto_sign_ed25519ph_final_create(
+    crypto_sign_ed25519ph_state *state,
+    unsigned char *sig,
+    const unsigned char *sk
+    )
+{
+  unsigned char ph[crypto_hash_sha512_BYTES];
+
+  crypto_hash_sha512_final(state, ph);
+  sign_detached(sig, dom2_ph, ph, sizeof ph, sk);
+
+  return 0;
+}
+
+int crypto_sign_ed25519ph_final_verify(
+    crypto_sign_ed25519ph_state *state,
+    const unsigned char *sig,
+    const unsigned char *pk
+    )
+{
+  unsigned char ph[crypto_hash_sha512_BYTES];
+
+  crypto_hash_sha512_final(state, ph);
+  return verify_detached(sig, dom2_ph, ph, sizeof ph, pk);
+}
@@ -5,10 +5,18 @@
  * Public Domain
  */
 
+#include "avrnacl.h"
 #include "fe25519.h"
 #include "sc25519.h"
 #include "ge25519.h"
 
+#ifdef __AVR__
+  #include <avr/pgmspace.h>
+#else
+  #include <string.h>
+  #define PROGMEM
+  #define memcpy_P memcpy
+#endif
 
 /* 
  * Arithmetic on the twisted Edwards curve -x^2 + y^2 = 1 + dx^2y^2 
@@ -60,10 +68,17 @@ const ge25519 ge25519_base = {{{0x1A, 0xD5, 0x25, 0x8F, 0x60, 0x2D, 0x56, 0xC9,
                               {{0xA3, 0xDD, 0xB7, 0xA5, 0xB3, 0x8A, 0xDE, 0x6D, 0xF5, 0x52, 0x51, 0x77, 0x80, 0x9F, 0xF0, 0x20, 
                                 0x7D, 0xE3, 0xAB, 0x64, 0x8E, 0x4E, 0xEA, 0x66, 0x65, 0x76, 0x8B, 0xD7, 0x0F, 0x5F, 0x87, 0x67}}};
 
+#ifdef GE25519_COMB
+/* Comb table: (k+1)*256^j*B in affine representation for j = 0..31 and k = 0..7 ("precompute comb") */
+static const ge25519_aff ge25519_base_comb[32][8] PROGMEM = {
+#include "ge25519_base_comb.data"
+};
+#else
 /* Multiples of the base point in affine representation */
 static const ge25519_aff ge25519_base_multiples_affine[9] = {
 #include "ge25519_base.data"
 };
+#endif
 
 static void p1p1_to_p2(ge25519_p2 *r, const ge25519_p1p1 *p)
 {
@@ -153,6 +168,37 @@ static unsigned char negative(signed char b)
   return x;
 }
 
+#ifdef GE25519_COMB
+static unsigned char equal(unsigned char b, unsigned char c)
+{
+  crypto_uint32 x = b ^ c; /* 0: yes; 1..255: no */
+  x -= 1; /* 4294967295: yes; 0..254: no */
+  x >>= 31; /* 1: yes; 0: no */
+  return x;
+}
+
+/* Constant time: all 8 multiples at position pos are read from flash and the one
+ * selected by |b| is moved into t with fe25519_cmov, b = 0 gives the neutral element */
+static void choose_comb(ge25519_aff *t, unsigned char pos, signed char b)
+{
+  ge25519_aff v;
+  unsigned char u, k;
+  signed char const mask = b >> 7;
+  u = (b + mask) ^ mask;
+
+  fe25519_setzero(&t->x);
+  fe25519_setone(&t->y);
+  for(k=0;k<8;k++)
+  {
+    memcpy_P(&v, &ge25519_base_comb[pos][k], sizeof(ge25519_aff));
+    fe25519_cmov(&t->x, &v.x, equal(u, k+1));
+    fe25519_cmov(&t->y, &v.y, equal(u, k+1));
+  }
+
+  fe25519_neg(&v.x, &t->x);
+  fe25519_cmov(&t->x, &v.x, negative(b));
+}
+#else
 static void choose_t(ge25519_aff *t, signed char b)
 {
   fe25519 v;
@@ -165,6 +211,7 @@ static void choose_t(ge25519_aff *t, signed char b)
   fe25519_neg(&v, &t->x);
   fe25519_cmov(&t->x, &v, negative(b));
 }
+#endif
 
 static void setneutral(ge25519 *r)
 {
@@ -287,6 +334,41 @@ void ge25519_double_scalarmult_vartime(ge25519_p3 *r, const ge25519_p3 *p1, cons
   }
 }
 
+#ifdef GE25519_COMB
+/* Comb with signed radix-16 digits b[i]: s*B is the sum of b[2j+1]*256^j*B, times 16,
+ * plus the sum of b[2j]*256^j*B. 64 additions of table entries and 4 doublings instead
+ * of 63 additions and 252 doublings, for 16 KB of tables in flash. */
+void ge25519_scalarmult_base(ge25519_p3 *r, const sc25519 *s)
+{
+  signed char b[64];
+  unsigned char i;
+  ge25519_aff t;
+  ge25519_p1p1 tp1p1;
+  sc25519_window4(b,s);
+
+  setneutral(r);
+  for(i=1;i<64;i+=2)
+  {
+    choose_comb(&t, i>>1, b[i]);
+    ge25519_mixadd2(r, &t);
+  }
+
+  dbl_p1p1(&tp1p1, (ge25519_p2 *)r);
+  p1p1_to_p2((ge25519_p2 *)r, &tp1p1);
+  dbl_p1p1(&tp1p1, (ge25519_p2 *)r);
+  p1p1_to_p2((ge25519_p2 *)r, &tp1p1);
+  dbl_p1p1(&tp1p1, (ge25519_p2 *)r);
+  p1p1_to_p2((ge25519_p2 *)r, &tp1p1);
+  dbl_p1p1(&tp1p1, (ge25519_p2 *)r);
+  p1p1_to_p3(r, &tp1p1);
+
+  for(i=0;i<64;i+=2)
+  {
+    choose_comb(&t, i>>1, b[i]);
+    ge25519_mixadd2(r, &t);
+  }
+}
+#else
 void ge25519_scalarmult_base(ge25519_p3 *r, const sc25519 *s)
 {
   signed char b[64];
@@ -314,4 +396,4 @@ void ge25519_scalarmult_base(ge25519_p3 *r, const sc25519 *s)
     ge25519_mixadd2(r, &t);
   }
 }
-
+#endif
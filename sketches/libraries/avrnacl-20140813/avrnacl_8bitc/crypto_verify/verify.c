@@ -36,3 +36,11 @@ int crypto_verify_32(
 {
   return vn(x,y,32);
 }
+
+int crypto_verify_64(
+    const unsigned char *x,
+    const unsigned char *y
+    )
+{
+  return vn(x,y,64);
+}
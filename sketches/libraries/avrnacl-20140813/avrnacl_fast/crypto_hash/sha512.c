@@ -52,3 +52,111 @@ int crypto_hash_sha512(
 
   return 0;
 }
+
+/*
+ * Incremental interface: the message can be passed in several parts (e.g. R, pk
+ * and m of an Ed25519 signature) without copying them into one buffer first.
+ * Full blocks are hashed directly from the input, only a partial block is kept
+ * in the state.
+ */
+
+int crypto_hash_sha512_init(crypto_hash_sha512_state *state)
+{
+  unsigned char i;
+
+  for(i=0;i<64;i++)
+    state->h[i] = avrnacl_sha512_iv[i];
+  state->bytes = 0;
+
+  return 0;
+}
+
+int crypto_hash_sha512_update(
+    crypto_hash_sha512_state *state,
+    const unsigned char *m,crypto_uint16 mlen
+    )
+{
+  crypto_uint16 i;
+  unsigned char fill = state->bytes & 127;
+
+  state->bytes += mlen;
+
+  if(fill)
+  {
+    while(mlen && fill < 128)
+    {
+      state->buf[fill++] = *m++;
+      mlen--;
+    }
+    if(fill < 128)
+      return 0;
+    crypto_hashblocks_sha512(state->h,state->buf,128);
+  }
+
+  crypto_hashblocks_sha512(state->h,m,mlen);
+  m += mlen;
+  mlen &= 127;
+  m -= mlen;
+
+  for(i=0;i<mlen;i++)
+    state->buf[i] = m[i];
+
+  return 0;
+}
+
+/* pad and hash the last block(s), the hash is left in state->h */
+static void finish(crypto_hash_sha512_state *state)
+{
+  unsigned char i, fill = state->bytes & 127;
+
+  state->buf[fill++] = 128;
+  if(fill > 112)
+  {
+    for(i=fill;i<128;i++)
+      state->buf[i] = 0;
+    crypto_hashblocks_sha512(state->h,state->buf,128);
+    fill = 0;
+  }
+
+  for(i=fill;i<123;i++)
+    state->buf[i] = 0;
+  state->buf[123] = state->bytes >> 29;
+  state->buf[124] = state->bytes >> 21;
+  state->buf[125] = state->bytes >> 13;
+  state->buf[126] = state->bytes >> 5;
+  state->buf[127] = state->bytes << 3;
+
+  crypto_hashblocks_sha512(state->h,state->buf,128);
+}
+
+int crypto_hash_sha512_final(
+    crypto_hash_sha512_state *state,
+    unsigned char *out
+    )
+{
+  unsigned char i;
+
+  finish(state);
+  for(i=0;i<64;i++)
+    out[i] = state->h[i];
+
+  return 0;
+}
+
+/*
+ * Check that h is the hash of m: 0 if it is, -1 else. The hash is compared in
+ * constant time (crypto_verify_64) where it is computed, in the state on the stack.
+ */
+int crypto_hash_sha512_verify(
+    const unsigned char *h,
+    const unsigned char *m,crypto_uint16 mlen
+    )
+{
+  crypto_hash_sha512_state state;
+
+  crypto_hash_sha512_init(&state);
+  crypto_hash_sha512_update(&state,m,mlen);
+  finish(&state);
+
+  return crypto_verify_64(state.h,h);
+}
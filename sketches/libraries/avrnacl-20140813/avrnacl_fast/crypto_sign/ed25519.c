@@ -13,15 +13,21 @@
 
 #include <avr/pgmspace.h>
 
-static void get_hram(unsigned char *hram, const unsigned char *sm, const unsigned char *pk, unsigned char *playground, crypto_uint16 smlen)
-{
-  crypto_uint16 i;
-
-  for (i =  0;i < 32;++i)    playground[i] = sm[i];
-  for (i = 32;i < 64;++i)    playground[i] = pk[i-32];
-  for (i = 64;i < smlen;++i) playground[i] = sm[i];
+// dom2(1,"") of Ed25519ph (RFC 8032): the phflag 1 and, as terminating zero, the empty context length
+static const unsigned char dom2_ph[34] = "SigEd25519 no Ed25519 collisions\x01";
 
-  crypto_hash_sha512(hram,playground,smlen);
+// H(dom,R,pk,m), the parts are hashed where they are, no copy of the message is needed
+static void get_hram(unsigned char *hram, const unsigned char *dom, const unsigned char *r, const unsigned char *pk, const unsigned char *m, crypto_uint16 mlen)
+{
+  crypto_hash_sha512_state state;
+
+  crypto_hash_sha512_init(&state);
+  if(dom)
+    crypto_hash_sha512_update(&state,dom,sizeof dom2_ph);
+  crypto_hash_sha512_update(&state,r,32);
+  crypto_hash_sha512_update(&state,pk,32);
+  crypto_hash_sha512_update(&state,m,mlen);
+  crypto_hash_sha512_final(&state,hram);
 }
 
 
@@ -52,58 +58,66 @@ int crypto_sign_ed25519_keypair(
   return 0;
 }
 
-static void generate_sck(unsigned char *sm, sc25519 *sck, sc25519 *scsk, const unsigned char *m, const unsigned char *sk, unsigned char mlen) 
+static void generate_sck(sc25519 *sck, sc25519 *scsk, const unsigned char *dom, const unsigned char *m, const unsigned char *sk, crypto_uint16 mlen) 
 {
   unsigned char extsk[64];
   const unsigned char *sk_RAM = sk;
   unsigned char hmg[crypto_hash_sha512_BYTES]; //64 bytes
-  unsigned char i;
+  crypto_hash_sha512_state state;
   
   crypto_hash_sha512(extsk, sk_RAM, 32);
   extsk[0] &= 248;
   extsk[31] &= 127;
   extsk[31] |= 64;
   
-  for(i=0;i<mlen;i++)
-    sm[64 + i] = m[i];
-  for(i=0;i<32;i++)
-    sm[32 + i] = extsk[32+i];
-	
-  crypto_hash_sha512(hmg, sm+32, mlen+32); // Generate k as h(extsk[32],...,extsk[63],m) 
+  // Generate k as h(dom,extsk[32],...,extsk[63],m) 
+  crypto_hash_sha512_init(&state);
+  if(dom)
+    crypto_hash_sha512_update(&state, dom, sizeof dom2_ph);
+  crypto_hash_sha512_update(&state, extsk+32, 32);
+  crypto_hash_sha512_update(&state, m, mlen);
+  crypto_hash_sha512_final(&state, hmg);
   sc25519_from64bytes(sck, hmg);
   sc25519_from32bytes(scsk, extsk);
 }
 
-static void generate_scs(sc25519 *scs, unsigned char *sm, const unsigned char *pk, unsigned char mlen) 
+static void generate_scs(sc25519 *scs, const unsigned char *dom, const unsigned char *r, const unsigned char *pk, const unsigned char *m, crypto_uint16 mlen) 
 {
   unsigned char hmg[crypto_hash_sha512_BYTES]; //64 bytes
-  get_hram(hmg, sm, pk, sm, mlen+64);
+  get_hram(hmg, dom, r, pk, m, mlen);
   sc25519_from64bytes(scs, hmg);
 }
 
-int crypto_sign_ed25519(
-    unsigned char *sm, crypto_uint16 *smlen,
-    const unsigned char *m, crypto_uint16 mlen,
-    const unsigned char *sk
-    )
-{	
-  crypto_uint16 i;
+// writes R,S to sig
+static void sign_detached(unsigned char *sig, const unsigned char *dom, const unsigned char *m, crypto_uint16 mlen, const unsigned char *sk)
+{
   sc25519 sck, scs, scsk;
   ge25519 ger;
   
-  generate_sck(sm, &sck, &scsk, m, sk, mlen); 
+  generate_sck(&sck, &scsk, dom, m, sk, mlen); 
  
   ge25519_scalarmult_base(&ger, &sck);
 
-  ge25519_pack(sm, &ger);
+  ge25519_pack(sig, &ger);
 
-  generate_scs(&scs, sm, sk+32, mlen);
+  generate_scs(&scs, dom, sig, sk+32, m, mlen);
   
   sc25519_mul(&scs, &scs, &scsk);
 
   sc25519_add(&scs, &scs, &sck);
 
-  sc25519_to32bytes(sm+32,&scs);
+  sc25519_to32bytes(sig+32,&scs);
+}
+
+int crypto_sign_ed25519(
+    unsigned char *sm, crypto_uint16 *smlen,
+    const unsigned char *m, crypto_uint16 mlen,
+    const unsigned char *sk
+    )
+{	
+  crypto_uint16 i;
+
+  sign_detached(sm, 0, m, mlen, sk);
 
   for(i=0;i<mlen;i++)
     sm[i+64] = m[i];
@@ -112,35 +126,61 @@ int crypto_sign_ed25519(
   return 0;
 }
 
-static void generate_schram(sc25519 *schram, const unsigned char *sm, const unsigned char *pk, crypto_uint16 smlen, unsigned char *m) {
+static void generate_schram(sc25519 *schram, const unsigned char *dom, const unsigned char *sig, const unsigned char *pk, const unsigned char *m, crypto_uint16 mlen) {
   unsigned char hram[crypto_hash_sha512_BYTES]; //64 bytes
-  get_hram(hram, sm, pk, m, smlen);
+  get_hram(hram, dom, sig, pk, m, mlen);
   sc25519_from64bytes(schram, hram);
 }
 
-int crypto_sign_ed25519_open(
-    unsigned char *m,crypto_uint16 *mlen,
-    const unsigned char *sm,crypto_uint16 smlen,
-    const unsigned char *pk
-    )
+static int verify_detached(const unsigned char *sig, const unsigned char *dom, const unsigned char *m, crypto_uint16 mlen, const unsigned char *pk)
 {
-  crypto_uint16 i;
-  int ret;
   ge25519 get1, get2;
   sc25519 schram, scs;
-  
-  if (smlen < crypto_sign_ed25519_BYTES) return -1;
+
   if (ge25519_unpackneg_vartime(&get1, pk)) return -1;
 
-  generate_schram(&schram, sm, pk, smlen, m);
+  generate_schram(&schram, dom, sig, pk, m, mlen);
 
-  sc25519_from32bytes(&scs, sm+32);
+  sc25519_from32bytes(&scs, sig+32);
 
   ge25519_double_scalarmult_vartime(&get2, &get1, &schram, &scs); 
   //now reuse variable get1..
   ge25519_pack(get1.x.v, &get2); 
 
-  ret = crypto_verify_32(sm, get1.x.v);
+  return crypto_verify_32(sig, get1.x.v);
+}
+
+int crypto_sign_ed25519_verify_detached(
+    const unsigned char *sig,
+    const unsigned char *m,crypto_uint16 mlen,
+    const unsigned char *pk
+    )
+{
+  return verify_detached(sig, 0, m, mlen, pk);
+}
+
+// verifies sm without copying the message, on success it is at sm+crypto_sign_ed25519_BYTES
+int crypto_sign_ed25519_open_inplace(
+    const unsigned char *sm,crypto_uint16 smlen,
+    const unsigned char *pk
+    )
+{
+  if (smlen < crypto_sign_ed25519_BYTES) return -1;
+  return crypto_sign_ed25519_verify_detached(sm, sm+crypto_sign_ed25519_BYTES, smlen-crypto_sign_ed25519_BYTES, pk);
+}
+
+int crypto_sign_ed25519_open(
+    unsigned char *m,crypto_uint16 *mlen,
+    const unsigned char *sm,crypto_uint16 smlen,
+    const unsigned char *pk
+    )
+{
+  crypto_uint16 i;
+  int ret;
+  
+  if (smlen < crypto_sign_ed25519_BYTES) return -1;
+
+  ret = crypto_sign_ed25519_open_inplace(sm, smlen, pk);
 
   if (!ret)
   {
@@ -156,3 +196,48 @@ int crypto_sign_ed25519_open(
   }
   return ret;
 }
+
+/*
+ * Ed25519ph: the message is hashed in parts with SHA-512 and only the hash is
+ * signed, so a message of any length (up to 4 GB) can be signed in one pass,
+ * e.g. while it is read from external memory.
+ */
+
+int crypto_sign_ed25519ph_init(crypto_sign_ed25519ph_state *state)
+{
+  return crypto_hash_sha512_init(state);
+}
+
+int crypto_sign_ed25519ph_update(
+    crypto_sign_ed25519ph_state *state,
+    const unsigned char *m,crypto_uint16 mlen
+    )
+{
+  return crypto_hash_sha512_update(state, m, mlen);
+}
+
+int crypto_sign_ed25519ph_final_create(
+    crypto_sign_ed25519ph_state *state,
+    unsigned char *sig,
+    const unsigned char *sk
+    )
+{
+  unsigned char ph[crypto_hash_sha512_BYTES];
+
+  crypto_hash_sha512_final(state, ph);
+  sign_detached(sig, dom2_ph, ph, sizeof ph, sk);
+
+  return 0;
+}
+
+int crypto_sign_ed25519ph_final_verify(
+    crypto_sign_ed25519ph_state *state,
+    const unsigned char *sig,
+    const unsigned char *pk
+    )
+{
+  unsigned char ph[crypto_hash_sha512_BYTES];
+
+  crypto_hash_sha512_final(state, ph);
+  return verify_detached(sig, dom2_ph, ph, sizeof ph, pk);
+}
@@ -5,6 +5,7 @@
  * Public Domain
  */
 
+#include "avrnacl.h"
 #include "fe25519.h"
 #include "sc25519.h"
 #include "ge25519.h"
@@ -62,10 +63,17 @@ const ge25519 ge25519_base PROGMEM = {{{0x1A, 0xD5, 0x25, 0x8F, 0x60, 0x2D, 0x56
                                 0x7D, 0xE3, 0xAB, 0x64, 0x8E, 0x4E, 0xEA, 0x66, 0x65, 0x76, 0x8B, 0xD7, 0x0F, 0x5F, 0x87, 0x67}}};
 
 
+#ifdef GE25519_COMB
+/* Comb table: (k+1)*256^j*B in affine representation for j = 0..31 and k = 0..7 ("precompute comb") */
+static const ge25519_aff ge25519_base_comb[32][8] PROGMEM = {
+#include "ge25519_base_comb.data"
+};
+#else
 /* Multiples of the base point in affine representation */
 static const ge25519_aff ge25519_base_multiples_affine[9] PROGMEM = {
 #include "ge25519_base.data"
 };
+#endif
 
 static void p1p1_to_p2(ge25519_p2 *r, const ge25519_p1p1 *p)
 {
@@ -101,6 +109,9 @@ static void ge25519_mixadd2(ge25519_p3 *r, const ge25519_aff *q)
   fe25519_mul(&r->y,&h,&a);
   fe25519_mul(&r->z,&a,&f);
   /* fe25519_mul(&r->t,&e,&h); // Can remove this multiplication, as t is not used in doubling */
+#ifdef GE25519_COMB
+  fe25519_mul(&r->t,&e,&h); /* the comb adds without doubling in between */
+#endif
 }
 
 static void add_p1p1(ge25519_p1p1 *r, const ge25519_p3 *p, const ge25519_p3 *q)
@@ -147,6 +158,38 @@ static unsigned char negative(signed char b)
   return x;
 }
 
+#ifdef GE25519_COMB
+static unsigned char equal(unsigned char b, unsigned char c)
+{
+  crypto_uint32 x = b ^ c; /* 0: yes; 1..255: no */
+  x -= 1; /* 4294967295: yes; 0..254: no */
+  x >>= 31; /* 1: yes; 0: no */
+  return x;
+}
+
+/* Constant time: all 8 multiples at position pos are read from flash and the one
+ * selected by |b| is moved into t with fe25519_cmov, b = 0 gives the neutral element */
+static void choose_comb(ge25519_aff *t, unsigned char pos, signed char b)
+{
+  ge25519_aff v;
+  unsigned char u, k;
+  signed char mask = (*(unsigned char *)&b) >> 7;
+  mask = -mask;
+  u = (b + mask) ^ mask;
+
+  fe25519_setzero(&t->x);
+  fe25519_setone(&t->y);
+  for(k=0;k<8;k++)
+  {
+    memcpy_P(&v, &ge25519_base_comb[pos][k], sizeof(ge25519_aff));
+    fe25519_cmov(&t->x, &v.x, equal(u, k+1));
+    fe25519_cmov(&t->y, &v.y, equal(u, k+1));
+  }
+
+  fe25519_neg(&v.x, &t->x);
+  fe25519_cmov(&t->x, &v.x, negative(b));
+}
+#else
 static void choose_t(ge25519_aff *t, ge25519_aff *base_multiples, signed char b)
 {
   fe25519 v;
@@ -168,6 +211,7 @@ static void choose_t(ge25519_aff *t, ge25519_aff *base_multiples, signed char b)
   fe25519_neg(&v, &t->x);
   fe25519_cmov(&t->x, &v, negative(b));
 }
+#endif
 
 static void setneutral(ge25519 *r)
 {
@@ -301,6 +345,41 @@ void ge25519_double_scalarmult_vartime(ge25519_p3 *r, const ge25519_p3 *p1, cons
   }
 }
 
+#ifdef GE25519_COMB
+/* Comb with signed radix-16 digits b[i]: s*B is the sum of b[2j+1]*256^j*B, times 16,
+ * plus the sum of b[2j]*256^j*B. 64 additions of table entries and 4 doublings instead
+ * of 63 additions and 252 doublings, for 16 KB of tables in flash. */
+void ge25519_scalarmult_base(ge25519_p3 *r, const sc25519 *s)
+{
+  signed char b[64];
+  unsigned char i;
+  ge25519_aff t;
+  ge25519_p1p1 tp1p1;
+  sc25519_window4(b,s);
+
+  setneutral(r);
+  for(i=1;i<64;i+=2)
+  {
+    choose_comb(&t, i>>1, b[i]);
+    ge25519_mixadd2(r, &t);
+  }
+
+  dbl_p1p1(&tp1p1, (ge25519_p2 *)r);
+  p1p1_to_p2((ge25519_p2 *)r, &tp1p1);
+  dbl_p1p1(&tp1p1, (ge25519_p2 *)r);
+  p1p1_to_p2((ge25519_p2 *)r, &tp1p1);
+  dbl_p1p1(&tp1p1, (ge25519_p2 *)r);
+  p1p1_to_p2((ge25519_p2 *)r, &tp1p1);
+  dbl_p1p1(&tp1p1, (ge25519_p2 *)r);
+  p1p1_to_p3(r, &tp1p1);
+
+  for(i=0;i<64;i+=2)
+  {
+    choose_comb(&t, i>>1, b[i]);
+    ge25519_mixadd2(r, &t);
+  }
+}
+#else
 void ge25519_scalarmult_base(ge25519_p3 *r, const sc25519 *s)
 {
   signed char b[64];
@@ -333,4 +412,4 @@ void ge25519_scalarmult_base(ge25519_p3 *r, const sc25519 *s)
     ge25519_mixadd2(r, &t);
   }  
 }
-
+#endif
@@ -6,12 +6,17 @@
  */
 
 #include <stdio.h>
+#include <string.h>
 #include "ge25519.h"
 #include "fe25519.h"
 
 #define WINDOWSIZE 4
 #define NMULTIPLES ((1<<(WINDOWSIZE-1))+1) /* 0*P,...,(2^(WINDOWSIZE-1))*P */
 
+/* ge25519_base_comb.data (GE25519_COMB): 1*P,...,8*P for P = 256^j*B, j = 0,...,31 */
+#define COMBPOSITIONS 32
+#define COMBMULTIPLES 8
+
 /* 2*d */
 static const fe25519 ge25519_ec2d = {{0x59, 0xF1, 0xB2, 0x26, 0x94, 0x9B, 0xD6, 0xEB, 0x56, 0xB1, 0x83, 0x82, 0x9A, 0x14, 0xE0, 0x00, 
                        0x30, 0xD1, 0xF3, 0xEE, 0xF2, 0x80, 0x8E, 0x19, 0xE7, 0xFC, 0xDF, 0x56, 0xDC, 0xD9, 0x06, 0x24}};
@@ -65,9 +70,13 @@ static void ge25519_mixadd2(ge25519 *r, const ge25519 *q)
   fe25519_mul(&r->t, &e, &h);
 }
 
-static void printpoint(const ge25519 *p)
+static void printpoint(const ge25519 *r)
 {
+  ge25519 t = *r;
+  const ge25519 *p = &t;
   int i;
+  fe25519_freeze(&t.x);
+  fe25519_freeze(&t.y);
   printf("{{{");
   for(i=0;i<31;i++)
     printf("0x%02x, ", p->x.v[i]);
@@ -77,11 +86,40 @@ static void printpoint(const ge25519 *p)
   printf("0x%02x}}},\n", p->y.v[31]);
 }
 
-int main()
+/* usage: precompute > ge25519_base.data
+ *        precompute comb > ge25519_base_comb.data */
+int main(int argc, char **argv)
 {
-  ge25519 t;
+  ge25519 t, p, q;
 
-  int i;
+  int i, j;
+
+  if(argc > 1 && !strcmp(argv[1], "comb"))
+  {
+    p = base;
+    for(j=0;j<COMBPOSITIONS;j++)
+    {
+      printf("{\n");
+      t = p;
+      printpoint(&t);
+      for(i=2;i<=COMBMULTIPLES;i++)
+      {
+        ge25519_mixadd2(&t, &p);
+        makeaffine(&t);
+        printpoint(&t);
+      }
+      printf("},\n");
+
+      /* p = 256*p, the addition formula is complete, so it also doubles */
+      for(i=0;i<8;i++)
+      {
+        q = p;
+        ge25519_mixadd2(&p, &q);
+        makeaffine(&p);
+      }
+    }
+    return 0;
+  }
 
   setneutral(&t);
   printpoint(&t);
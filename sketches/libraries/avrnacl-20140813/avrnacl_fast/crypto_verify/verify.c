@@ -12,21 +12,15 @@
 
 #include "avrnacl.h"
 
-static int vn(const unsigned char *x,const unsigned char *y,char n)
-{
-  crypto_uint8 i;
-  crypto_uint16 d = 0;
-  for(i=0;i<n;i++) 
-    d |= x[i]^y[i];
-  return (1 & ((d - 1) >> 8)) - 1;
-}
+/* crypto_verify/verify_core.S, n is the number of 8-byte words */
+extern int avrnacl_verify_n(const unsigned char *x,const unsigned char *y,unsigned char n);
 
 int crypto_verify_16(
     const unsigned char *x,
     const unsigned char *y
     )
 {
-  return vn(x,y,16);
+  return avrnacl_verify_n(x,y,2);
 }
 
 int crypto_verify_32(
@@ -34,5 +28,13 @@ int crypto_verify_32(
     const unsigned char *y
     )
 {
-  return vn(x,y,32);
+  return avrnacl_verify_n(x,y,4);
+}
+
+int crypto_verify_64(
+    const unsigned char *x,
+    const unsigned char *y
+    )
+{
+  return avrnacl_verify_n(x,y,8);
 }
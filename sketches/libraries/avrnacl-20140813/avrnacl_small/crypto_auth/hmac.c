@@ -85,3 +85,71 @@ int crypto_auth_hmacsha512256_verify(
   crypto_auth_hmacsha512256(correct,in,inlen,k);
   return crypto_verify_32(h,correct);
 }
+
+/*
+ * Incremental interface with a cached key midstate: the key blocks (k ^ ipad and
+ * k ^ opad) are hashed once by crypto_auth_hmacsha512256_midstate, the 128 byte
+ * result can be kept (e.g. in EEPROM) and used for any number of messages. Each
+ * tag then costs the message blocks and one block of the outer hash.
+ */
+
+int crypto_auth_hmacsha512256_midstate(
+    unsigned char *midstate,
+    const unsigned char *k
+    )
+{
+  unsigned char padded[128];
+  unsigned int i;
+
+  for (i = 0;i < 64;++i) midstate[i] = midstate[64 + i] = avrnacl_sha512_iv[i];
+
+  for (i = 0;i < 32;++i) padded[i] = k[i] ^ 0x36;
+  for (i = 32;i < 128;++i) padded[i] = 0x36;
+  blocks(midstate,padded,128);
+
+  for (i = 0;i < 32;++i) padded[i] = k[i] ^ 0x5c;
+  for (i = 32;i < 128;++i) padded[i] = 0x5c;
+  blocks(midstate + 64,padded,128);
+
+  return 0;
+}
+
+int crypto_auth_hmacsha512256_init(
+    crypto_auth_hmacsha512256_state *state,
+    const unsigned char *midstate
+    )
+{
+  unsigned int i;
+
+  for (i = 0;i < 64;++i) state->inner.h[i] = midstate[i];
+  for (i = 0;i < 64;++i) state->outer[i] = midstate[64 + i];
+  state->inner.bytes = 128;
+
+  return 0;
+}
+
+int crypto_auth_hmacsha512256_update(
+    crypto_auth_hmacsha512256_state *state,
+    const unsigned char *in,crypto_uint16 inlen
+    )
+{
+  return crypto_hash_sha512_update(&state->inner,in,inlen);
+}
+
+int crypto_auth_hmacsha512256_final(
+    crypto_auth_hmacsha512256_state *state,
+    unsigned char *out
+    )
+{
+  unsigned int i;
+
+  /* the inner hash is the first block of the outer message, after the key block */
+  crypto_hash_sha512_final(&state->inner,state->inner.buf);
+  for (i = 0;i < 64;++i) state->inner.h[i] = state->outer[i];
+  state->inner.bytes = 128 + 64;
+  crypto_hash_sha512_final(&state->inner,state->inner.buf);
+
+  for (i = 0;i < 32;++i) out[i] = state->inner.buf[i];
+
+  return 0;
+}
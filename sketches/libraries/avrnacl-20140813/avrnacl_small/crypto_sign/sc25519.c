@@ -106,6 +106,31 @@ void sc25519_window2(signed char r[128], const sc25519 *s)
 
 
 
+#ifdef GE25519_COMB
+void sc25519_window4(signed char r[64], const sc25519 *s)
+{
+  char carry;
+  unsigned char i;
+  for(i=0;i<32;i++)
+  {
+    r[2*i]   = s->v[i] & 15;
+    r[2*i+1] = s->v[i] >> 4;
+  }
+
+  /* Making it signed */
+  carry = 0;
+  for(i=0;i<63;i++)
+  {
+    r[i] += carry;
+    r[i+1] += r[i] >> 4;
+    r[i] &= 15;
+    carry = r[i] >> 3;
+    r[i] -= carry << 4;
+  }
+  r[63] += carry;
+}
+#endif
+
 void sc25519_2interleave1(unsigned char r[255], const sc25519 *s1, const sc25519 *s2)
 {
   unsigned char i;
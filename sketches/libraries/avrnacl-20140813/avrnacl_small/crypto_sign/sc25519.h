@@ -8,6 +8,7 @@
 #define sc25519_add avrnacl_sc25519_add
 #define sc25519_mul avrnacl_sc25519_mul
 #define sc25519_window2 avrnacl_sc25519_window2
+#define sc25519_window4 avrnacl_sc25519_window4
 #define sc25519_2interleave1 avrnacl_sc25519_2interleave1
 
 typedef struct 
@@ -30,6 +31,8 @@ void sc25519_mul(sc25519 *r, const sc25519 *x, const sc25519 *y);
 
 void sc25519_window2(signed char r[64], const sc25519 *s);
 
+void sc25519_window4(signed char r[64], const sc25519 *s);
+
 void sc25519_2interleave1(unsigned char r[255], const sc25519 *s1, const sc25519 *s2);
 
 #endif
@@ -0,0 +1,38 @@
+# cmake -DPROGRAM=<test program> -DCHECKSUM=<test/checksums file> [-DSIMAVR=<output in simavr>] -P check.cmake
+#
+# The test passes if the program prints no error and the checksum of test/checksums, and
+# the program of the same variant printed the same checksum in simavr.
+
+execute_process(COMMAND ${PROGRAM} OUTPUT_VARIABLE output RESULT_VARIABLE result)
+message("${output}")
+if (NOT result EQUAL 0 OR output MATCHES "ERROR: ")
+  message(FATAL_ERROR "${PROGRAM} failed (${result})")
+endif ()
+
+# the checksum is printed last, run_test.sh takes the rest of the output
+function(checksum output variable)
+  if (NOT output MATCHES "Checksum: ([0-9a-f]+)")
+    message(FATAL_ERROR "no checksum in ${output}")
+  endif ()
+  set(${variable} ${CMAKE_MATCH_1} PARENT_SCOPE)
+endfunction()
+
+checksum("${output}" host)
+file(STRINGS ${CHECKSUM} expected LIMIT_COUNT 1)
+if (NOT host STREQUAL expected)
+  message(FATAL_ERROR "wrong checksum ${host}, expected ${expected}")
+endif ()
+
+if (SIMAVR)
+  if (NOT EXISTS ${SIMAVR})
+    message(FATAL_ERROR "${SIMAVR} is missing, run the nacl-test target")
+  endif ()
+  file(READ ${SIMAVR} avr)
+  if (avr MATCHES "ERROR: [^\n]*")
+    message(FATAL_ERROR "simavr: ${CMAKE_MATCH_0}")
+  endif ()
+  checksum("${avr}" avr)
+  if (NOT host STREQUAL avr)
+    message(FATAL_ERROR "checksum ${host} differs from ${avr} in simavr")
+  endif ()
+endif ()
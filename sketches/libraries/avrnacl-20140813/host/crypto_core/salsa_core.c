@@ -0,0 +1,96 @@
+/*
+ * File:    host/crypto_core/salsa_core.c
+ * C versions of crypto_core/salsa_core.S of avrnacl_small and avrnacl_fast
+ * Public Domain
+ */
+
+#include "avrnacl.h"
+
+static crypto_uint32 load32(const unsigned char *x)
+{
+  return (crypto_uint32) x[0] | ((crypto_uint32) x[1] << 8) | ((crypto_uint32) x[2] << 16) | ((crypto_uint32) x[3] << 24);
+}
+
+static void store32(unsigned char *r, crypto_uint32 x)
+{
+  r[0] = x & 0xff;
+  r[1] = (x >> 8) & 0xff;
+  r[2] = (x >> 16) & 0xff;
+  r[3] = x >> 24;
+}
+
+static crypto_uint32 rotate(crypto_uint32 u, int c)
+{
+  return (u << c) | (u >> (32 - c));
+}
+
+static void quarterround(crypto_uint32 *y0, crypto_uint32 *y1, crypto_uint32 *y2, crypto_uint32 *y3)
+{
+  *y1 ^= rotate(*y0 + *y3, 7);
+  *y2 ^= rotate(*y1 + *y0, 9);
+  *y3 ^= rotate(*y2 + *y1, 13);
+  *y0 ^= rotate(*y3 + *y2, 18);
+}
+
+/* xj: the state x (64 bytes) followed by its copy j (64 bytes) */
+void avrnacl_init_core(unsigned char *xj, const unsigned char *c, const unsigned char *k, const unsigned char *in)
+{
+  unsigned char i;
+  for(i=0;i<4;i++)
+  {
+    xj[i] = c[i];
+    xj[20+i] = c[4+i];
+    xj[40+i] = c[8+i];
+    xj[60+i] = c[12+i];
+  }
+  for(i=0;i<16;i++)
+  {
+    xj[4+i] = k[i];
+    xj[24+i] = in[i];
+    xj[44+i] = k[16+i];
+  }
+  for(i=0;i<64;i++)
+    xj[64+i] = xj[i];
+}
+
+/* out = rounds(x) + j */
+void avrnacl_calc_rounds(unsigned char *xj, unsigned char *out, int rounds)
+{
+  crypto_uint32 x[16];
+  unsigned char i;
+  for(i=0;i<16;i++)
+    x[i] = load32(xj + 4*i);
+
+  for(;rounds>0;rounds-=2)
+  {
+    quarterround(&x[0], &x[4], &x[8], &x[12]);
+    quarterround(&x[5], &x[9], &x[13], &x[1]);
+    quarterround(&x[10], &x[14], &x[2], &x[6]);
+    quarterround(&x[15], &x[3], &x[7], &x[11]);
+    quarterround(&x[0], &x[1], &x[2], &x[3]);
+    quarterround(&x[5], &x[6], &x[7], &x[4]);
+    quarterround(&x[10], &x[11], &x[8], &x[9]);
+    quarterround(&x[15], &x[12], &x[13], &x[14]);
+  }
+
+  for(i=0;i<16;i++)
+  {
+    store32(xj + 4*i, x[i]);
+    store32(out + 4*i, x[i] + load32(xj + 64 + 4*i));
+  }
+}
+
+/* the words 0, 5, 10, 15, 6, 7, 8, 9 of the rounds, j (c and in) is subtracted from tmp again;
+ * in and c are read before out is written, out may overlap them */
+void avrnacl_hsalsa20(unsigned char *out, unsigned char *tmp, const unsigned char *in, const unsigned char *c)
+{
+  crypto_uint32 r[8];
+  unsigned char i;
+  for(i=0;i<4;i++)
+  {
+    r[i] = load32(tmp + 20*i) - load32(c + 4*i);
+    r[4+i] = load32(tmp + 24 + 4*i) - load32(in + 4*i);
+  }
+  for(i=0;i<8;i++)
+    store32(out + 4*i, r[i]);
+}
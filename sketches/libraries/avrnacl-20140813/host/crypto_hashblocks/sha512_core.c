@@ -0,0 +1,88 @@
+/*
+ * File:    host/crypto_hashblocks/sha512_core.c
+ * C versions of crypto_hashblocks/sha512_core.S of avrnacl_small and avrnacl_fast,
+ * a myu64 is a little-endian 64-bit integer
+ * Public Domain
+ */
+
+#include "avrnacl.h"
+
+typedef struct{
+  unsigned char v[8];
+} myu64;
+
+static crypto_uint64 load64(const myu64 *x)
+{
+  crypto_uint64 r = 0;
+  int i;
+  for(i=7;i>=0;i--)
+    r = (r << 8) | x->v[i];
+  return r;
+}
+
+static void store64(myu64 *r, crypto_uint64 x)
+{
+  int i;
+  for(i=0;i<8;i++)
+  {
+    r->v[i] = x & 0xff;
+    x >>= 8;
+  }
+}
+
+static crypto_uint64 ror(crypto_uint64 x, unsigned char c)
+{
+  c &= 63;
+  return c ? (x >> c) | (x << (64 - c)) : x;
+}
+
+/* length 8-byte words from big endian to little endian (and back) */
+void avrnacl_myu64_convert_bigendian(unsigned char *r, const unsigned char *x, unsigned char length)
+{
+  unsigned char i, j;
+  for(i=0;i<length;i++)
+    for(j=0;j<8;j++)
+      r[8*i+j] = x[8*i+7-j];
+}
+
+void avrnacl_Ch(myu64 *r, const myu64 *x, const myu64 *y, const myu64 *z)
+{
+  crypto_uint64 a = load64(x);
+  store64(r, (a & load64(y)) ^ (~a & load64(z)));
+}
+
+void avrnacl_Maj(myu64 *r, const myu64 *x, const myu64 *y, const myu64 *z)
+{
+  crypto_uint64 a = load64(x), b = load64(y), c = load64(z);
+  store64(r, (a & b) ^ (a & c) ^ (b & c));
+}
+
+/* the second rotation continues from the first: ror(x,c1) ^ ror(x,c2) ^ ror(x,c2+c3) */
+void avrnacl_Sigma(myu64 *r, const myu64 *x, unsigned char c1, unsigned char c2, unsigned char c3)
+{
+  crypto_uint64 a = load64(x);
+  store64(r, ror(a, c1) ^ ror(a, c2) ^ ror(ror(a, c2), c3));
+}
+
+/* ror(x,c1) ^ ror(x,c2) ^ (x >> c3) */
+void avrnacl_sigma(myu64 *r, const myu64 *x, unsigned char c1, unsigned char c2, unsigned char c3)
+{
+  crypto_uint64 a = load64(x);
+  store64(r, ror(a, c1) ^ ror(a, c2) ^ (a >> c3));
+}
+
+void avrnacl_M(myu64 *w0, const myu64 *w14, const myu64 *w9, const myu64 *w1)
+{
+  myu64 s0, s1;
+  avrnacl_sigma(&s0, w1, 1, 8, 7);
+  avrnacl_sigma(&s1, w14, 19, 61, 6);
+  store64(w0, load64(w0) + load64(w9) + load64(&s0) + load64(&s1));
+}
+
+/* the next 16 words of the message schedule, in place */
+void avrnacl_expand(myu64 *w)
+{
+  unsigned char i;
+  for(i=0;i<16;i++)
+    avrnacl_M(w+i, w+((i+14)&15), w+((i+9)&15), w+((i+1)&15));
+}
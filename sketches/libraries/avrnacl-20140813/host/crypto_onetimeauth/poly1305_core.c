@@ -0,0 +1,69 @@
+/*
+ * File:    host/crypto_onetimeauth/poly1305_core.c
+ * C version of crypto_onetimeauth/poly1305_core.S of avrnacl_small and avrnacl_fast
+ * (the loop of avrnacl_8bitc/crypto_onetimeauth/poly1305.c), the result h is below
+ * 2^133 and only equal to that of the assembly modulo 2^130-5
+ * Public Domain
+ */
+
+#include "avrnacl.h"
+#include "bigint.h"
+
+static void add(unsigned char h[17], const unsigned char x[17])
+{
+  crypto_uint16 t = 0;
+  unsigned char i;
+  for(i=0;i<17;i++)
+  {
+    t = h[i] + x[i] + (t >> 8);
+    h[i] = t & 0xff;
+  }
+}
+
+static void mulmod(unsigned char h[17], const unsigned char r[17], unsigned char hr[34])
+{
+  crypto_uint16 t;
+  unsigned char i, k;
+
+  bigint_mul(hr,h,r,17);
+
+  /* 2^130 = 5 modulo 2^130-5 */
+  for(i=16;i<32;i++)
+  {
+    t = ((hr[i] >> 2) | ((hr[i+1] & 0x3) << 6)) * 5;
+    hr[i] &= 0x3;
+    hr[i+1] &= 0xfc;
+    for(k=i-16;k<17;k++)
+    {
+      t += hr[k];
+      hr[k] = t & 0xff;
+      t >>= 8;
+    }
+  }
+  hr[16] += (hr[32] >> 2) * 5;
+
+  for(i=0;i<17;i++)
+    h[i] = hr[i];
+}
+
+void avrnacl_onetimeauth_loop(unsigned char *r, unsigned char *h, unsigned char *hr, const unsigned char *in, unsigned int inlen)
+{
+  unsigned char c[17];
+  unsigned char j;
+
+  for(j=0;j<17;j++)
+    h[j] = 0;
+
+  while(inlen > 0)
+  {
+    for(j=0;j<17;j++)
+      c[j] = 0;
+    for(j=0;(j<16) && (j<inlen);j++)
+      c[j] = in[j];
+    c[j] = 1;
+    in += j;
+    inlen -= j;
+    add(h,c);
+    mulmod(h,r,hr);
+  }
+}
@@ -0,0 +1,16 @@
+/*
+ * File:    host/crypto_verify/verify_core.c
+ * C version of crypto_verify/verify_core.S of avrnacl_fast
+ * Public Domain
+ */
+
+#include "avrnacl.h"
+
+int avrnacl_verify_n(const unsigned char *x, const unsigned char *y, unsigned char n)
+{
+  crypto_uint16 d = 0;
+  crypto_uint16 i;
+  for(i=0;i<8*(crypto_uint16)n;i++)
+    d |= x[i]^y[i];
+  return (1 & ((d - 1) >> 8)) - 1;
+}
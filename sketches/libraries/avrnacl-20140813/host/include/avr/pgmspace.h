@@ -0,0 +1,16 @@
+/*
+ * File:    host/include/avr/pgmspace.h
+ * The program memory of the sources of small and fast is plain memory on the host
+ * Public Domain
+ */
+
+#ifndef HOST_PGMSPACE_H
+#define HOST_PGMSPACE_H
+
+#include <string.h>
+
+#define PROGMEM
+#define pgm_read_byte(p) (*(const unsigned char *)(p))
+#define memcpy_P memcpy
+
+#endif
@@ -0,0 +1,67 @@
+/*
+ * File:    host/ops.c
+ * Counts the field operations of crypto_sign_keypair, crypto_sign and crypto_sign_open, so the
+ * comb of ge25519_scalarmult_base (GE25519_COMB) can be compared with the default without a
+ * board: linked with -Wl,--wrap for the fe25519 functions below, which every variant calls
+ * across object files
+ * Public Domain
+ */
+
+#include <stdio.h>
+#include "avrnacl.h"
+#include "fe25519.h"
+
+static unsigned long muls, squares, adds;
+
+void __real_avrnacl_fe25519_mul(fe25519 *r, const fe25519 *x, const fe25519 *y);
+void __real_avrnacl_fe25519_square(fe25519 *r, const fe25519 *x);
+void __real_avrnacl_fe25519_add(fe25519 *r, const fe25519 *x, const fe25519 *y);
+void __real_avrnacl_fe25519_sub(fe25519 *r, const fe25519 *x, const fe25519 *y);
+
+void __wrap_avrnacl_fe25519_mul(fe25519 *r, const fe25519 *x, const fe25519 *y)
+{
+  muls++;
+  __real_avrnacl_fe25519_mul(r, x, y);
+}
+
+void __wrap_avrnacl_fe25519_square(fe25519 *r, const fe25519 *x)
+{
+  squares++;
+  __real_avrnacl_fe25519_square(r, x);
+}
+
+void __wrap_avrnacl_fe25519_add(fe25519 *r, const fe25519 *x, const fe25519 *y)
+{
+  adds++;
+  __real_avrnacl_fe25519_add(r, x, y);
+}
+
+void __wrap_avrnacl_fe25519_sub(fe25519 *r, const fe25519 *x, const fe25519 *y)
+{
+  adds++;
+  __real_avrnacl_fe25519_sub(r, x, y);
+}
+
+static void report(const char *name)
+{
+  printf("%-16s mul %5lu  square %5lu  add/sub %5lu\n", name, muls, squares, adds);
+  muls = squares = adds = 0;
+}
+
+int main(void)
+{
+  unsigned char pk[crypto_sign_PUBLICKEYBYTES], sk[crypto_sign_SECRETKEYBYTES];
+  unsigned char sm[crypto_sign_BYTES + 32], m[crypto_sign_BYTES + 32];
+  crypto_uint16 smlen, mlen;
+  unsigned char i;
+
+  for (i = 0; i < 32; i++) m[i] = i;
+
+  crypto_sign_keypair(pk, sk);
+  report("crypto_sign_keypair");
+  crypto_sign(sm, &smlen, m, 32, sk);
+  report("crypto_sign");
+  if (crypto_sign_open(m, &mlen, sm, smlen, pk) != 0) return 1;
+  report("crypto_sign_open");
+  return 0;
+}
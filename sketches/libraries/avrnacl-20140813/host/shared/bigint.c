@@ -0,0 +1,135 @@
+/*
+ * File:    host/shared/bigint.c
+ * C versions of shared/bigint_*.S of avrnacl_small and avrnacl_fast
+ * Public Domain
+ */
+
+#include "avrnacl.h"
+#include "bigint.h"
+
+char bigint_add(unsigned char* r, const unsigned char* a, const unsigned char* b, int length)
+{
+  int i;
+  crypto_uint16 tmp = 0;
+  for(i=0;i<length;i++)
+  {
+    tmp = a[i] + b[i] + tmp;
+    r[i] = tmp & 0xff;
+    tmp >>= 8;
+  }
+  return (char)tmp;
+}
+
+char bigint_sub(unsigned char* r, const unsigned char* a, const unsigned char* b, int length)
+{
+  int i;
+  crypto_uint16 tmp = 0;
+  for(i=0;i<length;i++)
+  {
+    tmp = a[i] - b[i] - tmp;
+    r[i] = tmp & 0xff;
+    tmp >>= 15;
+  }
+  return (char)tmp;
+}
+
+char bigint_xor(unsigned char* r, const unsigned char* a, const unsigned char* b, int length)
+{
+  int i;
+  for(i=0;i<length;i++)
+    r[i] = a[i] ^ b[i];
+  return 0;
+}
+
+/* The 64-bit functions work on little-endian integers (myu64 of crypto_hashblocks) */
+
+static crypto_uint64 load64(const unsigned char *x)
+{
+  crypto_uint64 r = 0;
+  int i;
+  for(i=7;i>=0;i--)
+    r = (r << 8) | x[i];
+  return r;
+}
+
+static void store64(unsigned char *r, crypto_uint64 x)
+{
+  int i;
+  for(i=0;i<8;i++)
+  {
+    r[i] = x & 0xff;
+    x >>= 8;
+  }
+}
+
+char bigint_add64(unsigned char* r, const unsigned char* a, const unsigned char* b)
+{
+  return bigint_add(r,a,b,8);
+}
+
+char bigint_and64(unsigned char* r, const unsigned char* a, const unsigned char* b)
+{
+  store64(r, load64(a) & load64(b));
+  return 0;
+}
+
+char bigint_xor64(unsigned char* r, const unsigned char* a, const unsigned char* b)
+{
+  return bigint_xor(r,a,b,8);
+}
+
+char bigint_not64(unsigned char* r, const unsigned char* a)
+{
+  store64(r, ~load64(a));
+  return 0;
+}
+
+char bigint_ror64(unsigned char* r, unsigned char length)
+{
+  crypto_uint64 x = load64(r);
+  length &= 63;
+  if(length)
+    x = (x >> length) | (x << (64 - length));
+  store64(r, x);
+  return 0;
+}
+
+char bigint_shr64(unsigned char* r, unsigned char length)
+{
+  store64(r, length < 64 ? load64(r) >> length : 0);
+  return 0;
+}
+
+void bigint_mul(unsigned char* r, const unsigned char* a, const unsigned char* b, int length)
+{
+  int i,j;
+  crypto_uint16 t;
+  for(i=0;i<2*length;i++)
+    r[i] = 0;
+
+  for(i=0;i<length;i++)
+  {
+    t = 0;
+    for(j=0;j<length;j++)
+    {
+      t = r[i+j] + a[i]*b[j] + (t >> 8);
+      r[i+j] = t & 0xff;
+    }
+    r[i+length] = t >> 8;
+  }
+}
+
+void bigint_mul128(unsigned char* r, const unsigned char* a, const unsigned char* b)
+{
+  bigint_mul(r,a,b,16);
+}
+
+void bigint_mul136(unsigned char* r, const unsigned char* a, const unsigned char* b)
+{
+  bigint_mul(r,a,b,17);
+}
+
+void bigint_mul256(unsigned char* r, const unsigned char* a, const unsigned char* b)
+{
+  bigint_mul(r,a,b,32);
+}
@@ -0,0 +1,74 @@
+/*
+ * File:    host/shared/fe25519.c
+ * C versions of shared/fe25519_{add,sub,red}.S of avrnacl_small and avrnacl_fast,
+ * the same steps modulo 2^256-38, so the results are the same bytes
+ * Public Domain
+ */
+
+#include "avrnacl.h"
+#include "fe25519.h"
+
+void fe25519_add(fe25519 *r, const fe25519 *x, const fe25519 *y)
+{
+  crypto_uint16 tmp = 0;
+  unsigned char i;
+  for(i=0;i<32;i++)
+  {
+    tmp = x->v[i] + y->v[i] + (tmp >> 8);
+    r->v[i] = tmp & 0xff;
+  }
+  tmp = (tmp >> 8) * 38;
+  for(i=0;i<32;i++)
+  {
+    tmp = r->v[i] + tmp;
+    r->v[i] = tmp & 0xff;
+    tmp >>= 8;
+  }
+  r->v[0] += tmp * 38;
+}
+
+void fe25519_sub(fe25519 *r, const fe25519 *x, const fe25519 *y)
+{
+  crypto_uint16 tmp = 0;
+  unsigned char i;
+  for(i=0;i<32;i++)
+  {
+    tmp = x->v[i] - y->v[i] - tmp;
+    r->v[i] = tmp & 0xff;
+    tmp >>= 15;
+  }
+  tmp *= 38;
+  for(i=0;i<32;i++)
+  {
+    tmp = r->v[i] - tmp;
+    r->v[i] = tmp & 0xff;
+    tmp >>= 15;
+  }
+  r->v[0] -= tmp * 38;
+}
+
+/* r = C mod 2^256-38 for the 512-bit product C */
+void fe25519_red(fe25519 *r, unsigned char *C)
+{
+  crypto_uint16 tmp = 0;
+  unsigned char i;
+  for(i=0;i<32;i++)
+  {
+    tmp = C[i] + 38*C[i+32] + (tmp >> 8);
+    r->v[i] = tmp & 0xff;
+  }
+  tmp = (tmp >> 8) * 38;
+  for(i=0;i<32;i++)
+  {
+    tmp = r->v[i] + tmp;
+    r->v[i] = tmp & 0xff;
+    tmp >>= 8;
+  }
+  tmp *= 38;
+  for(i=0;i<2;i++)
+  {
+    tmp = r->v[i] + tmp;
+    r->v[i] = tmp & 0xff;
+    tmp >>= 8;
+  }
+}
@@ -0,0 +1,13 @@
+/*
+ * File:    host/test/avr.c
+ * test/avr.h on the host: the program returns after avr_end(), fail() exits with -1
+ * Public Domain
+ */
+
+#include <stdio.h>
+#include "avr.h"
+
+void avr_end()
+{
+  fflush(stdout);
+}
@@ -0,0 +1,53 @@
+/*
+ * File:    host/test/print.c
+ * test/print.h on the host, the output goes to stdout instead of the UART
+ * Public Domain
+ */
+
+#include <stdio.h>
+#include "print.h"
+
+void serial_init(void)
+{
+}
+
+void serial_write(unsigned char c)
+{
+  putchar(c);
+}
+
+void print(const char *s)
+{
+  fputs(s, stdout);
+}
+
+void print_bytes(const unsigned char *x, unsigned int xlen)
+{
+  unsigned int i;
+  for (i=0; i<xlen; i++)
+    printf("%02x ", x[i]);
+}
+
+void printllu(unsigned long long x)
+{
+  printf("%llu", x);
+}
+
+void print_speed(const char *primitive, const unsigned int bytes, const unsigned long long *t, unsigned int tlen)
+{
+  unsigned int i;
+  printf("%s: ", primitive);
+  if(bytes != (unsigned int)-1)
+    printf("[%u] ", bytes);
+  for(i=0;i<tlen-1;i++)
+    printf("%llu ", t[i+1]-t[i]);
+  printf("\n");
+}
+
+void print_stack(const char *primitive, const unsigned int bytes, unsigned int stack)
+{
+  printf("%s: ", primitive);
+  if(bytes != (unsigned int)-1)
+    printf("[%u] ", bytes);
+  printf("%u stack bytes\n", stack);
+}
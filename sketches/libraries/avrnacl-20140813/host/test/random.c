@@ -0,0 +1,26 @@
+/*
+ * File:    host/test/random.c
+ * random() of avr-libc (Park-Miller, seed 1) instead of the one of the C library, the padding
+ * bytes of test_crypto_box.c end up in its messages, so its checksum depends on them
+ * Public Domain
+ */
+
+#include <stdlib.h>
+
+static unsigned long next = 1;
+
+long random(void)
+{
+  long hi, lo, x;
+
+  x = next;
+  if (x == 0)
+    x = 123459876L;
+  hi = x / 127773L;
+  lo = x % 127773L;
+  x = 16807L * lo - 2836L * hi;
+  if (x < 0)
+    x += 0x7fffffffL;
+  next = x;
+  return x % (0x7fffffffUL + 1);
+}
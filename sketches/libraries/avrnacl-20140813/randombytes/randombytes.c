@@ -10,7 +10,15 @@
  * by D. J. Bernstein
  */
 
+/* a fixed sequence for the test programs (test/checksums), the sketches link the
+ * entropy pool of sketches/libraries/common/entropy.c instead */
+
+#ifdef __AVR__
 typedef unsigned long uint32;
+#else
+#include <stdint.h>
+typedef uint32_t uint32;
+#endif
 
 static uint32 seed[32] = { 3,1,4,1,5,9,2,6,5,3,5,8,9,7,9,3,2,3,8,4,6,2,6,4,3,3,8,3,2,7,9,5 } ;
 static uint32 in[12];
@@ -13,6 +13,7 @@ speed: test/speed_crypto_scalarmult_curve25519.hex \
  			 test/speed_crypto_hash_sha512.hex \
  			 test/speed_crypto_verify_16.hex \
  			 test/speed_crypto_verify_32.hex \
+ 			 test/speed_crypto_verify_64.hex \
  			 test/speed_crypto_secretbox_xsalsa20poly1305.hex \
  			 test/speed_crypto_box_curve25519xsalsa20poly1305.hex \
  			 test/speed_crypto_sign_ed25519.hex
@@ -41,6 +42,10 @@ test/speed_crypto_verify_32: ../test/speed_crypto_verify.c $(SPEEDHELPERC) $(SPE
 	mkdir -p test/
 	$(CC) $(CFLAGS) ../test/speed_crypto_verify.c $(SPEEDHELPERC) obj/randombytes.o obj/libnacl.a -o $@ -DNRUNS=10 -DPRIMITIVE=32
 
+test/speed_crypto_verify_64: ../test/speed_crypto_verify.c $(SPEEDHELPERC) $(SPEEDHELPERH) obj/randombytes.o obj/libnacl.a
+	mkdir -p test/
+	$(CC) $(CFLAGS) ../test/speed_crypto_verify.c $(SPEEDHELPERC) obj/randombytes.o obj/libnacl.a -o $@ -DNRUNS=10 -DPRIMITIVE=64
+
 test/speed_crypto_scalarmult_curve25519: ../test/speed_crypto_scalarmult.c $(SPEEDHELPERC) $(SPEEDHELPERH) obj/randombytes.o obj/libnacl.a
 	mkdir -p test/
 	$(CC) $(CFLAGS) ../test/speed_crypto_scalarmult.c $(SPEEDHELPERC) obj/randombytes.o obj/libnacl.a -o $@ -DNRUNS=10 -DPRIMITIVE=curve25519
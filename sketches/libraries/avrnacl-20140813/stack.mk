@@ -15,7 +15,8 @@ stack: test/stack_crypto_scalarmult_curve25519.hex \
  			 test/stack_crypto_stream_xsalsa20.hex \
  			 test/stack_crypto_sign_ed25519.hex \
  			 test/stack_crypto_verify_16.hex \
- 			 test/stack_crypto_verify_32.hex
+ 			 test/stack_crypto_verify_32.hex \
+ 			 test/stack_crypto_verify_64.hex
 
 test/stack_crypto_stream_salsa20: ../test/stack_crypto_stream.c $(STACKHELPERC) $(STACKHELPERH) obj/randombytes.o obj/libnacl.a
 	mkdir -p test/
@@ -41,6 +42,10 @@ test/stack_crypto_verify_32: ../test/stack_crypto_verify.c $(STACKHELPERC) $(STA
 	mkdir -p test/
 	$(CC) $(CFLAGS) ../test/stack_crypto_verify.c $(STACKHELPERC) obj/randombytes.o obj/libnacl.a -o $@ -DPRIMITIVE=32
 
+test/stack_crypto_verify_64: ../test/stack_crypto_verify.c $(STACKHELPERC) $(STACKHELPERH) obj/randombytes.o obj/libnacl.a
+	mkdir -p test/
+	$(CC) $(CFLAGS) ../test/stack_crypto_verify.c $(STACKHELPERC) obj/randombytes.o obj/libnacl.a -o $@ -DPRIMITIVE=64
+
 test/stack_crypto_scalarmult_curve25519: ../test/stack_crypto_scalarmult.c $(STACKHELPERC) $(STACKHELPERH) obj/randombytes.o obj/libnacl.a
 	mkdir -p test/
 	$(CC) $(CFLAGS) ../test/stack_crypto_scalarmult.c $(STACKHELPERC) obj/randombytes.o obj/libnacl.a -o $@ -DPRIMITIVE=curve25519
@@ -7,6 +7,7 @@ test: test/test_crypto_stream_salsa20.hex \
  			test/test_crypto_core_hsalsa20.hex \
  			test/test_crypto_verify_16.hex \
  			test/test_crypto_verify_32.hex \
+ 			test/test_crypto_verify_64.hex \
  			test/test_crypto_scalarmult_curve25519.hex \
  			test/test_crypto_dh_curve25519.hex \
  			test/test_crypto_hashblocks_sha512.hex \
@@ -42,6 +43,10 @@ test/test_crypto_verify_32: ../test/test_crypto_verify.c $(TESTHELPERC) $(TESTHE
 	mkdir -p test/
 	$(CC) $(CFLAGS) ../test/test_crypto_verify.c $(TESTHELPERC) obj/randombytes.o obj/libnacl.a -o $@ -DPRIMITIVE=32
 
+test/test_crypto_verify_64: ../test/test_crypto_verify.c $(TESTHELPERC) $(TESTHELPERH) obj/randombytes.o obj/libnacl.a
+	mkdir -p test/
+	$(CC) $(CFLAGS) ../test/test_crypto_verify.c $(TESTHELPERC) obj/randombytes.o obj/libnacl.a -o $@ -DPRIMITIVE=64
+
 test/test_crypto_scalarmult_curve25519: ../test/test_crypto_scalarmult.c $(TESTHELPERC) $(TESTHELPERH) obj/randombytes.o obj/libnacl.a
 	mkdir -p test/
 	$(CC) $(CFLAGS) ../test/test_crypto_scalarmult.c $(TESTHELPERC) obj/randombytes.o obj/libnacl.a -o $@ -DPRIMITIVE=curve25519
@@ -8,8 +8,19 @@
 #include "avr.h"
 #include "print.h"
 
+#ifdef SIMAVR
+#include <avr/interrupt.h>
+#include <avr/sleep.h>
+#endif
+
 void avr_end()
 {
   serial_write(4);
+#ifdef SIMAVR
+  /* simavr quits on a sleep with interrupts disabled */
+  cli();
+  sleep_enable();
+  sleep_cpu();
+#endif
   while(1) {};
 }
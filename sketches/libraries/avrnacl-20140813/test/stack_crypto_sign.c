@@ -15,6 +15,7 @@
 #undef crypto_sign
 #undef crypto_sign_open
 #undef crypto_sign_keypair
+#undef crypto_sign_open_inplace
 #undef crypto_sign_SECRETKEYBYTES
 #undef crypto_sign_PUBLICKEYBYTES
 #undef crypto_sign_BYTES
@@ -29,6 +30,7 @@
 #define crypto_sign                XCONCAT(crypto_sign_,PRIMITIVE)
 #define crypto_sign_open           XCONCAT3(crypto_sign_,PRIMITIVE,_open)
 #define crypto_sign_keypair        XCONCAT3(crypto_sign_,PRIMITIVE,_keypair)
+#define crypto_sign_open_inplace   XCONCAT3(crypto_sign_,PRIMITIVE,_open_inplace)
 #define crypto_sign_SECRETKEYBYTES XCONCAT3(crypto_sign_,PRIMITIVE,_SECRETKEYBYTES)
 #define crypto_sign_PUBLICKEYBYTES XCONCAT3(crypto_sign_,PRIMITIVE,_PUBLICKEYBYTES)
 #define crypto_sign_BYTES          XCONCAT3(crypto_sign_,PRIMITIVE,_BYTES)
@@ -122,6 +124,15 @@ int main(void)
       ctr = (newctr>ctr)?newctr:ctr;
     }
     print_stack(XSTR(crypto_sign_open),smlen,ctr);
+    for(i=0;i<5;i++)
+    {
+      canary = random();
+      WRITE_CANARY(&a);
+      crypto_sign_open_inplace(sm,smlen,pk);
+      newctr =(unsigned int)&a - (unsigned int)&_end - stack_count(canary);
+      ctr = (newctr>ctr)?newctr:ctr;
+    }
+    print_stack(XSTR(crypto_sign_open_inplace),smlen,ctr);
   }
 
   avr_end();
@@ -21,6 +21,12 @@
 #undef crypto_auth_verify
 #undef crypto_auth_BYTES
 #undef crypto_auth_KEYBYTES
+#undef crypto_auth_MIDSTATEBYTES
+#undef crypto_auth_state
+#undef crypto_auth_midstate
+#undef crypto_auth_init
+#undef crypto_auth_update
+#undef crypto_auth_final
 
 #define CONCAT(x,y) x ## y
 #define CONCAT3(x,y,z) x ## y ## z
@@ -31,6 +37,12 @@
 #define crypto_auth_verify      XCONCAT3(crypto_auth_,PRIMITIVE,_verify)
 #define crypto_auth_BYTES       XCONCAT3(crypto_auth_,PRIMITIVE,_BYTES)
 #define crypto_auth_KEYBYTES    XCONCAT3(crypto_auth_,PRIMITIVE,_KEYBYTES)
+#define crypto_auth_MIDSTATEBYTES XCONCAT3(crypto_auth_,PRIMITIVE,_MIDSTATEBYTES)
+#define crypto_auth_state       XCONCAT3(crypto_auth_,PRIMITIVE,_state)
+#define crypto_auth_midstate    XCONCAT3(crypto_auth_,PRIMITIVE,_midstate)
+#define crypto_auth_init        XCONCAT3(crypto_auth_,PRIMITIVE,_init)
+#define crypto_auth_update      XCONCAT3(crypto_auth_,PRIMITIVE,_update)
+#define crypto_auth_final       XCONCAT3(crypto_auth_,PRIMITIVE,_final)
 
 #define MAXTEST_BYTES 256
 
@@ -50,6 +62,9 @@ static unsigned char *h2;
 static unsigned char *m2;
 static unsigned char *k2;
 
+static unsigned char midstate[crypto_auth_MIDSTATEBYTES];
+static crypto_auth_state state;
+
 char checksum[crypto_auth_BYTES * 2 + 1];
 
 int main (void)
@@ -100,6 +115,14 @@ int main (void)
     for (j = -16;j < 0;++j) if (h[j] != h2[j]) fail("crypto_auth writes before output");
     for (j = hlen;j < hlen + 16;++j) if (h[j] != h2[j]) fail("crypto_auth writes after output");
 
+    if (crypto_auth_midstate(midstate,k) != 0) fail("crypto_auth_midstate returns nonzero");
+    if (crypto_auth_init(&state,midstate) != 0) fail("crypto_auth_init returns nonzero");
+    if (crypto_auth_update(&state,m,mlen / 3) != 0) fail("crypto_auth_update returns nonzero");
+    if (crypto_auth_update(&state,m + mlen / 3,mlen - mlen / 3) != 0) fail("crypto_auth_update returns nonzero");
+    if (crypto_auth_final(&state,h2) != 0) fail("crypto_auth_final returns nonzero");
+    for (j = 0;j < hlen;++j) if (h2[j] != h[j]) fail("crypto_auth_update does not match crypto_auth");
+    for (j = hlen;j < hlen + 16;++j) if (h2[j] != h[j]) fail("crypto_auth_final writes after output");
+
     for (j = -16;j < 0;++j) h[j] = random();
     for (j = -16;j < 0;++j) k[j] = random();
     for (j = -16;j < 0;++j) m[j] = random();
@@ -19,6 +19,11 @@
 
 #undef crypto_hash
 #undef crypto_hash_BYTES
+#undef crypto_hash_state
+#undef crypto_hash_init
+#undef crypto_hash_update
+#undef crypto_hash_final
+#undef crypto_hash_verify
 
 #define CONCAT(x,y) x ## y
 #define CONCAT3(x,y,z) x ## y ## z
@@ -27,6 +32,11 @@
 
 #define crypto_hash             XCONCAT(crypto_hash_,PRIMITIVE)
 #define crypto_hash_BYTES XCONCAT3(crypto_hash_,PRIMITIVE,_BYTES)
+#define crypto_hash_state       XCONCAT3(crypto_hash_,PRIMITIVE,_state)
+#define crypto_hash_init        XCONCAT3(crypto_hash_,PRIMITIVE,_init)
+#define crypto_hash_update      XCONCAT3(crypto_hash_,PRIMITIVE,_update)
+#define crypto_hash_final       XCONCAT3(crypto_hash_,PRIMITIVE,_final)
+#define crypto_hash_verify      XCONCAT3(crypto_hash_,PRIMITIVE,_verify)
 
 #define MAXTEST_BYTES (1024 + crypto_hash_BYTES)
 
@@ -35,6 +45,8 @@ static unsigned char *h2;
 static unsigned char *m;
 static unsigned char *m2;
 
+static crypto_hash_state state;
+
 char checksum[crypto_hash_BYTES * 2 + 1];
 
 int main(void)
@@ -71,6 +83,16 @@ int main(void)
     for (j = -16;j < mlen + 16;++j) if (m2[j] != m[j]) fail("crypto_hash writes to input");
     for (j = -16;j < 0;++j) if (h2[j] != h[j]) fail("crypto_hash writes before output");
     for (j = hlen;j < hlen + 16;++j) if (h2[j] != h[j]) fail("crypto_hash writes after output");
+    if (crypto_hash_init(&state) != 0) fail("crypto_hash_init returns nonzero");
+    if (crypto_hash_update(&state,m,mlen / 3) != 0) fail("crypto_hash_update returns nonzero");
+    if (crypto_hash_update(&state,m + mlen / 3,mlen - mlen / 3) != 0) fail("crypto_hash_update returns nonzero");
+    if (crypto_hash_final(&state,h2) != 0) fail("crypto_hash_final returns nonzero");
+    for (j = 0;j < hlen;++j) if (h2[j] != h[j]) fail("crypto_hash_update does not match crypto_hash");
+    for (j = hlen;j < hlen + 16;++j) if (h2[j] != h[j]) fail("crypto_hash_final writes after output");
+    if (crypto_hash_verify(h,m,mlen) != 0) fail("crypto_hash_verify rejects the hash");
+    h[i % hlen] ^= 1 << (i & 7);
+    if (crypto_hash_verify(h,m,mlen) != -1) fail("crypto_hash_verify accepts a forged hash");
+    h[i % hlen] ^= 1 << (i & 7);
     if (crypto_hash(m2,m2,mlen) != 0) fail("crypto_hash returns nonzero");
     for (j = 0;j < hlen;++j) if (m2[j] != h[j]) fail("crypto_hash does not handle overlap");
     for (j = 0;j < mlen;++j) m[j] ^= h[j % hlen];
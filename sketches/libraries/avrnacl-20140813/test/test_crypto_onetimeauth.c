@@ -147,12 +147,12 @@ int main(void)
   print(checksum);
   print("\n");
 
-  h  += 16;
-  m  += 16;
-  k  += 16;
-  h2 += 16;
-  m2 += 16;
-  k2 += 16;
+  h  -= 16;
+  m  -= 16;
+  k  -= 16;
+  h2 -= 16;
+  m2 -= 16;
+  k2 -= 16;
 
   free(h);
   free(m);
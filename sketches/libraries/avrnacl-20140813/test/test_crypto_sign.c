@@ -20,6 +20,13 @@
 #undef crypto_sign
 #undef crypto_sign_open
 #undef crypto_sign_keypair
+#undef crypto_sign_open_inplace
+#undef crypto_sign_verify_detached
+#undef crypto_sign_ph_state
+#undef crypto_sign_ph_init
+#undef crypto_sign_ph_update
+#undef crypto_sign_ph_final_create
+#undef crypto_sign_ph_final_verify
 #undef crypto_sign_SECRETKEYBYTES
 #undef crypto_sign_PUBLICKEYBYTES
 #undef crypto_sign_BYTES
@@ -32,6 +39,13 @@
 #define crypto_sign                XCONCAT(crypto_sign_,PRIMITIVE)
 #define crypto_sign_open           XCONCAT3(crypto_sign_,PRIMITIVE,_open)
 #define crypto_sign_keypair        XCONCAT3(crypto_sign_,PRIMITIVE,_keypair)
+#define crypto_sign_open_inplace   XCONCAT3(crypto_sign_,PRIMITIVE,_open_inplace)
+#define crypto_sign_verify_detached XCONCAT3(crypto_sign_,PRIMITIVE,_verify_detached)
+#define crypto_sign_ph_state       XCONCAT3(crypto_sign_,PRIMITIVE,ph_state)
+#define crypto_sign_ph_init        XCONCAT3(crypto_sign_,PRIMITIVE,ph_init)
+#define crypto_sign_ph_update      XCONCAT3(crypto_sign_,PRIMITIVE,ph_update)
+#define crypto_sign_ph_final_create XCONCAT3(crypto_sign_,PRIMITIVE,ph_final_create)
+#define crypto_sign_ph_final_verify XCONCAT3(crypto_sign_,PRIMITIVE,ph_final_verify)
 #define crypto_sign_SECRETKEYBYTES XCONCAT3(crypto_sign_,PRIMITIVE,_SECRETKEYBYTES)
 #define crypto_sign_PUBLICKEYBYTES XCONCAT3(crypto_sign_,PRIMITIVE,_PUBLICKEYBYTES)
 #define crypto_sign_BYTES          XCONCAT3(crypto_sign_,PRIMITIVE,_BYTES)
@@ -49,6 +63,150 @@ static unsigned char *t; crypto_uint16 tlen; static unsigned char *t2;
 static unsigned char chain[37]; long long chainlen = 37;
 char checksum[37 * 2 + 1];
 
+/*
+ * Known answers computed with the RFC 8032 reference implementation. The
+ * messages cross the 255 and the 65535 byte boundary, byte i of a message is
+ * vector_byte(i). The secret keys are the ones of RFC 8032 (TEST 1 and the
+ * Ed25519ph TEST abc), followed by the public key.
+ */
+
+#define VECTOR_MAXBYTES 300
+
+static const unsigned char vector_sk[2][64] = {
+ {
+  0x9d,0x61,0xb1,0x9d,0xef,0xfd,0x5a,0x60,0xba,0x84,0x4a,0xf4,
+  0x92,0xec,0x2c,0xc4,0x44,0x49,0xc5,0x69,0x7b,0x32,0x69,0x19,
+  0x70,0x3b,0xac,0x03,0x1c,0xae,0x7f,0x60,0xd7,0x5a,0x98,0x01,
+  0x82,0xb1,0x0a,0xb7,0xd5,0x4b,0xfe,0xd3,0xc9,0x64,0x07,0x3a,
+  0x0e,0xe1,0x72,0xf3,0xda,0xa6,0x23,0x25,0xaf,0x02,0x1a,0x68,
+  0xf7,0x07,0x51,0x1a
+ },
+ {
+  0x83,0x3f,0xe6,0x24,0x09,0x23,0x7b,0x9d,0x62,0xec,0x77,0x58,
+  0x75,0x20,0x91,0x1e,0x9a,0x75,0x9c,0xec,0x1d,0x19,0x75,0x5b,
+  0x7d,0xa9,0x01,0xb9,0x6d,0xca,0x3d,0x42,0xec,0x17,0x2b,0x93,
+  0xad,0x5e,0x56,0x3b,0xf4,0x93,0x2c,0x70,0xe1,0x24,0x50,0x34,
+  0xc3,0x54,0x67,0xef,0x2e,0xfd,0x4d,0x64,0xeb,0xf8,0x19,0x68,
+  0x34,0x67,0xe2,0xbf
+ }
+};
+
+/* crypto_sign with vector_sk[0] */
+static const crypto_uint16 vector_mlen[2] = {255, 300};
+static const unsigned char vector_sig[2][64] = {
+ {
+  0xaf,0x19,0x89,0x1d,0x10,0x6f,0x8f,0xec,0xbe,0xb8,0xd1,0x5c,
+  0x5f,0x29,0xe1,0xf4,0xc3,0x35,0xb3,0x25,0x2b,0x38,0x9a,0x2b,
+  0xf1,0xa7,0x04,0x42,0x80,0x09,0xc7,0xcc,0x62,0xdf,0x38,0x93,
+  0xe4,0xef,0xce,0x41,0x33,0x14,0x34,0xe8,0x12,0x81,0xaf,0x11,
+  0x84,0x57,0xc6,0x90,0x04,0x78,0x9b,0x8b,0x1c,0x83,0xe1,0x03,
+  0x7c,0x23,0x36,0x0a
+ },
+ {
+  0x98,0x3c,0x5a,0x4f,0x7a,0x5b,0xf2,0x94,0x5a,0xb8,0x14,0x4d,
+  0x4b,0x35,0x40,0xc2,0x45,0x93,0xd9,0x69,0x4b,0x65,0x7a,0x25,
+  0x83,0x5f,0x94,0x01,0x9c,0x8f,0xed,0x38,0xde,0xc4,0x38,0x97,
+  0x7c,0x10,0x17,0x03,0x99,0x44,0x1d,0xe4,0x17,0xa6,0x15,0x5e,
+  0xcc,0x6a,0x3e,0x72,0x5f,0x0f,0xbf,0x53,0xd4,0xe0,0x94,0x21,
+  0xda,0x6a,0xf6,0x0d
+ }
+};
+
+/* Ed25519ph with vector_sk[1], the first one is the RFC 8032 test vector ("abc") */
+static const unsigned long vector_ph_mlen[3] = {3, 65535, 65600};
+static const unsigned char vector_ph_sig[3][64] = {
+ {
+  0x98,0xa7,0x02,0x22,0xf0,0xb8,0x12,0x1a,0xa9,0xd3,0x0f,0x81,
+  0x3d,0x68,0x3f,0x80,0x9e,0x46,0x2b,0x46,0x9c,0x7f,0xf8,0x76,
+  0x39,0x49,0x9b,0xb9,0x4e,0x6d,0xae,0x41,0x31,0xf8,0x50,0x42,
+  0x46,0x3c,0x2a,0x35,0x5a,0x20,0x03,0xd0,0x62,0xad,0xf5,0xaa,
+  0xa1,0x0b,0x8c,0x61,0xe6,0x36,0x06,0x2a,0xaa,0xd1,0x1c,0x2a,
+  0x26,0x08,0x34,0x06
+ },
+ {
+  0x61,0xc8,0x6b,0x94,0xe6,0xcc,0x6a,0x72,0x0a,0xf7,0x90,0x81,
+  0x54,0xd6,0xaf,0x78,0xa8,0x5d,0xd4,0x50,0x6d,0xed,0x3d,0x06,
+  0xbb,0x13,0x92,0xcb,0x26,0x1c,0xed,0x59,0x08,0x1e,0x29,0xf6,
+  0xda,0xd9,0x51,0x56,0x7e,0xea,0xc1,0x6d,0x27,0x68,0x79,0xe9,
+  0x9e,0x82,0xa7,0x68,0xfe,0xc1,0xd0,0x1e,0xf9,0x92,0x92,0x47,
+  0x80,0xf1,0xd0,0x03
+ },
+ {
+  0xb0,0x57,0x34,0x83,0x10,0x80,0xa5,0x0b,0x9b,0x47,0xeb,0x90,
+  0xc8,0xe1,0xf0,0x66,0x24,0xb3,0xfb,0x67,0x6f,0x0a,0xc3,0xb4,
+  0xb9,0xf9,0xf4,0x6e,0xa8,0xeb,0xf0,0xaf,0xd2,0x7d,0xa5,0xeb,
+  0x9b,0x1d,0x92,0xee,0x22,0x3e,0x7f,0x30,0xad,0x88,0x1a,0xbe,
+  0x62,0x9b,0x30,0x63,0x17,0x2d,0xd7,0x03,0x70,0xf2,0xe5,0x8b,
+  0x94,0x62,0x5d,0x02
+ }
+};
+
+static unsigned char vector_byte(unsigned long i)
+{
+  return (unsigned char) (i + (i >> 8));
+}
+
+/* the large messages do not fit into memory, they are passed in parts of 100 bytes */
+static void vector_ph_update(crypto_sign_ph_state *state, int k)
+{
+  unsigned char part[100];
+  unsigned long i, j, n;
+
+  for (i = 0;i < vector_ph_mlen[k];i += n)
+  {
+    n = vector_ph_mlen[k] - i < sizeof part ? vector_ph_mlen[k] - i : sizeof part;
+    for (j = 0;j < n;++j) part[j] = k == 0 ? "abc"[j] : vector_byte(i + j);
+    if (crypto_sign_ph_update(state,part,n) != 0) fail("crypto_sign_ph_update returns nonzero");
+  }
+}
+
+static void check_vectors(void)
+{
+  static crypto_sign_ph_state state;
+  unsigned char sig[crypto_sign_BYTES];
+  unsigned char *vm, *vsm;
+  crypto_uint16 vsmlen, j;
+  int k;
+
+  vm  = calloc(VECTOR_MAXBYTES,1);
+  if(!vm) fail("allocation of vm failed");
+  vsm = calloc(VECTOR_MAXBYTES + crypto_sign_BYTES,1);
+  if(!vsm) fail("allocation of vsm failed");
+
+  for (k = 0;k < 2;++k)
+  {
+    for (j = 0;j < vector_mlen[k];++j) vm[j] = vector_byte(j);
+    if (crypto_sign(vsm,&vsmlen,vm,vector_mlen[k],vector_sk[0]) != 0) fail("crypto_sign returns nonzero");
+    if (vsmlen != vector_mlen[k] + crypto_sign_BYTES) fail("crypto_sign does not match vector length");
+    for (j = 0;j < crypto_sign_BYTES;++j) if (vsm[j] != vector_sig[k][j]) fail("crypto_sign does not match vector");
+    for (j = 0;j < vector_mlen[k];++j) if (vsm[j + crypto_sign_BYTES] != vm[j]) fail("crypto_sign does not match vector message");
+    if (crypto_sign_open_inplace(vsm,vsmlen,vector_sk[0] + 32) != 0) fail("crypto_sign_open_inplace rejects vector");
+    vm[vector_mlen[k] - 1] ^= 1;
+    if (crypto_sign_verify_detached(vector_sig[k],vm,vector_mlen[k],vector_sk[0] + 32) == 0)
+      fail("crypto_sign_verify_detached accepts modified vector");
+  }
+
+  for (k = 0;k < 3;++k)
+  {
+    if (crypto_sign_ph_init(&state) != 0) fail("crypto_sign_ph_init returns nonzero");
+    vector_ph_update(&state,k);
+    if (crypto_sign_ph_final_create(&state,sig,vector_sk[1]) != 0) fail("crypto_sign_ph_final_create returns nonzero");
+    for (j = 0;j < crypto_sign_BYTES;++j) if (sig[j] != vector_ph_sig[k][j]) fail("crypto_sign_ph_final_create does not match vector");
+
+    crypto_sign_ph_init(&state);
+    vector_ph_update(&state,k);
+    if (crypto_sign_ph_final_verify(&state,sig,vector_sk[1] + 32) != 0) fail("crypto_sign_ph_final_verify rejects vector");
+
+    sig[k] ^= 1;
+    crypto_sign_ph_init(&state);
+    vector_ph_update(&state,k);
+    if (crypto_sign_ph_final_verify(&state,sig,vector_sk[1] + 32) == 0) fail("crypto_sign_ph_final_verify accepts modified signature");
+  }
+
+  free(vm);
+  free(vsm);
+}
+
 int main(void)
 {
   long long mlen;
@@ -159,6 +317,10 @@ int main(void)
       for (j = 0;j < smlen + 16;++j) if (sm[j] != sm2[j]) fail("crypto_sign_open overwrites sm 2");
       for (j = -16;j < 0;++j) if (t[j] != t2[j]) fail("crypto_sign_open writes before t 2");
       for (j = smlen;j < smlen + 16;++j) if (t[j] != t2[j]) fail("crypto_sign_open writes after t 2");
+
+      if (crypto_sign_open_inplace(sm,smlen,pk) != 0) fail("crypto_sign_open_inplace returns nonzero");
+      if (crypto_sign_verify_detached(sm,m,mlen,pk) != 0) fail("crypto_sign_verify_detached returns nonzero");
+      for (j = 0;j < smlen + 16;++j) if (sm[j] != sm2[j]) fail("crypto_sign_open_inplace overwrites sm 2");
   
       j = random() % smlen;
       sm[j] ^= 1;
@@ -166,12 +328,15 @@ int main(void)
       for (j = 0;j < smlen + 16;++j) sm2[j] = sm[j];
       for (j = -16;j < 0;++j) t2[j] = t[j] = random();
       for (j = 0;j < smlen + 16;++j) t2[j] = t[j] = random();
+      i = crypto_sign_open_inplace(sm,smlen,pk);
       if (crypto_sign_open(t,&tlen,sm,smlen,pk) == 0) {
+        if (i != 0) fail("crypto_sign_open_inplace does not match crypto_sign_open");
         if (tlen != mlen) fail("crypto_sign_open allows trivial forgery of length");
         for (i = 0;i < tlen;++i)
           if (t[i] != m[i])
             fail("crypto_sign_open allows trivial forgery of contents");
       }
+      else if (i == 0) fail("crypto_sign_open_inplace allows trivial forgery");
       for (j = -16;j < 0;++j) if (pk[j] != pk2[j]) fail("crypto_sign_open overwrites pk 3");
       for (j = 0;j < pklen + 16;++j) if (pk[j] != pk2[j]) fail("crypto_sign_open overwrites pk 3");
       for (j = -16;j < 0;++j) if (sk[j] != sk2[j]) fail("crypto_sign_open overwrites sk 3");
@@ -216,6 +381,7 @@ int main(void)
   free(sm2);
   free(t2);
 
+  check_vectors();
 
   avr_end();
   return 0;
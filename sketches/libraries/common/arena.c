@@ -0,0 +1,52 @@
+#include <string.h>
+#include "arena.h"
+
+static uint8_t *base = NULL;
+static uint16_t capacity = 0;
+static uint16_t top = 0;
+static uint16_t peak = 0;
+
+void arena_init(void *buffer, uint16_t size) {
+  base = (uint8_t *) buffer;
+  capacity = size;
+  top = 0;
+}
+
+void *arena_alloc(size_t size) {
+  if (size > (size_t) (capacity - top)) return NULL;
+  void *p = base + top;
+  top += size;
+  if (top > peak) peak = top;
+  return p;
+}
+
+char *arena_strdup(const char *s) {
+  const size_t size = strlen(s) + 1;
+  char *p = (char *) arena_alloc(size);
+  if (p != NULL) memcpy(p, s, size);
+  return p;
+}
+
+void arena_free(void *p) {
+  if ((uint8_t *) p >= base && (uint8_t *) p < base + top) top = (uint16_t) ((uint8_t *) p - base);
+}
+
+arena_mark_t arena_mark(void) {
+  return top;
+}
+
+void arena_release(arena_mark_t mark) {
+  if (mark < top) top = mark;
+}
+
+void arena_reset(void) {
+  top = 0;
+}
+
+uint16_t arena_available(void) {
+  return capacity - top;
+}
+
+uint16_t arena_peak(void) {
+  return peak;
+}
@@ -0,0 +1,71 @@
+#ifndef _ARENA_H_
+#define _ARENA_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef uint16_t arena_mark_t;
+
+/**
+ * Use a static buffer for all allocations of a cycle. Allocations are taken from
+ * the top like a stack and released in reverse order, so there is no fragmentation.
+ *
+ * @param buffer the memory to allocate from
+ * @param size the size of the buffer
+ */
+void arena_init(void *buffer, uint16_t size);
+
+/**
+ * Allocate memory on top of the arena.
+ *
+ * @param size the number of bytes
+ * @return the memory or NULL if the arena is full
+ */
+void *arena_alloc(size_t size);
+
+/**
+ * Copy a string into the arena.
+ *
+ * @return the copy or NULL if the arena is full
+ */
+char *arena_strdup(const char *s);
+
+/**
+ * Release an allocation and everything allocated after it.
+ */
+void arena_free(void *p);
+
+/**
+ * @return the current top of the arena, to release everything allocated afterwards
+ */
+arena_mark_t arena_mark(void);
+
+/**
+ * Release everything allocated since the mark was taken.
+ */
+void arena_release(arena_mark_t mark);
+
+/**
+ * Release everything, e.g. at the start of a cycle.
+ */
+void arena_reset(void);
+
+/**
+ * @return the number of bytes that can still be allocated
+ */
+uint16_t arena_available(void);
+
+/**
+ * @return the most bytes ever in use (high-water mark)
+ */
+uint16_t arena_peak(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _ARENA_H_
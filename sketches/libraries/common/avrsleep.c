@@ -1,6 +1,9 @@
 #include <avr/wdt.h>
 #include <avr/sleep.h>
 #include <avr/interrupt.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "avrsleep.h"
 
 // enabled watchdog with the useful toolchain macros, but only in interrupt mode
 #define wdt_enable_int_only(value)   \
@@ -19,9 +22,16 @@ __asm__ __volatile__ (  \
     : "r0"  \
 )
 
-static void _dosleep(unsigned int cycles) {
-  while (cycles-- > 0) {
-    cli();                         //stop interrupts to ensure the BOD timed sequence executes as required
+// the shortest watchdog timeout in µs (2048 cycles of the nominal 128kHz oscillator)
+static uint16_t wdt_base_us = 16000;
+static volatile uint8_t wdt_fired = 0;
+
+// power down until the watchdog fires, returns false if woken by the wake flag instead
+static bool _powerdown(volatile uint8_t *wake) {
+  wdt_fired = 0;
+  for (;;) {
+    cli();                         //check the flags with interrupts off, sei + sleep is atomic
+    if (wdt_fired || (wake != NULL && *wake)) break;
     set_sleep_mode(SLEEP_MODE_PWR_DOWN);
     sleep_enable();
     //disable brown-out detection while sleeping (20-25µA)
@@ -34,29 +44,124 @@ static void _dosleep(unsigned int cycles) {
     sleep_cpu();                   //go to sleep
     sleep_disable();               //wake up here
   }
+  sei();
+  return wdt_fired;
+}
+
+// wait in idle mode (timers keep running) until the watchdog fires
+static void _idle(void) {
+  wdt_fired = 0;
+  set_sleep_mode(SLEEP_MODE_IDLE);
+  while (!wdt_fired) sleep_mode();
+}
+
+// check whether a timeout still fits into the time left, avoids overflows for long sleeps
+static bool _fits(uint32_t left_ms, uint16_t fraction_us, uint32_t length_us) {
+  return left_ms >= 4000000UL || left_ms * 1000UL - fraction_us >= length_us;
+}
+
+uint32_t sleep_ms(uint32_t ms, volatile uint8_t *wake) {
+  uint32_t slept = 0;
+  uint16_t fraction = 0;
+  bool complete = true;
+
+  // use the longest timeouts first, WDTO_8S is 512 times the shortest timeout
+  for (int8_t timeout = WDTO_8S; complete && timeout >= WDTO_15MS; timeout--) {
+    uint32_t length = (uint32_t) wdt_base_us << timeout;
+    while (complete && _fits(ms - slept, fraction, length)) {
+      wdt_enable_int_only(timeout);
+      complete = _powerdown(wake);
+      if (!complete) length /= 2;
+
+      fraction += length % 1000;
+      slept += length / 1000 + fraction / 1000;
+      fraction %= 1000;
+    }
+  }
   MCUSR = 0;
   wdt_disable();
+  return slept;
 }
 
 void sleep(unsigned int seconds) {
-  unsigned int cycles = seconds;
-  uint8_t rest = 0;
-
-  // if its longer than 8s, sleep in chunks of 8s, else in 1s bits
-  if (seconds >= 8) {
-    cycles = seconds / 8;
-    rest = seconds % 8;
-    wdt_enable_int_only(WDTO_8S);
-  } else {
-    wdt_enable_int_only(WDTO_1S);
-  }
+  sleep_ms(seconds * 1000UL, NULL);
+}
 
-  _dosleep(cycles);
-  if(rest) {
-    wdt_enable_int_only(WDTO_1S);
-    _dosleep(rest);
+// the Timer1 setup of its owner (probe.h), saved while Timer1 is borrowed
+typedef struct {
+  uint8_t tccr1a, tccr1b, timsk1, tifr1;
+  uint16_t tcnt1;
+} timer1_t;
+
+// stop Timer1 and mask its interrupts, so the owner does not count our overflows
+static void _timer1_borrow(timer1_t *saved) {
+  saved->tccr1b = TCCR1B;
+  TCCR1B = 0;
+  saved->tccr1a = TCCR1A;
+  saved->timsk1 = TIMSK1;
+  saved->tifr1 = TIFR1;
+  saved->tcnt1 = TCNT1;
+  TIMSK1 = 0;
+  TCCR1A = 0;
+}
+
+// restore the counter and interrupts, the borrowed time is not counted by the owner
+static void _timer1_return(const timer1_t *saved) {
+  TCCR1B = 0;
+  TCNT1 = saved->tcnt1;
+  // drop our overflow flag, but keep one the owner had pending
+  if (!(saved->tifr1 & _BV(TOV1))) TIFR1 = _BV(TOV1);
+  TCCR1A = saved->tccr1a;
+  TIMSK1 = saved->timsk1;
+  TCCR1B = saved->tccr1b;
+}
+
+uint16_t wdt_calibrate(void) {
+  timer1_t timer1;
+  _timer1_borrow(&timer1);
+
+  // synchronize with the watchdog, then count Timer1 ticks (F_CPU/256) during one 256ms timeout
+  wdt_enable_int_only(WDTO_250MS);
+  _idle();
+  TCNT1 = 0;
+  TCCR1B = _BV(CS12);
+  _idle();
+  uint16_t ticks = TCNT1;
+
+  MCUSR = 0;
+  wdt_disable();
+  _timer1_return(&timer1);
+
+  // the 256ms timeout is 16 times the shortest one
+  uint32_t us = (uint32_t) ticks * 16000UL / (F_CPU / 1000UL);
+  // ignore implausible results (outside +/-25%), e.g. if an interrupt delayed us too much
+  if (us > 12000 && us < 20000) wdt_base_us = (uint16_t) us;
+  return wdt_base_us;
+}
+
+uint16_t wdt_period_us(void) {
+  return wdt_base_us;
+}
+
+void wdt_jitter(uint8_t *samples, uint8_t count) {
+  timer1_t timer1;
+  _timer1_borrow(&timer1);
+
+  // Timer1 runs at the full clock, it wraps many times during a timeout
+  TCNT1 = 0;
+  TCCR1B = _BV(CS10);
+  wdt_enable_int_only(WDTO_15MS);
+  for (uint8_t i = 0; i < count; i++) {
+    _idle();
+    samples[i] = (uint8_t) TCNT1;
   }
+
+  MCUSR = 0;
+  wdt_disable();
+  _timer1_return(&timer1);
 }
 
 // the ISR is necessary to allow the CPU from actually sleeping
-ISR (WDT_vect) { }
+ISR (WDT_vect) {
+  wdt_fired = 1;
+}
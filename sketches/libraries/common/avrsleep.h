@@ -1,3 +1,6 @@
+#ifndef _AVRSLEEP_H_
+#define _AVRSLEEP_H_
+
 #include <avr/wdt.h>
 #include <avr/sleep.h>
 #include <avr/interrupt.h>
@@ -9,16 +12,57 @@ extern "C" {
 /**
  * Sleep a number of seconds. Puts the AVR MCU in low power mode.
  *
- * If the number of seconds is less than 8s, the MCU will sleep in one second bits.
- * If the number of seconds is more than 8s, it will sleep 8 seconds at a time until less than 8s are left over
- * then it will fall back to one seconds bits.
- *
- * The sleep is approximate and for prolonging battery usage.
+ * Same as sleep_ms(seconds * 1000, NULL): the time is slept in calibrated watchdog
+ * timeouts, so it is as accurate as the last wdt_calibrate().
  *
  * @param seconds the number of seconds to sleep
  */
 void sleep(unsigned int seconds);
 
+/**
+ * Sleep a number of milliseconds in power down mode using the calibrated watchdog period.
+ *
+ * The time is split into watchdog timeouts from 8s down to 16ms, the remainder below the
+ * shortest timeout is not slept. If wake is not NULL the sleep ends as soon as *wake is
+ * non-zero after a wakeup (e.g. set by an interrupt), the interrupted timeout is counted
+ * as half its length.
+ *
+ * @param ms the number of milliseconds to sleep
+ * @param wake an optional flag to end the sleep early
+ * @return the approximate number of milliseconds slept
+ */
+uint32_t sleep_ms(uint32_t ms, volatile uint8_t *wake);
+
+/**
+ * Measure the watchdog oscillator against the system clock (Timer1) and use the
+ * result for all following sleeps. The oscillator is only accurate to about 10% and
+ * depends on temperature and voltage, so recalibrate from time to time.
+ * Takes about half a second in idle mode, Timer1 (counter and interrupts) is restored
+ * afterwards, so the time is missing from open probe.h phases.
+ *
+ * @return the measured length of the shortest watchdog timeout (nominal 16ms) in µs
+ */
+uint16_t wdt_calibrate(void);
+
+/**
+ * @return the current length of the shortest watchdog timeout in µs
+ */
+uint16_t wdt_period_us(void);
+
+/**
+ * Sample the jitter between the watchdog oscillator and the system clock: the low
+ * byte of Timer1 (F_CPU) at the end of each of a number of shortest watchdog timeouts.
+ * The two oscillators are independent, so the low bits differ from timeout to timeout
+ * (entropy.h). Takes count times about 16ms in idle mode, Timer1 is restored afterwards
+ * like in wdt_calibrate().
+ *
+ * @param samples the samples (count bytes)
+ * @param count the number of timeouts to sample
+ */
+void wdt_jitter(uint8_t *samples, uint8_t count);
+
 #ifdef __cplusplus
 }
 #endif
+
+#endif // _AVRSLEEP_H_
@@ -0,0 +1,43 @@
+#ifndef _DEBUG_H_
+#define _DEBUG_H_
+
+/*!
+ * Selects the channel for diagnostic output at compile time.
+ *
+ * By default the diagnostic output goes to the hardware serial (Serial). If the
+ * modem uses the hardware UART (SIM800_HW_UART), the output is redirected to a
+ * SoftwareSerial on DEBUG_RX/DEBUG_TX or, if those are not defined, dropped.
+ *
+ * Use DEBUG_SERIAL instead of Serial for all diagnostic output.
+ */
+
+#ifndef SIM800_HW_UART
+#  define DEBUG_SERIAL Serial
+#  ifndef DEBUG_BAUD
+#    define DEBUG_BAUD BAUD
+#  endif
+#elif defined(DEBUG_RX) && defined(DEBUG_TX)
+#  include <SoftwareSerial.h>
+// software serial is unreliable at higher speeds, but it only transmits here
+#  ifndef DEBUG_BAUD
+#    define DEBUG_BAUD 57600
+#  endif
+static SoftwareSerial debug_serial(DEBUG_RX, DEBUG_TX);
+#  define DEBUG_SERIAL debug_serial
+#else
+#  include <Print.h>
+// swallows all output
+class NullSerial : public Print {
+public:
+  void begin(unsigned long) { }
+  virtual size_t write(uint8_t) { return 1; }
+  using Print::write;
+};
+#  ifndef DEBUG_BAUD
+#    define DEBUG_BAUD 0
+#  endif
+static NullSerial debug_serial;
+#  define DEBUG_SERIAL debug_serial
+#endif
+
+#endif // _DEBUG_H_
@@ -0,0 +1,102 @@
+#include <string.h>
+#include <avr/io.h>
+#include <avr/eeprom.h>
+#include "avrsleep.h"
+#include "entropy.h"
+
+// the seeds, mixed into the pool after a reset, the newer one is unknown but both are used
+static uint8_t EEMEM ee_entropy_seed[2][ENTROPY_SEED_BYTES];
+
+// the pool is the SHA-512 of the old pool and the data added since
+static uint8_t pool[crypto_hash_sha512_BYTES];
+static uint8_t pending[ENTROPY_SEED_BYTES];
+static uint8_t pending_length = 0;
+// the seed slot written next
+static uint8_t slot = 0;
+
+static void _mix(void) {
+  crypto_hash_sha512_state state;
+  crypto_hash_sha512_init(&state);
+  crypto_hash_sha512_update(&state, pool, sizeof(pool));
+  crypto_hash_sha512_update(&state, pending, pending_length);
+  crypto_hash_sha512_final(&state, pool);
+  memset(&state, 0, sizeof(state));
+  memset(pending, 0, sizeof(pending));
+  pending_length = 0;
+}
+
+// the low bits of the internal temperature sensor against the 1.1V reference are noise
+static void _adc(uint8_t *samples, uint8_t count) {
+  uint8_t admux = ADMUX, adcsra = ADCSRA;
+
+  ADMUX = _BV(REFS1) | _BV(REFS0) | _BV(MUX3);
+  ADCSRA = _BV(ADEN) | _BV(ADPS2) | _BV(ADPS1) | _BV(ADPS0);
+  for (uint8_t i = 0; i < count; i++) {
+    ADCSRA |= _BV(ADSC);
+    while (ADCSRA & _BV(ADSC));
+    samples[i] = (uint8_t) ADCW;
+  }
+
+  ADMUX = admux;
+  ADCSRA = adcsra;
+}
+
+void entropy_add(const void *data, uint8_t length) {
+  const uint8_t *bytes = (const uint8_t *) data;
+  while (length > 0) {
+    if (pending_length == sizeof(pending)) _mix();
+    uint8_t n = (uint8_t) (sizeof(pending) - pending_length);
+    if (n > length) n = length;
+    memcpy(pending + pending_length, bytes, n);
+    pending_length += n;
+    bytes += n;
+    length -= n;
+  }
+}
+
+void entropy_gather(void) {
+  uint8_t samples[ENTROPY_ADC_SAMPLES > ENTROPY_JITTER_SAMPLES ? ENTROPY_ADC_SAMPLES : ENTROPY_JITTER_SAMPLES];
+
+  _adc(samples, ENTROPY_ADC_SAMPLES);
+  entropy_add(samples, ENTROPY_ADC_SAMPLES);
+  wdt_jitter(samples, ENTROPY_JITTER_SAMPLES);
+  entropy_add(samples, ENTROPY_JITTER_SAMPLES);
+  memset(samples, 0, sizeof(samples));
+}
+
+void entropy_init(void) {
+  uint8_t seed[ENTROPY_SEED_BYTES];
+
+  for (uint8_t i = 0; i < 2; i++) {
+    eeprom_read_block(seed, ee_entropy_seed[i], sizeof(seed));
+    entropy_add(seed, sizeof(seed));
+  }
+  memset(seed, 0, sizeof(seed));
+  entropy_save();
+}
+
+void entropy_save(void) {
+  uint8_t seed[ENTROPY_SEED_BYTES];
+
+  entropy_gather();
+  randombytes(seed, sizeof(seed));
+  eeprom_update_block(seed, ee_entropy_seed[slot], sizeof(seed));
+  memset(seed, 0, sizeof(seed));
+  slot ^= 1;
+}
+
+void randombytes(unsigned char *x, unsigned long long xlen) {
+  uint8_t block[crypto_hash_sha512_BYTES];
+
+  if (pending_length) _mix();
+  while (xlen > 0) {
+    // the first half of the hash replaces the first half of the pool, the second half is output
+    crypto_hash_sha512(block, pool, sizeof(pool));
+    memcpy(pool, block, sizeof(block) / 2);
+    uint8_t n = (uint8_t) (xlen < sizeof(block) / 2 ? xlen : sizeof(block) / 2);
+    memcpy(x, block + sizeof(block) / 2, n);
+    x += n;
+    xlen -= n;
+  }
+  memset(block, 0, sizeof(block));
+}
@@ -0,0 +1,68 @@
+#ifndef _ENTROPY_H_
+#define _ENTROPY_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <avrnacl.h>
+
+// the seed kept in EEPROM across resets
+#define ENTROPY_SEED_BYTES 32
+
+// ADC readings and watchdog timeouts sampled by entropy_gather()
+#ifndef ENTROPY_ADC_SAMPLES
+#  define ENTROPY_ADC_SAMPLES 64
+#endif
+#ifndef ENTROPY_JITTER_SAMPLES
+#  define ENTROPY_JITTER_SAMPLES 16
+#endif
+
+/**
+ * Start the pool: mix in the seeds stored in EEPROM, then add fresh samples and
+ * replace the stored seed (entropy_save). So the pool differs after every reset,
+ * even if the fresh samples happen to repeat.
+ * Takes about 300ms, Timer1 and the ADC are borrowed and restored.
+ */
+void entropy_init(void);
+
+/**
+ * Add data to the pool, e.g. sensor readings or the IMEI. The data is collected
+ * and hashed into the pool once ENTROPY_SEED_BYTES bytes are pending or output
+ * is taken, so adding a few bytes per cycle is cheap.
+ *
+ * @param data the data, only its unpredictable bits help
+ * @param length the data length
+ */
+void entropy_add(const void *data, uint8_t length);
+
+/**
+ * Sample the noise of the internal temperature sensor (the low bits of
+ * ENTROPY_ADC_SAMPLES readings) and the watchdog jitter (ENTROPY_JITTER_SAMPLES
+ * timeouts, wdt_jitter) and add them to the pool.
+ */
+void entropy_gather(void);
+
+/**
+ * Reseed: add fresh samples (entropy_gather) and store a new seed from the pool
+ * in EEPROM. The two seed slots are written alternately, so an interrupted write
+ * leaves the other one. Takes about 300ms and each call writes ENTROPY_SEED_BYTES
+ * EEPROM cells, call it every few hours at most.
+ */
+void entropy_save(void);
+
+/**
+ * randombytes() of avrnacl (crypto_box_keypair, crypto_sign_keypair) from the
+ * pool: each 32 bytes of output cost one SHA-512 of the pool, which replaces
+ * half of the pool, so earlier output can't be computed from a later pool.
+ */
+void randombytes(unsigned char *x, unsigned long long xlen);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _ENTROPY_H_
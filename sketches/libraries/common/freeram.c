@@ -1,3 +1,42 @@
+#include <stddef.h>
+#include <avr/io.h>
+#include "freeram.h"
+
+extern uint8_t __heap_start, __stack;
+extern uint8_t *__brkval;
+
+// the malloc free list (avr-libc stdlib_private.h)
+struct __freelist {
+  size_t sz;
+  struct __freelist *nx;
+};
+extern struct __freelist *__flp;
+
+/*!
+ * Paint the memory between the end of the static data and the top of the stack
+ * before anything runs. This is in .init1, there is no zero register and no
+ * stack frame yet, so it is plain assembler.
+ */
+void stack_paint(void) __attribute__ ((naked, used, section (".init1")));
+void stack_paint(void) {
+  __asm volatile (
+    "    ldi r30, lo8(_end)\n"
+    "    ldi r31, hi8(_end)\n"
+    "    ldi r24, %0\n"
+    "    ldi r25, hi8(__stack)\n"
+    "    rjmp 2f\n"
+    "1:  st Z+, r24\n"
+    "2:  cpi r30, lo8(__stack)\n"
+    "    cpc r31, r25\n"
+    "    brlo 1b\n"
+    "    breq 1b\n"
+    :: "M" (STACK_CANARY));
+}
+
+static uint8_t *_heap_end(void) {
+  return __brkval == 0 ? &__heap_start : __brkval;
+}
+
 // we will ignore this diagnostic warning as we actually _want_ to return the address
 
 #pragma GCC diagnostic push
@@ -9,8 +48,38 @@
  * @return available space between end of heap and stack
  */
 int query_free_sram() {
-  extern int __heap_start, *__brkval;
   int v;
-  return (int) &v - (__brkval == 0 ? (int) &__heap_start: (int) __brkval);
+  return (int) &v - (int) _heap_end();
 }
 #pragma GCC diagnostic pop
+
+void stack_repaint(void) {
+  // everything below the stack pointer is free, interrupts may use it later
+  for (uint8_t *p = _heap_end(); p < (uint8_t *) SP; p++) *p = STACK_CANARY;
+}
+
+uint16_t query_stack_unused() {
+  const uint8_t *p = _heap_end();
+  uint16_t count = 0;
+  while (p <= &__stack && *p == STACK_CANARY) {
+    p++;
+    count++;
+  }
+  return count;
+}
+
+uint16_t query_stack_peak() {
+  const uint8_t *lowest = _heap_end() + query_stack_unused();
+  return (uint16_t) (&__stack - lowest + 1);
+}
+
+void query_heap_stats(heap_stats_t *stats) {
+  stats->blocks = 0;
+  stats->bytes = 0;
+  stats->largest = 0;
+  for (const struct __freelist *block = __flp; block != NULL; block = block->nx) {
+    stats->blocks++;
+    stats->bytes += block->sz;
+    if (block->sz > stats->largest) stats->largest = block->sz;
+  }
+}
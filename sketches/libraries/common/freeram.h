@@ -1,12 +1,52 @@
 #ifndef _FREE_SRAM_H_
 #define _FREE_SRAM_H_
 
+#include <stdint.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+// the unused stack is filled with this pattern at startup
+#define STACK_CANARY 0xc5
+
+typedef struct {
+  uint16_t blocks;  // number of blocks in the malloc free list
+  uint16_t bytes;   // total size of the free blocks
+  uint16_t largest; // largest free block
+} heap_stats_t;
+
 int query_free_sram();
 
+/*!
+ * The deepest the stack ever reached since the last reset. The memory between the
+ * heap and the stack is painted with STACK_CANARY before main() runs, the first
+ * byte that changed marks the lowest stack pointer. Buffers on the stack that were
+ * never written are not counted.
+ *
+ * @return the stack high-water mark in bytes
+ */
+uint16_t query_stack_peak();
+
+/*!
+ * Paint the unused memory below the current stack pointer again, so that
+ * query_stack_peak() reports the deepest stack use from here on, e.g. of one call.
+ */
+void stack_repaint(void);
+
+/*!
+ * @return the number of bytes between the heap and the stack that were never used
+ */
+uint16_t query_stack_unused();
+
+/*!
+ * Walk the malloc free list to see how fragmented the heap is. Memory above the
+ * heap end is not in the list, see query_free_sram().
+ *
+ * @param stats the statistics
+ */
+void query_heap_stats(heap_stats_t *stats);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,78 @@
+#ifndef _JSON_SCHEMA_H_
+#define _JSON_SCHEMA_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*!
+ * Compile time description of JSON messages to size their buffers.
+ *
+ * A schema is built from its parts and yields the worst case length in characters
+ * (without the terminating zero) and the number of jsmn tokens needed to parse it:
+ *
+ *   constexpr json_t payload = json::object(
+ *       json::field("r", json::UINT16),
+ *       json::field("la", json::string(11)));
+ *   static char buffer[payload.length + 1];
+ *
+ * Fields that are only sent sometimes are part of the worst case, optional ones
+ * that are switched off at compile time can be left out with json::when().
+ */
+
+struct json_t {
+  uint16_t length; // worst case number of characters
+  uint8_t tokens;  // number of jsmn tokens
+
+  constexpr json_t(uint16_t length, uint8_t tokens) : length(length), tokens(tokens) {}
+};
+
+namespace json {
+
+// a number with at most this many characters (including the sign)
+constexpr json_t number(uint8_t chars) { return json_t(chars, 1); }
+
+constexpr json_t UINT8 = number(3);
+constexpr json_t UINT16 = number(5);
+constexpr json_t INT16 = number(6);
+constexpr json_t UINT32 = number(10);
+constexpr json_t FLAG = number(1);
+
+// a string with at most this many characters, plus the quotes
+constexpr json_t string(uint16_t chars) { return json_t(chars + 2, 1); }
+
+// base64 encoded data, padded
+constexpr uint16_t base64(uint16_t bytes) { return (bytes + 2) / 3 * 4; }
+
+// ',"key":value', the comma is dropped for the first field of an object
+template<size_t N>
+constexpr json_t field(const char (&key)[N], json_t value) {
+  return json_t(1 + (N - 1) + 3 + value.length, 1 + value.tokens);
+}
+
+// the field if it is enabled, else nothing
+constexpr json_t when(bool enabled, json_t part) { return enabled ? part : json_t(0, 0); }
+
+// an array of count equal elements
+constexpr json_t array(uint8_t count, json_t element) {
+  return json_t(count ? count * (element.length + 1) + 1 : 2, 1 + count * element.tokens);
+}
+
+constexpr json_t _add(json_t a, json_t b) { return json_t(a.length + b.length, a.tokens + b.tokens); }
+
+constexpr json_t _sum() { return json_t(0, 0); }
+
+template<typename... T>
+constexpr json_t _sum(json_t first, T... rest) { return _add(first, _sum(rest...)); }
+
+constexpr json_t _braces(json_t fields) { return json_t(fields.length ? fields.length + 1 : 2, 1 + fields.tokens); }
+
+// an object of fields, '{' + fields without the first comma + '}'
+template<typename... T>
+constexpr json_t object(T... fields) { return _braces(_sum(fields...)); }
+
+// the larger of two sizes
+constexpr uint16_t max(uint16_t a, uint16_t b) { return a > b ? a : b; }
+
+}
+
+#endif // _JSON_SCHEMA_H_
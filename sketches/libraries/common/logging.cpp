@@ -0,0 +1,102 @@
+#include <stdarg.h>
+#include "logging.h"
+
+static Print *out = NULL;
+
+void log_init(Print &stream) {
+  out = &stream;
+}
+
+static const char HEX_DIGITS[] PROGMEM = "0123456789abcdef";
+
+static void _hex(uint8_t value) {
+  out->write(pgm_read_byte(&HEX_DIGITS[value >> 4]));
+  out->write(pgm_read_byte(&HEX_DIGITS[value & 0x0f]));
+}
+
+// a small printf for the log formats, it prints directly without a line buffer
+void log_text(const char *format, ...) {
+  if (out == NULL) return;
+
+  va_list args;
+  va_start(args, format);
+  char c;
+  while ((c = pgm_read_byte(format++))) {
+    if (c != '%') {
+      out->write(c);
+      continue;
+    }
+
+    bool is_long = false;
+    if ((c = pgm_read_byte(format++)) == 'l') {
+      is_long = true;
+      c = pgm_read_byte(format++);
+    }
+    switch (c) {
+      case 'd':
+        if (is_long) out->print(va_arg(args, long));
+        else out->print(va_arg(args, int));
+        break;
+      case 'u':
+        if (is_long) out->print(va_arg(args, unsigned long));
+        else out->print(va_arg(args, unsigned int));
+        break;
+      case 'x':
+        if (is_long) out->print(va_arg(args, unsigned long), HEX);
+        else out->print(va_arg(args, unsigned int), HEX);
+        break;
+      case 'c':
+        out->write((char) va_arg(args, int));
+        break;
+      case 's': {
+        const char *s = va_arg(args, const char *);
+        if (s != NULL) out->print(s);
+        break;
+      }
+      case 't': {
+        const log_span_t span = va_arg(args, log_span_t);
+        out->write((const uint8_t *) span.s, span.length);
+        break;
+      }
+      case '\0':
+        format--;
+        break;
+      default:
+        out->write(c);
+        break;
+    }
+  }
+  va_end(args);
+  out->println();
+}
+
+void log_text_hex(const char *label, const void *data, uint8_t length) {
+  if (out == NULL) return;
+  out->print((const __FlashStringHelper *) label);
+  for (uint8_t i = 0; i < length; i++) _hex(((const uint8_t *) data)[i]);
+  out->println();
+}
+
+void log_record(uint16_t id) {
+  if (out == NULL) return;
+  out->write(LOG_RECORD);
+  out->write((uint8_t) id);
+  out->write((uint8_t) (id >> 8));
+}
+
+void log_number(uint32_t value, uint8_t size) {
+  if (out == NULL) return;
+  for (uint8_t i = 0; i < size; i++, value >>= 8) out->write((uint8_t) value);
+}
+
+void log_string(const char *s) {
+  if (out == NULL) return;
+  if (s != NULL) out->print(s);
+  out->write((uint8_t) 0);
+}
+
+void log_bytes(const void *data, uint8_t length) {
+  if (out == NULL) return;
+  out->write(length);
+  out->write((const uint8_t *) data, length);
+}
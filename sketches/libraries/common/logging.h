@@ -0,0 +1,131 @@
+#ifndef _LOGGING_H_
+#define _LOGGING_H_
+
+#include <stdint.h>
+#include <avr/pgmspace.h>
+#include <Print.h>
+
+/*!
+ * Diagnostic output with compile time log levels.
+ *
+ *   LOG_INFO("RGB: %u:%u:%u", red, green, blue);
+ *   LOG_DEBUG_HEX("hash ", hash, crypto_hash_BYTES);
+ *
+ * Messages above LOG_LEVEL are removed by the preprocessor, their arguments are
+ * not evaluated. The format understands %u, %d, %x, %c and %s, with an l for 32 bit
+ * values (%lu), and %t for a part of a string (log_span()). Each message is one line.
+ *
+ * With LOG_BINARY a message is sent as a record instead of text: 0x1e, the 16 bit
+ * message id (little endian) and the arguments, 16 or 32 bit little endian numbers,
+ * zero terminated strings or a length byte and the data for spans and hex dumps.
+ * The id is a hash of the format string computed at compile time, the format strings
+ * are not stored in flash. tools/log-decode.py builds the id table from the sources
+ * and decodes the records, other output passes through.
+ *
+ * LOG_LEVEL and LOG_BINARY are set in config.cmake, so they apply to all libraries.
+ */
+
+#define LOG_LEVEL_OFF   0
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_WARN  2
+#define LOG_LEVEL_INFO  3
+#define LOG_LEVEL_DEBUG 4
+
+#ifndef LOG_LEVEL
+#  define LOG_LEVEL LOG_LEVEL_DEBUG
+#endif
+
+// starts a binary record
+#define LOG_RECORD 0x1e
+
+/**
+ * Send the diagnostic output to this stream, e.g. DEBUG_SERIAL. Nothing is sent before.
+ */
+void log_init(Print &out);
+
+// a part of a string, e.g. a JSON token
+typedef struct {
+  const char *s;
+  uint8_t length;
+} log_span_t;
+
+inline log_span_t log_span(const char *s, uint8_t length) { return {s, length}; }
+
+// the implementation of the LOG_* macros, do not call directly
+void log_text(const char *format, ...);
+void log_text_hex(const char *label, const void *data, uint8_t length);
+void log_record(uint16_t id);
+void log_number(uint32_t value, uint8_t size);
+void log_string(const char *s);
+void log_bytes(const void *data, uint8_t length);
+
+// FNV-1a of the format string, folded to 16 bit (the same in tools/log-decode.py)
+constexpr uint32_t log_fnv(const char *s, uint32_t hash = 2166136261UL) {
+  return *s ? log_fnv(s + 1, (hash ^ (uint8_t) *s) * 16777619UL) : hash;
+}
+
+constexpr uint16_t log_id(const char *format) {
+  return (uint16_t) ((log_fnv(format) >> 16) ^ (log_fnv(format) & 0xffff));
+}
+
+// numbers are sent like they are passed to printf: 16 bit unless they are longer
+template<typename T>
+inline void log_argument(T value) { log_number((uint32_t) (int32_t) value, sizeof(T) > 2 ? 4 : 2); }
+
+inline void log_argument(const char *s) { log_string(s); }
+
+inline void log_argument(char *s) { log_string(s); }
+
+inline void log_argument(log_span_t span) { log_bytes(span.s, span.length); }
+
+// the id is a template argument, so it is computed at compile time
+template<uint16_t ID, typename... T>
+inline void log_binary(T... args) {
+  log_record(ID);
+  const int sent[] = {0, (log_argument(args), 0)...};
+  (void) sent;
+}
+
+template<uint16_t ID>
+inline void log_binary_hex(const void *data, uint8_t length) {
+  log_record(ID);
+  log_bytes(data, length);
+}
+
+#ifdef LOG_BINARY
+#  define LOG_WRITE(format, ...) log_binary<log_id(format)>(__VA_ARGS__)
+#  define LOG_WRITE_HEX(label, data, length) log_binary_hex<log_id(label)>(data, length)
+#else
+#  define LOG_WRITE(format, ...) log_text(PSTR(format), ##__VA_ARGS__)
+#  define LOG_WRITE_HEX(label, data, length) log_text_hex(PSTR(label), data, length)
+#endif
+
+#define LOG_NOTHING do { } while (0)
+
+#if LOG_LEVEL >= LOG_LEVEL_ERROR
+#  define LOG_ERROR(format, ...) LOG_WRITE(format, ##__VA_ARGS__)
+#else
+#  define LOG_ERROR(format, ...) LOG_NOTHING
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_WARN
+#  define LOG_WARN(format, ...) LOG_WRITE(format, ##__VA_ARGS__)
+#else
+#  define LOG_WARN(format, ...) LOG_NOTHING
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_INFO
+#  define LOG_INFO(format, ...) LOG_WRITE(format, ##__VA_ARGS__)
+#else
+#  define LOG_INFO(format, ...) LOG_NOTHING
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_DEBUG
+#  define LOG_DEBUG(format, ...) LOG_WRITE(format, ##__VA_ARGS__)
+#  define LOG_DEBUG_HEX(label, data, length) LOG_WRITE_HEX(label, data, length)
+#else
+#  define LOG_DEBUG(format, ...) LOG_NOTHING
+#  define LOG_DEBUG_HEX(label, data, length) LOG_NOTHING
+#endif
+
+#endif // _LOGGING_H_
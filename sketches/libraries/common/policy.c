@@ -0,0 +1,129 @@
+#include <string.h>
+#include <avr/eeprom.h>
+#include <avr/pgmspace.h>
+#include "scheduler.h"
+#include "policy.h"
+
+// the table set by the backend, rows is 0xff if it was never written
+static struct {
+  uint8_t rows;
+  policy_t table[POLICY_ROWS];
+  uint8_t check;
+} EEMEM ee_policy = {0xff};
+
+static const policy_t *defaults_P = NULL;
+static uint8_t default_rows = 0;
+
+static policy_t table[POLICY_ROWS];
+static uint8_t rows = 0;
+static uint8_t level = 0;
+
+// the reading the trend is measured against
+static uint8_t trend_percent = 0;
+static uint32_t trend_ms = 0;
+static bool trend_started = false;
+static int8_t trend = 0;
+
+static uint8_t _checksum(const policy_t *t, uint8_t n) {
+  uint8_t check = (uint8_t) (0xa5 ^ n);
+  const uint8_t *p = (const uint8_t *) t;
+  for (uint8_t i = 0; i < n * sizeof(policy_t); i++) check ^= p[i];
+  return check;
+}
+
+static bool _valid(const policy_t *t, uint8_t n) {
+  if (n == 0 || n > POLICY_ROWS) return false;
+  for (uint8_t i = 0; i < n; i++) {
+    if (t[i].upload < 1 || t[i].upload > POLICY_UPLOAD_MAX) return false;
+    if (i > 0 && t[i].battery < t[i - 1].battery) return false;
+  }
+  return true;
+}
+
+static void _defaults(void) {
+  memcpy_P(table, defaults_P, default_rows * sizeof(policy_t));
+  rows = default_rows;
+  level = rows - 1;
+}
+
+static uint8_t _select(uint8_t percent) {
+  for (uint8_t i = 0; i < rows; i++) {
+    if (percent <= table[i].battery && trend <= table[i].trend) return i;
+  }
+  return rows - 1;
+}
+
+// measure the trend over a window, the readings are too coarse for anything shorter
+static void _trend(uint8_t percent) {
+  uint32_t now = sched_now();
+  if (!trend_started) {
+    trend_started = true;
+  } else if (now - trend_ms >= POLICY_TREND_MS) {
+    int32_t per_day = ((int32_t) percent - trend_percent) * 86400L / (int32_t) ((now - trend_ms) / 1000);
+    trend = (int8_t) (per_day > 127 ? 127 : per_day < -127 ? -127 : per_day);
+  } else {
+    return;
+  }
+  trend_percent = percent;
+  trend_ms = now;
+}
+
+void policy_init(const policy_t *defaults, uint8_t n) {
+  defaults_P = defaults;
+  default_rows = n;
+
+  uint8_t stored = eeprom_read_byte(&ee_policy.rows);
+  if (stored > 0 && stored <= POLICY_ROWS) {
+    eeprom_read_block(table, ee_policy.table, stored * sizeof(policy_t));
+    if (eeprom_read_byte(&ee_policy.check) == _checksum(table, stored) && _valid(table, stored)) {
+      rows = stored;
+      level = rows - 1;
+      return;
+    }
+  }
+  _defaults();
+}
+
+const policy_t *policy_update(uint8_t percent) {
+  _trend(percent);
+
+  uint8_t selected = _select(percent);
+  // only relax the policy if the battery recovered clearly, it does not flap at a boundary
+  if (selected > level) {
+    uint8_t recovered = _select(percent > POLICY_HYSTERESIS ? percent - POLICY_HYSTERESIS : 0);
+    selected = recovered > level ? (recovered < selected ? recovered : selected) : level;
+  }
+  level = selected;
+  return &table[level];
+}
+
+const policy_t *policy_current(void) {
+  return &table[level];
+}
+
+uint8_t policy_level(void) {
+  return level;
+}
+
+int8_t policy_trend(void) {
+  return trend;
+}
+
+bool policy_set(const policy_t *t, uint8_t n) {
+  if (t == NULL || n == 0) {
+    // forget the stored table
+    eeprom_update_byte(&ee_policy.rows, 0xff);
+    _defaults();
+    return true;
+  }
+  if (!_valid(t, n)) return false;
+
+  memcpy(table, t, n * sizeof(policy_t));
+  rows = n;
+  if (level >= rows) level = rows - 1;
+
+  eeprom_update_block(table, ee_policy.table, n * sizeof(policy_t));
+  eeprom_update_byte(&ee_policy.check, _checksum(table, n));
+  eeprom_update_byte(&ee_policy.rows, n);
+  return true;
+}
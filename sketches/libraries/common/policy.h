@@ -0,0 +1,91 @@
+#ifndef _POLICY_H_
+#define _POLICY_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// maximum number of rows in the policy table
+#define POLICY_ROWS 4
+
+// maximum number of cycles per upload (samples in one batch)
+#define POLICY_UPLOAD_MAX 4
+
+// a row applying to any trend
+#define POLICY_ANY_TREND 127
+
+// the battery must recover by this many percent before a less restrictive row is used
+#ifndef POLICY_HYSTERESIS
+#  define POLICY_HYSTERESIS 3
+#endif
+
+// the battery trend is measured over this many milliseconds (6 hours)
+#ifndef POLICY_TREND_MS
+#  define POLICY_TREND_MS 21600000UL
+#endif
+
+// features that may be switched off to save power
+#define POLICY_LOCATION  0b00000001 // query the GSM location
+#define POLICY_SMS       0b00000010 // send by SMS if GPRS fails
+#define POLICY_ANIMATION 0b00000100 // lamp blink animation
+#define POLICY_ALL       0b11111111
+
+typedef struct {
+  uint8_t battery;   // applies at or below this battery level (percent)
+  int8_t trend;      // applies at or below this battery trend (percent per day)
+  uint16_t interval; // minimum cycle interval in seconds, 0 keeps the backend interval
+  uint8_t upload;    // upload every n-th cycle (1 - POLICY_UPLOAD_MAX)
+  uint8_t features;  // POLICY_* features enabled
+} policy_t;
+
+/**
+ * Load the policy table from EEPROM or, if the backend never set one, use the defaults.
+ * Until the first battery reading the last (least restrictive) row applies.
+ *
+ * @param defaults the default table in PROGMEM, ordered by battery level (ascending)
+ * @param rows the number of rows in the default table (1 - POLICY_ROWS)
+ */
+void policy_init(const policy_t *defaults, uint8_t rows);
+
+/**
+ * Feed a battery reading and select the row that applies: the first row whose
+ * battery level and trend are not exceeded, else the last row.
+ *
+ * @param percent the battery level (0 - 100)
+ * @return the policy to apply
+ */
+const policy_t *policy_update(uint8_t percent);
+
+/**
+ * @return the policy to apply
+ */
+const policy_t *policy_current(void);
+
+/**
+ * @return the index of the row that applies
+ */
+uint8_t policy_level(void);
+
+/**
+ * @return the battery trend in percent per day, 0 until it could be measured
+ */
+int8_t policy_trend(void);
+
+/**
+ * Replace the policy table, e.g. with one sent by the backend, and store it in EEPROM.
+ * The rows must be ordered by battery level and use valid upload counts.
+ *
+ * @param table the new rows, NULL or no rows restore the defaults
+ * @param rows the number of rows (0 - POLICY_ROWS)
+ * @return false if the table was rejected
+ */
+bool policy_set(const policy_t *table, uint8_t rows);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _POLICY_H_
@@ -0,0 +1,97 @@
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/pgmspace.h>
+#include "probe.h"
+
+#define PROBE_MAGIC 0x5052
+
+// Timer1 ticks per ms with a prescaler of 64
+#define TICKS_PER_MS (F_CPU / 64000UL)
+
+// kept across resets, validated with a magic number and a checksum
+static struct {
+  uint16_t magic;
+  probe_stat_t stats[PROBE_PHASES];
+  uint8_t check;
+} probes __attribute__ ((section (".noinit")));
+
+static volatile uint16_t overflows = 0;
+static uint32_t started[PROBE_PHASES];
+
+static uint8_t _checksum(void) {
+  uint8_t check = 0xa5;
+  const uint8_t *p = (const uint8_t *) probes.stats;
+  for (uint8_t i = 0; i < sizeof(probes.stats); i++) check ^= p[i];
+  return check;
+}
+
+void probe_reset(void) {
+  memset(probes.stats, 0, sizeof(probes.stats));
+  probes.magic = PROBE_MAGIC;
+  probes.check = _checksum();
+}
+
+void probe_init(void) {
+  if (probes.magic != PROBE_MAGIC || probes.check != _checksum()) probe_reset();
+
+  // normal mode, free running with a prescaler of 64 (also used by the Arduino core for PWM)
+  TCCR1A = 0;
+  TCCR1B = _BV(CS11) | _BV(CS10);
+  TCNT1 = 0;
+  TIMSK1 |= _BV(TOIE1);
+}
+
+uint32_t probe_ticks(void) {
+  uint8_t sreg = SREG;
+  cli();
+  uint16_t low = TCNT1;
+  uint16_t high = overflows;
+  // an overflow happened, but the interrupt has not been handled yet
+  if ((TIFR1 & _BV(TOV1)) && low < 0x8000) high++;
+  SREG = sreg;
+  return ((uint32_t) high << 16) | low;
+}
+
+void probe_start(uint8_t phase) {
+  if (phase < PROBE_PHASES) started[phase] = probe_ticks();
+}
+
+void probe_stop(uint8_t phase) {
+  if (phase >= PROBE_PHASES) return;
+
+  uint32_t ms = (probe_ticks() - started[phase]) / TICKS_PER_MS;
+  probe_stat_t *stat = &probes.stats[phase];
+  stat->ms += ms;
+  if (stat->count < UINT16_MAX) stat->count++;
+  if (ms > stat->max) stat->max = (uint16_t) (ms > UINT16_MAX ? UINT16_MAX : ms);
+  probes.check = _checksum();
+}
+
+const probe_stat_t *probe_stats(uint8_t phase) {
+  return &probes.stats[phase < PROBE_PHASES ? phase : 0];
+}
+
+static char *_array(char *p, char key, bool average) {
+  p += sprintf_P(p, PSTR(",\"p%c\":["), key);
+  for (uint8_t i = 0; i < PROBE_PHASES; i++) {
+    const probe_stat_t *stat = &probes.stats[i];
+    uint32_t value = average ? (stat->count ? stat->ms / stat->count : 0) : stat->max;
+    if (value > UINT16_MAX) value = UINT16_MAX;
+    p += sprintf_P(p, i ? PSTR(",%u") : PSTR("%u"), (uint16_t) value);
+  }
+  *p++ = ']';
+  *p = '\0';
+  return p;
+}
+
+char *probe_json(char *buffer) {
+  _array(_array(buffer, 't', true), 'x', false);
+  return buffer;
+}
+
+ISR(TIMER1_OVF_vect) {
+  overflows++;
+}
@@ -0,0 +1,78 @@
+#ifndef _PROBE_H_
+#define _PROBE_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// the phases of a cycle that are measured
+#define PROBE_SENSOR   0 // sensor integration
+#define PROBE_WAKEUP   1 // modem wakeup
+#define PROBE_REGISTER 2 // network registration
+#define PROBE_GPRS     3 // GPRS attach
+#define PROBE_LOCATION 4 // GSM location query
+#define PROBE_HASH     5 // payload hashing
+#define PROBE_HTTP     6 // HTTP request and response
+#define PROBE_RESPONSE 7 // response parsing and verification
+#define PROBE_PHASES   8
+
+// the maximum length of the probe_json() output including the terminator
+#define PROBE_JSON_LEN (2 * (7 + PROBE_PHASES * 6) + 1)
+
+typedef struct {
+  uint32_t ms;    // total time in ms
+  uint16_t count; // number of runs
+  uint16_t max;   // longest run in ms
+} probe_stat_t;
+
+/**
+ * Start Timer1 as a free running counter (64 CPU cycles per tick) and check the
+ * statistics kept in .noinit memory, they are only cleared if they are invalid
+ * (e.g. after a power on), so they survive resets.
+ * Timer1 is stopped in power down, the probes measure awake time only.
+ */
+void probe_init(void);
+
+/**
+ * @return the Timer1 ticks since probe_init(), 64 CPU cycles each
+ */
+uint32_t probe_ticks(void);
+
+/**
+ * Start measuring a phase.
+ */
+void probe_start(uint8_t phase);
+
+/**
+ * Stop measuring a phase and add the time to its statistics.
+ */
+void probe_stop(uint8_t phase);
+
+/**
+ * @return the statistics of a phase
+ */
+const probe_stat_t *probe_stats(uint8_t phase);
+
+/**
+ * Clear all statistics, e.g. after they have been reported.
+ */
+void probe_reset(void);
+
+/**
+ * Format the statistics as JSON payload keys: average ("pt") and longest ("px")
+ * run of each phase in ms.
+ * Example: ',"pt":[602,1200,3400,2100,0,310,5200,420],"px":[602,1300,9800,4400,0,320,7100,430]'
+ *
+ * @param buffer the target, at least PROBE_JSON_LEN bytes
+ * @return the buffer
+ */
+char *probe_json(char *buffer);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _PROBE_H_
@@ -0,0 +1,130 @@
+#include <Arduino.h>
+#include <avr/sleep.h>
+#include "avrsleep.h"
+#include "scheduler.h"
+
+typedef struct {
+  sched_task_t task;
+  uint32_t due;
+  uint32_t period;
+} task_t;
+
+static task_t tasks[SCHED_TASKS];
+static sched_handler_t event_handler = NULL;
+
+// event ring buffer, filled by ISRs
+static volatile uint8_t events[SCHED_EVENTS];
+static volatile uint8_t event_head = 0;
+static volatile uint8_t event_count = 0;
+
+// time spent in power down, millis() does not count while Timer0 is stopped
+static uint32_t slept = 0;
+static uint32_t calibrated = 0;
+
+void sched_init(sched_handler_t handler) {
+  event_handler = handler;
+  for (uint8_t i = 0; i < SCHED_TASKS; i++) tasks[i].task = NULL;
+  wdt_calibrate();
+  calibrated = sched_now();
+}
+
+int8_t sched_add(sched_task_t task, uint32_t delay, uint32_t period) {
+  for (int8_t id = 0; id < SCHED_TASKS; id++) {
+    if (tasks[id].task != NULL) continue;
+    tasks[id].task = task;
+    tasks[id].due = sched_now() + delay;
+    tasks[id].period = period;
+    return id;
+  }
+  return -1;
+}
+
+void sched_period(int8_t id, uint32_t period) {
+  if (id < 0 || id >= SCHED_TASKS) return;
+  // the next run is already scheduled, move it relative to the last run
+  tasks[id].due += period - tasks[id].period;
+  tasks[id].period = period;
+}
+
+void sched_delay(int8_t id, uint32_t delay) {
+  if (id >= 0 && id < SCHED_TASKS) tasks[id].due = sched_now() + delay;
+}
+
+void sched_cancel(int8_t id) {
+  if (id >= 0 && id < SCHED_TASKS) tasks[id].task = NULL;
+}
+
+bool sched_post(uint8_t event) {
+  uint8_t sreg = SREG;
+  cli();
+  bool queued = event_count < SCHED_EVENTS;
+  if (queued) {
+    events[(event_head + event_count) & (SCHED_EVENTS - 1)] = event;
+    event_count++;
+  }
+  SREG = sreg;
+  return queued;
+}
+
+static bool _next_event(uint8_t *event) {
+  uint8_t sreg = SREG;
+  cli();
+  bool available = event_count > 0;
+  if (available) {
+    *event = events[event_head];
+    event_head = (uint8_t) ((event_head + 1) & (SCHED_EVENTS - 1));
+    event_count--;
+  }
+  SREG = sreg;
+  return available;
+}
+
+uint32_t sched_now(void) {
+  return millis() + slept;
+}
+
+void sched_run(void) {
+  uint8_t event;
+  while (_next_event(&event)) if (event_handler != NULL) event_handler(event);
+
+  uint32_t now = sched_now();
+  for (uint8_t i = 0; i < SCHED_TASKS; i++) {
+    sched_task_t task = tasks[i].task;
+    if (task == NULL || (int32_t) (tasks[i].due - now) > 0) continue;
+
+    if (tasks[i].period) {
+      tasks[i].due += tasks[i].period;
+      // skip runs that were missed entirely instead of catching up
+      if ((int32_t) (tasks[i].due - now) <= 0) tasks[i].due = now + tasks[i].period;
+    } else {
+      tasks[i].task = NULL;
+    }
+    task();
+    now = sched_now();
+  }
+
+  // the watchdog oscillator drifts with temperature and voltage
+  if (now - calibrated >= SCHED_CALIBRATE_MS) {
+    wdt_calibrate();
+    calibrated = now = sched_now();
+  }
+
+  if (event_count) return;
+
+  // power down until the next deadline, an event ends the sleep early
+  int32_t wait = INT32_MAX;
+  for (uint8_t i = 0; i < SCHED_TASKS; i++) {
+    if (tasks[i].task == NULL) continue;
+    int32_t left = (int32_t) (tasks[i].due - now);
+    if (left < wait) wait = left;
+  }
+  if (wait <= 0) return;
+
+  uint32_t ms = sleep_ms((uint32_t) wait, &event_count);
+  slept += ms;
+  // less than the shortest watchdog timeout left, wait in idle mode (Timer0 wakes us every ms)
+  if (!ms) {
+    set_sleep_mode(SLEEP_MODE_IDLE);
+    sleep_mode();
+  }
+}
@@ -0,0 +1,88 @@
+#ifndef _SCHEDULER_H_
+#define _SCHEDULER_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// maximum number of timed tasks
+#ifndef SCHED_TASKS
+#  define SCHED_TASKS 4
+#endif
+
+// size of the event queue, must be a power of 2
+#ifndef SCHED_EVENTS
+#  define SCHED_EVENTS 8
+#endif
+
+// recalibrate the watchdog after this many milliseconds (1 hour)
+#ifndef SCHED_CALIBRATE_MS
+#  define SCHED_CALIBRATE_MS 3600000UL
+#endif
+
+typedef void (*sched_task_t)(void);
+typedef void (*sched_handler_t)(uint8_t event);
+
+/**
+ * Initialize the scheduler and calibrate the watchdog.
+ *
+ * @param handler called from sched_run() for each event posted, may be NULL
+ */
+void sched_init(sched_handler_t handler);
+
+/**
+ * Add a timed task. Deadlines are absolute, a periodic task does not drift
+ * if it runs late or takes a while.
+ *
+ * @param task the function to call
+ * @param delay the time until the first run in ms
+ * @param period the time between runs in ms, 0 runs the task once
+ * @return the task id or -1 if there is no free slot
+ */
+int8_t sched_add(sched_task_t task, uint32_t delay, uint32_t period);
+
+/**
+ * Change the period of a task, its next run is moved relative to the last run.
+ */
+void sched_period(int8_t id, uint32_t period);
+
+/**
+ * Move the next run of a task, e.g. to align it to the wall clock. The period is kept.
+ *
+ * @param id the task
+ * @param delay the time until the next run in ms
+ */
+void sched_delay(int8_t id, uint32_t delay);
+
+/**
+ * Remove a task.
+ */
+void sched_cancel(int8_t id);
+
+/**
+ * Post an event, safe to call from an ISR. Ends a running sleep.
+ *
+ * @param event the event, passed to the handler
+ * @return false if the queue is full
+ */
+bool sched_post(uint8_t event);
+
+/**
+ * The scheduler time in ms, including the time spent in power down.
+ */
+uint32_t sched_now(void);
+
+/**
+ * Handle pending events, run the due tasks and sleep until the next deadline
+ * or event. Call this from the main loop.
+ */
+void sched_run(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _SCHEDULER_H_
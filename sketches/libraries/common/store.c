@@ -0,0 +1,82 @@
+#include <stddef.h>
+#include <string.h>
+#include <avr/eeprom.h>
+#include <util/crc16.h>
+#include "store.h"
+
+#define NO_SLOT 0xff
+
+typedef struct {
+  uint8_t seq;
+  uint8_t size;
+  uint8_t data[STORE_DATA_MAX];
+  uint16_t crc;
+} store_slot_t;
+
+static store_slot_t EEMEM ee_store[STORE_RECORDS][STORE_SLOTS];
+
+// the newest valid slot of each record and its sequence number
+static uint8_t newest[STORE_RECORDS];
+static uint8_t sequence[STORE_RECORDS];
+
+// the id is part of the CRC, a slot is only valid for its own record
+static uint16_t _crc(uint8_t id, const store_slot_t *slot) {
+  uint16_t crc = _crc_ccitt_update(0xffff, id);
+  const uint8_t *p = (const uint8_t *) slot;
+  for (uint8_t i = 0; i < offsetof(store_slot_t, crc); i++) crc = _crc_ccitt_update(crc, p[i]);
+  return crc;
+}
+
+static bool _read(uint8_t id, uint8_t index, store_slot_t *slot) {
+  eeprom_read_block(slot, &ee_store[id][index], sizeof(store_slot_t));
+  return slot->size > 0 && slot->size <= STORE_DATA_MAX && slot->crc == _crc(id, slot);
+}
+
+void store_init(void) {
+  store_slot_t slot;
+  for (uint8_t id = 0; id < STORE_RECORDS; id++) {
+    newest[id] = NO_SLOT;
+    for (uint8_t i = 0; i < STORE_SLOTS; i++) {
+      if (!_read(id, i, &slot)) continue;
+      // sequence numbers wrap, the slots in use are never more than 127 apart
+      if (newest[id] == NO_SLOT || (int8_t) (slot.seq - sequence[id]) > 0) {
+        newest[id] = i;
+        sequence[id] = slot.seq;
+      }
+    }
+  }
+}
+
+bool store_load(uint8_t id, void *data, uint8_t size) {
+  store_slot_t slot;
+  if (id >= STORE_RECORDS || newest[id] == NO_SLOT) return false;
+  if (!_read(id, newest[id], &slot) || slot.size != size) return false;
+  memcpy(data, slot.data, size);
+  return true;
+}
+
+bool store_save(uint8_t id, const void *data, uint8_t size) {
+  store_slot_t slot;
+  if (id >= STORE_RECORDS || size == 0 || size > STORE_DATA_MAX) return false;
+
+  // write on change only
+  if (newest[id] != NO_SLOT && _read(id, newest[id], &slot) &&
+      slot.size == size && !memcmp(slot.data, data, size)) {
+    return true;
+  }
+
+  const uint8_t index = newest[id] == NO_SLOT ? 0 : (uint8_t) ((newest[id] + 1) % STORE_SLOTS);
+  memset(&slot, 0, sizeof(slot));
+  slot.seq = (uint8_t) (sequence[id] + 1);
+  slot.size = size;
+  memcpy(slot.data, data, size);
+  slot.crc = _crc(id, &slot);
+  eeprom_update_block(&slot, &ee_store[id][index], sizeof(store_slot_t));
+
+  // read back, the slot is only used if it was written correctly
+  store_slot_t check;
+  if (!_read(id, index, &check) || memcmp(&check, &slot, sizeof(slot))) return false;
+  newest[id] = index;
+  sequence[id] = slot.seq;
+  return true;
+}
@@ -0,0 +1,55 @@
+#ifndef _STORE_H_
+#define _STORE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// number of records (ids 0 - STORE_RECORDS-1)
+#ifndef STORE_RECORDS
+#  define STORE_RECORDS 2
+#endif
+
+// slots per record, each write goes to the next slot to spread the wear
+#ifndef STORE_SLOTS
+#  define STORE_SLOTS 16
+#endif
+
+// maximum size of a record
+#define STORE_DATA_MAX 8
+
+/**
+ * Find the newest valid slot of each record in EEPROM. A slot is valid if its
+ * CRC matches, so a write interrupted by a reset falls back to the previous one.
+ */
+void store_init(void);
+
+/**
+ * Load a record.
+ *
+ * @param id the record id
+ * @param data the target, left untouched if there is no valid record
+ * @param size the record size, must match the size it was saved with
+ * @return true if the record was loaded
+ */
+bool store_load(uint8_t id, void *data, uint8_t size);
+
+/**
+ * Save a record if it changed. With STORE_SLOTS slots per record, each EEPROM
+ * cell is written only every STORE_SLOTS-th time.
+ *
+ * @param id the record id
+ * @param data the record
+ * @param size the record size (1 - STORE_DATA_MAX)
+ * @return true if the record was written or did not change
+ */
+bool store_save(uint8_t id, const void *data, uint8_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _STORE_H_
@@ -0,0 +1,136 @@
+#include <stddef.h>
+#include <string.h>
+#include <avr/eeprom.h>
+#include <util/crc16.h>
+#include "entropy.h"
+#include "uplink_box.h"
+
+// the shared key and a digest of the keys it was computed from (the first 16 bytes of their SHA-512)
+typedef struct {
+  uint8_t key[crypto_box_curve25519xsalsa20poly1305_BEFORENMBYTES];
+  uint8_t source[crypto_verify_16_BYTES];
+  uint16_t crc;
+} uplink_box_key_t;
+
+// the end of the reserved nonce counters, written alternately so an interrupted write leaves the other
+typedef struct {
+  uint32_t reserved;
+  uint16_t crc;
+} uplink_box_counter_t;
+
+static uplink_box_key_t EEMEM ee_box_key;
+static uplink_box_counter_t EEMEM ee_box_counter[2];
+
+static bool valid = false;
+static uint32_t next = 0;
+static uint32_t reserved = 0;
+// the random part of the nonces since the reset
+static uint8_t prefix[UPLINK_BOX_PREFIXBYTES];
+static bool prefix_drawn = false;
+// the slot written last
+static uint8_t slot = 0;
+
+static uint16_t _crc(uint16_t crc, const uint8_t *data, uint8_t size) {
+  for (uint8_t i = 0; i < size; i++) crc = _crc_ccitt_update(crc, data[i]);
+  return crc;
+}
+
+static bool _read_key(uplink_box_key_t *k) {
+  eeprom_read_block(k, &ee_box_key, sizeof(uplink_box_key_t));
+  return k->crc == _crc(0xffff, (const uint8_t *) k, offsetof(uplink_box_key_t, crc));
+}
+
+static bool _read_counter(uint8_t index, uplink_box_counter_t *counter) {
+  eeprom_read_block(counter, &ee_box_counter[index], sizeof(uplink_box_counter_t));
+  return counter->crc == _crc(0xffff, (const uint8_t *) counter, offsetof(uplink_box_counter_t, crc));
+}
+
+// reserve the next window of counters in the slot not written last
+static bool _reserve(void) {
+  uplink_box_counter_t counter, check;
+  counter.reserved = reserved + UPLINK_BOX_WINDOW;
+  // the counter is 32 bit in the nonce, it must not wrap
+  if (counter.reserved < reserved) return false;
+  counter.crc = _crc(0xffff, (const uint8_t *) &counter, offsetof(uplink_box_counter_t, crc));
+
+  const uint8_t index = (uint8_t) (slot ^ 1);
+  eeprom_update_block(&counter, &ee_box_counter[index], sizeof(uplink_box_counter_t));
+  if (!_read_counter(index, &check) || check.reserved != counter.reserved) return false;
+  slot = index;
+  reserved = counter.reserved;
+  return true;
+}
+
+// the digest identifies the keys, a CRC would keep a stale shared key for 1 in 65536 key changes
+static void _source(uint8_t *source, const uint8_t *secret_key, const uint8_t *peer_key) {
+  crypto_hash_sha512_state state;
+  uint8_t digest[crypto_hash_sha512_BYTES];
+  crypto_hash_sha512_init(&state);
+  crypto_hash_sha512_update(&state, secret_key, UPLINK_BOX_KEYBYTES);
+  crypto_hash_sha512_update(&state, peer_key, UPLINK_BOX_KEYBYTES);
+  crypto_hash_sha512_final(&state, digest);
+  memcpy(source, digest, crypto_verify_16_BYTES);
+  memset(&state, 0, sizeof(state));
+  memset(digest, 0, sizeof(digest));
+}
+
+bool uplink_box_provision(const uint8_t *secret_key, const uint8_t *peer_key) {
+  uplink_box_key_t k;
+  uint8_t source[crypto_verify_16_BYTES];
+  _source(source, secret_key, peer_key);
+  if (_read_key(&k) && crypto_verify_16(k.source, source) == 0) return true;
+
+  crypto_box_curve25519xsalsa20poly1305_beforenm(k.key, peer_key, secret_key);
+  memcpy(k.source, source, sizeof(source));
+  k.crc = _crc(0xffff, (const uint8_t *) &k, offsetof(uplink_box_key_t, crc));
+  eeprom_update_block(&k, &ee_box_key, sizeof(uplink_box_key_t));
+  memset(&k, 0, sizeof(k));
+
+  // read back, a failed write leaves no valid key
+  const bool stored = _read_key(&k) && crypto_verify_16(k.source, source) == 0;
+  memset(&k, 0, sizeof(k));
+  return stored;
+}
+
+bool uplink_box_init(void) {
+  uplink_box_key_t k;
+  valid = _read_key(&k);
+  memset(&k, 0, sizeof(k));
+
+  // continue after the highest reserved counter, the counters of a new key continue as well
+  uplink_box_counter_t counter;
+  reserved = 0;
+  slot = 1;
+  for (uint8_t i = 0; i < 2; i++) {
+    if (_read_counter(i, &counter) && counter.reserved >= reserved) {
+      reserved = counter.reserved;
+      slot = i;
+    }
+  }
+  next = reserved;
+  return valid;
+}
+
+bool uplink_box_seal(uint8_t *c, const uint8_t *m, uint16_t mlen, uint32_t *counter) {
+  if (!valid || (next == reserved && !_reserve())) return false;
+
+  // drawn late, the pool has the samples of the first cycle by now
+  if (!prefix_drawn) randombytes(prefix, sizeof(prefix));
+  prefix_drawn = true;
+
+  uint8_t nonce[crypto_box_curve25519xsalsa20poly1305_NONCEBYTES];
+  nonce[0] = UPLINK_BOX_DIRECTION;
+  memcpy(nonce + 1, prefix, sizeof(prefix));
+  for (uint8_t i = 0; i < 4; i++) nonce[sizeof(nonce) - 1 - i] = (uint8_t) (next >> (8 * i));
+  *counter = next++;
+
+  uplink_box_key_t k;
+  if (!_read_key(&k)) return false;
+  crypto_box_curve25519xsalsa20poly1305_afternm(c, m, mlen, nonce, k.key);
+  memset(&k, 0, sizeof(k));
+  return true;
+}
+
+const uint8_t *uplink_box_prefix(void) {
+  return prefix;
+}
@@ -0,0 +1,74 @@
+#ifndef _UPLINK_BOX_H_
+#define _UPLINK_BOX_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <avrnacl.h>
+
+// a key of the crypto_box with the backend (Curve25519)
+#define UPLINK_BOX_KEYBYTES crypto_box_curve25519xsalsa20poly1305_PUBLICKEYBYTES
+
+// zero bytes in front of the plaintext and the ciphertext (crypto_box_afternm)
+#define UPLINK_BOX_ZEROBYTES crypto_box_curve25519xsalsa20poly1305_ZEROBYTES
+#define UPLINK_BOX_BOXZEROBYTES crypto_box_curve25519xsalsa20poly1305_BOXZEROBYTES
+
+// the first byte of the nonce, a downlink box would use a different one with the same key
+#define UPLINK_BOX_DIRECTION 0x75 // 'u'
+// the random nonce bytes between the direction and the counter, drawn once per reset
+#define UPLINK_BOX_PREFIXBYTES 19
+
+// nonce counters reserved with each EEPROM write, the unused ones are skipped after a reset
+#ifndef UPLINK_BOX_WINDOW
+#  define UPLINK_BOX_WINDOW 32
+#endif
+
+/**
+ * Provision the shared key with the backend: compute it from the device secret
+ * key and the backend public key (crypto_box_beforenm, a Curve25519 scalar
+ * multiplication) and store it in EEPROM. The multiplication is skipped if the
+ * stored key was computed from the same keys.
+ *
+ * @param secret_key the device secret key (UPLINK_BOX_KEYBYTES)
+ * @param peer_key the backend public key (UPLINK_BOX_KEYBYTES)
+ * @return true if the shared key was stored
+ */
+bool uplink_box_provision(const uint8_t *secret_key, const uint8_t *peer_key);
+
+/**
+ * Load the nonce counter, the first counter after a reset is the end of the
+ * last reserved window.
+ *
+ * @return false if no shared key was provisioned
+ */
+bool uplink_box_init(void);
+
+/**
+ * Encrypt and authenticate a message with the shared key (crypto_box_afternm).
+ * The nonce is UPLINK_BOX_DIRECTION, the prefix and the counter (32 bit, big
+ * endian). The counter is never used twice, also across resets, and the prefix
+ * is taken from randombytes() at the first message after a reset, so a lost
+ * counter (e.g. an erased EEPROM) does not repeat a nonce either.
+ *
+ * @param c the ciphertext, starts with UPLINK_BOX_BOXZEROBYTES zeros, may be m
+ * @param m the plaintext, starts with UPLINK_BOX_ZEROBYTES zeros
+ * @param mlen the plaintext length including the zeros
+ * @param counter the nonce counter used, it is sent with the message
+ * @return false if there is no shared key or the counter could not be reserved
+ */
+bool uplink_box_seal(uint8_t *c, const uint8_t *m, uint16_t mlen, uint32_t *counter);
+
+/**
+ * @return the nonce prefix (UPLINK_BOX_PREFIXBYTES), it is sent with each message
+ */
+const uint8_t *uplink_box_prefix(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _UPLINK_BOX_H_
@@ -0,0 +1,51 @@
+#include <string.h>
+#include <avr/eeprom.h>
+#include <util/crc16.h>
+#include "uplink_key.h"
+
+// the midstate of the provisioned key, the CRC does not match in an erased EEPROM
+static struct {
+  uint8_t midstate[crypto_auth_hmacsha512256_MIDSTATEBYTES];
+  uint16_t crc;
+} EEMEM ee_uplink_key;
+
+static uint16_t _crc(const uint8_t *midstate) {
+  uint16_t crc = 0xffff;
+  for (uint8_t i = 0; i < crypto_auth_hmacsha512256_MIDSTATEBYTES; i++) crc = _crc_ccitt_update(crc, midstate[i]);
+  return crc;
+}
+
+// the midstate is read into the state's buffer, it is not needed until the first update
+static bool _read(crypto_auth_hmacsha512256_state *state) {
+  uint8_t *midstate = state->inner.buf;
+  eeprom_read_block(midstate, ee_uplink_key.midstate, sizeof(ee_uplink_key.midstate));
+  return eeprom_read_word(&ee_uplink_key.crc) == _crc(midstate);
+}
+
+bool uplink_key_provision(const uint8_t *key) {
+  crypto_auth_hmacsha512256_state state;
+  uint8_t *midstate = state.inner.buf;
+  crypto_auth_hmacsha512256_midstate(midstate, key);
+  const uint16_t crc = _crc(midstate);
+
+  eeprom_update_block(midstate, ee_uplink_key.midstate, sizeof(ee_uplink_key.midstate));
+  eeprom_update_word(&ee_uplink_key.crc, crc);
+
+  // read back, a failed write leaves no valid key
+  const bool stored = _read(&state) && eeprom_read_word(&ee_uplink_key.crc) == crc;
+  memset(&state, 0, sizeof(state));
+  return stored;
+}
+
+bool uplink_key_valid(void) {
+  crypto_auth_hmacsha512256_state state;
+  const bool valid = _read(&state);
+  memset(&state, 0, sizeof(state));
+  return valid;
+}
+
+bool uplink_key_init(crypto_auth_hmacsha512256_state *state) {
+  if (!_read(state)) return false;
+  crypto_auth_hmacsha512256_init(state, state->inner.buf);
+  return true;
+}
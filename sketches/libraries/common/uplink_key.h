@@ -0,0 +1,44 @@
+#ifndef _UPLINK_KEY_H_
+#define _UPLINK_KEY_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <avrnacl.h>
+
+// the per-device secret for the HMAC-SHA512-256 uplink tag
+#define UPLINK_KEY_BYTES crypto_auth_hmacsha512256_KEYBYTES
+#define UPLINK_TAG_BYTES crypto_auth_hmacsha512256_BYTES
+
+/**
+ * Provision the device key. Only the HMAC midstate of the key (the hashed inner
+ * and outer key blocks) is kept in EEPROM, it is written if it changed.
+ *
+ * @param key the key (UPLINK_KEY_BYTES)
+ * @return true if the midstate was stored
+ */
+bool uplink_key_provision(const uint8_t *key);
+
+/**
+ * @return true if a key was provisioned
+ */
+bool uplink_key_valid(void);
+
+/**
+ * Start a tag from the midstate in EEPROM, so it costs no key block compressions.
+ * Continue with crypto_auth_hmacsha512256_update() and _final().
+ *
+ * @param state the state to initialize
+ * @return false if no key was provisioned
+ */
+bool uplink_key_init(crypto_auth_hmacsha512256_state *state);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _UPLINK_KEY_H_
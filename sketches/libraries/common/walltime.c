@@ -0,0 +1,35 @@
+#include "scheduler.h"
+#include "walltime.h"
+
+// the time in seconds at the scheduler time base_ms
+static uint32_t base_s = 0;
+static uint32_t base_ms = 0;
+
+void walltime_set(uint32_t seconds) {
+  base_ms = sched_now();
+  base_s = seconds;
+}
+
+bool walltime_valid(void) {
+  return base_s != 0;
+}
+
+// milliseconds since the last full second, moves the base forward so the scheduler time can wrap
+static uint16_t _update(void) {
+  uint32_t elapsed = sched_now() - base_ms;
+  base_s += elapsed / 1000;
+  base_ms += elapsed - elapsed % 1000;
+  return (uint16_t) (elapsed % 1000);
+}
+
+uint32_t walltime_now(void) {
+  if (!walltime_valid()) return 0;
+  _update();
+  return base_s;
+}
+
+uint32_t walltime_until(uint16_t period) {
+  if (!walltime_valid() || !period) return 0;
+  uint16_t ms = _update();
+  return (period - base_s % period) * 1000UL - ms;
+}
@@ -0,0 +1,45 @@
+#ifndef _WALLTIME_H_
+#define _WALLTIME_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// seconds between 1970-01-01 and 2000-01-01 (UTC)
+#define WALLTIME_UNIX_OFFSET 946684800UL
+
+/**
+ * Set the current time, e.g. from the network. The time is kept using the
+ * scheduler clock, which includes the (calibrated) time spent sleeping.
+ *
+ * @param seconds seconds since 2000-01-01 00:00:00 UTC
+ */
+void walltime_set(uint32_t seconds);
+
+/**
+ * @return true if the time has been set since the last reset
+ */
+bool walltime_valid(void);
+
+/**
+ * @return the current time in seconds since 2000-01-01 00:00:00 UTC or 0 if unknown
+ */
+uint32_t walltime_now(void);
+
+/**
+ * The time until the next wall clock boundary, e.g. the next full 5 minutes
+ * for a period of 300 seconds.
+ *
+ * @param period the boundary period in seconds
+ * @return milliseconds until the boundary, 0 if the time is unknown
+ */
+uint32_t walltime_until(uint16_t period);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _WALLTIME_H_
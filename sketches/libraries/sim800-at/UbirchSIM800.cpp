@@ -0,0 +1,222 @@
+/**
+ * SIM800 driver on an Arduino Stream.
+ *
+ * Copyright 2016 ubirch GmbH (http://www.ubirch.com)
+ *
+ * == LICENSE ==
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "UbirchSIM800.h"
+
+// the stream of the driver, it is the transport of the AT functions as well
+static Stream *modem = NULL;
+
+extern "C" int at_getc(void) {
+  return modem->read();
+}
+
+extern "C" void at_putc(char c) {
+  modem->write((uint8_t) c);
+}
+
+extern "C" void at_write(const char *buffer, size_t length) {
+  modem->write((const uint8_t *) buffer, length);
+}
+
+extern "C" void at_clear(void) {
+  while (modem->read() >= 0);
+}
+
+// +CREG: 0,1 (the cell is appended in mode 2)
+static const char p_creg_status[] PROGMEM = "+CREG: %*,%u%*";
+static const uint8_t o_status[] PROGMEM = {0};
+static const at_pattern_t at_p_creg_status PROGMEM = {p_creg_status, o_status};
+
+// +SAPBR: 1,1,"10.1.2.3"
+static const char p_sapbr[] PROGMEM = "+SAPBR: 1,%u%*";
+static const at_pattern_t at_p_sapbr PROGMEM = {p_sapbr, o_status};
+
+// +HTTPACTION: 1,200,123
+typedef struct {
+  uint16_t method;
+  uint16_t status;
+  uint32_t length;
+} http_action_t;
+static const char p_httpaction[] PROGMEM = "+HTTPACTION: %u,%u,%U";
+static const uint8_t o_httpaction[] PROGMEM = {
+    offsetof(http_action_t, method), offsetof(http_action_t, status), offsetof(http_action_t, length)
+};
+static const at_pattern_t at_p_httpaction PROGMEM = {p_httpaction, o_httpaction};
+
+// +HTTPREAD: 123 (followed by the data)
+static const char p_httpread[] PROGMEM = "+HTTPREAD: %u";
+static const at_pattern_t at_p_httpread PROGMEM = {p_httpread, o_status};
+
+static const char p_download[] PROGMEM = "DOWNLOAD";
+static const at_pattern_t at_p_download PROGMEM = {p_download, NULL};
+
+static const char p_powerdown[] PROGMEM = "NORMAL POWER DOWN";
+static const at_pattern_t at_p_powerdown PROGMEM = {p_powerdown, NULL};
+
+UbirchSIM800::UbirchSIM800(Stream &serial) : apn(NULL), user(NULL), pass(NULL) {
+  modem = &serial;
+}
+
+void UbirchSIM800::setAPN(const __FlashStringHelper *apn, const __FlashStringHelper *user,
+                          const __FlashStringHelper *pass) {
+  this->apn = apn;
+  this->user = user;
+  this->pass = pass;
+}
+
+// wait until the power status pin has the level
+static bool _power_status(uint8_t level, uint16_t timeout) {
+  unsigned long start = millis();
+  while (digitalRead(SIM800_PS) != level) if (millis() - start > timeout) return false;
+  return true;
+}
+
+// the power key toggles the modem on or off
+static void _power_key() {
+  digitalWrite(SIM800_KEY, LOW);
+  delay(1100);
+  digitalWrite(SIM800_KEY, HIGH);
+}
+
+bool UbirchSIM800::wakeup() {
+  pinMode(SIM800_PS, INPUT);
+  pinMode(SIM800_KEY, OUTPUT);
+  digitalWrite(SIM800_KEY, HIGH);
+
+  if (digitalRead(SIM800_PS) == LOW) {
+    _power_key();
+    if (!_power_status(HIGH, 3000)) return false;
+  }
+
+  // the modem detects the baud rate from the first AT commands after power up,
+  // in standby the first characters only wake it
+  for (uint8_t tries = 0; tries < 10; tries++) {
+    if (at_command_P(PSTR("AT"), NULL, NULL, 300)) {
+      // no command echo, only the responses are read, and no more sleeping
+      return at_command_P(PSTR("ATE0"), NULL, NULL, 500) &&
+             at_command_P(PSTR("AT+CSCLK=0"), NULL, NULL, 500);
+    }
+  }
+  return false;
+}
+
+bool UbirchSIM800::shutdown() {
+  if (digitalRead(SIM800_PS) == LOW) return true;
+
+  at_clear();
+  at_puts_P(PSTR("AT+CPOWD=1\r"));
+  if (!at_expect(&at_p_powerdown, NULL, 3000)) _power_key();
+  return _power_status(LOW, 3000);
+}
+
+bool UbirchSIM800::standby() {
+  return at_command_P(PSTR("AT+CSCLK=2"), NULL, NULL, 500);
+}
+
+bool UbirchSIM800::registerNetwork(uint16_t timeout) {
+  unsigned long start = millis();
+  do {
+    uint16_t status = 0;
+    // registered to the home network or roaming
+    if (at_command_P(PSTR("AT+CREG?"), &at_p_creg_status, &status, 1000) && (status == 1 || status == 5))
+      return true;
+    delay(1000);
+  } while (millis() - start < timeout);
+  return false;
+}
+
+bool UbirchSIM800::bearer(PGM_P parameter, const __FlashStringHelper *value) {
+  at_clear();
+  at_puts_P(PSTR("AT+SAPBR=3,1,\""));
+  at_puts_P(parameter);
+  at_puts_P(PSTR("\",\""));
+  at_puts_P((PGM_P) value);
+  at_puts_P(PSTR("\"\r"));
+  return at_response(NULL, NULL, 1000);
+}
+
+bool UbirchSIM800::enableGPRS(uint16_t timeout) {
+  if (!bearer(PSTR("CONTYPE"), F("GPRS")) || !bearer(PSTR("APN"), apn)) return false;
+  if (user != NULL && !bearer(PSTR("USER"), user)) return false;
+  if (pass != NULL && !bearer(PSTR("PWD"), pass)) return false;
+
+  // fails if the bearer is open already, the query below tells
+  at_command_P(PSTR("AT+SAPBR=1,1"), NULL, NULL, timeout);
+
+  uint16_t status = 0;
+  return at_command_P(PSTR("AT+SAPBR=2,1"), &at_p_sapbr, &status, 1000) && status == 1;
+}
+
+bool UbirchSIM800::disableGPRS() {
+  return at_command_P(PSTR("AT+SAPBR=0,1"), NULL, NULL, 30000);
+}
+
+uint16_t UbirchSIM800::HTTP_post(const char *url, unsigned long &length, const char *buffer, size_t size) {
+  char cmd[32];
+  length = 0;
+
+  // end a session left open by the last request
+  at_command_P(PSTR("AT+HTTPTERM"), NULL, NULL, 1000);
+  if (!at_command_P(PSTR("AT+HTTPINIT"), NULL, NULL, 1000) ||
+      !at_command_P(PSTR("AT+HTTPPARA=\"CID\",1"), NULL, NULL, 1000) ||
+      !at_command_P(PSTR("AT+HTTPPARA=\"CONTENT\",\"application/json\""), NULL, NULL, 1000))
+    return 0;
+
+  at_clear();
+  at_puts_P(PSTR("AT+HTTPPARA=\"URL\",\""));
+  at_write(url, strlen(url));
+  at_puts_P(PSTR("\"\r"));
+  if (!at_response(NULL, NULL, 1000)) return 0;
+
+  // the modem asks for the data and waits up to 10s for it
+  sprintf_P(cmd, PSTR("AT+HTTPDATA=%u,10000\r"), (unsigned int) size);
+  at_clear();
+  at_write(cmd, strlen(cmd));
+  if (!at_expect(&at_p_download, NULL, 2000)) return 0;
+  at_write(buffer, size);
+  if (!at_response(NULL, NULL, 10000)) return 0;
+
+  // the result is reported when the request is done
+  http_action_t action;
+  if (!at_command_P(PSTR("AT+HTTPACTION=1"), NULL, NULL, 1000) ||
+      !at_expect(&at_p_httpaction, &action, 60000))
+    return 0;
+
+  length = action.length;
+  return action.status;
+}
+
+size_t UbirchSIM800::HTTP_read(char *buffer, uint32_t start, size_t length) {
+  char cmd[32];
+  uint16_t available = 0;
+  char lf;
+
+  sprintf_P(cmd, PSTR("AT+HTTPREAD=%lu,%u\r"), (unsigned long) start, (unsigned int) length);
+  at_clear();
+  at_write(cmd, strlen(cmd));
+  if (!at_expect(&at_p_httpread, &available, 5000)) return 0;
+
+  // the data starts after the line end
+  at_read(&lf, 1, 1000);
+  const size_t count = at_read(buffer, available < length ? available : length, 1000);
+  at_response(NULL, NULL, 1000);
+  return count;
+}
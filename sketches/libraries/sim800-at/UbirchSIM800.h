@@ -0,0 +1,138 @@
+/**
+ * SIM800 driver on an Arduino Stream.
+ *
+ * Powers the modem, registers to the network, attaches GPRS and runs HTTP
+ * requests. The modem may be connected to a SoftwareSerial or to the interrupt
+ * driven hardware UART (UARTStream), the driver only sees the Stream:
+ *
+ *   SoftwareSerial sim800_serial(SIM800_RX, SIM800_TX);
+ *   UbirchSIM800 sim800h = UbirchSIM800(sim800_serial);
+ *
+ * The stream is also the transport of the AT functions in sim800_at.h, which
+ * query the battery, location, IMEI and network time without strings.
+ *
+ * Copyright 2016 ubirch GmbH (http://www.ubirch.com)
+ *
+ * == LICENSE ==
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef UBIRCH_SIM800_H
+#define UBIRCH_SIM800_H
+
+#include <Arduino.h>
+#include <Stream.h>
+#include "sim800_at.h"
+
+// the ubirch #1 modem wiring, SIM800_RX/SIM800_TX are only used with a SoftwareSerial
+#ifndef SIM800_RX
+#  define SIM800_RX 2
+#endif
+#ifndef SIM800_TX
+#  define SIM800_TX 3
+#endif
+#ifndef SIM800_KEY
+#  define SIM800_KEY 7
+#endif
+#ifndef SIM800_PS
+#  define SIM800_PS 8
+#endif
+
+// the SoftwareSerial is not reliable at higher rates, the hardware UART uses SIM800_BAUD
+#ifndef SIM800_SOFT_BAUD
+#  define SIM800_SOFT_BAUD 9600
+#endif
+
+// the largest piece HTTP_read() should be asked for on a SoftwareSerial (its receive buffer)
+#ifndef SIM800_BUFSIZE
+#  define SIM800_BUFSIZE 64
+#endif
+
+class UbirchSIM800 {
+public:
+  /**
+   * Use the stream to talk to the modem. The stream must be started (begin()) by the caller.
+   */
+  UbirchSIM800(Stream &serial);
+
+  /**
+   * Set the GPRS access point, the strings must stay valid (PROGMEM).
+   */
+  void setAPN(const __FlashStringHelper *apn, const __FlashStringHelper *user, const __FlashStringHelper *pass);
+
+  /**
+   * Power up the modem (if necessary) and wait until it answers.
+   * @return true if the modem is ready
+   */
+  bool wakeup();
+
+  /**
+   * Power down the modem.
+   * @return true if the modem is off
+   */
+  bool shutdown();
+
+  /**
+   * Let the modem sleep whenever it is idle (slow clock). It stays registered and pulls
+   * its RI pin low for an incoming call or SMS. The next wakeup() ends the sleep.
+   */
+  bool standby();
+
+  /**
+   * Wait until the modem is registered to the home network or roaming.
+   * @param timeout the maximum time to wait in milliseconds
+   */
+  bool registerNetwork(uint16_t timeout);
+
+  /**
+   * Open the GPRS bearer (profile 1) with the access point set before.
+   * @param timeout the maximum time to wait for the bearer in milliseconds
+   */
+  bool enableGPRS(uint16_t timeout = 30000);
+
+  /**
+   * Close the GPRS bearer.
+   */
+  bool disableGPRS();
+
+  /**
+   * POST data to the url (application/json). The response stays in the modem until
+   * it is read with HTTP_read().
+   *
+   * @param url the url to post to
+   * @param length the length of the response
+   * @param buffer the data to send
+   * @param size the length of the data
+   * @return the HTTP status or 0 if the request could not be made
+   */
+  uint16_t HTTP_post(const char *url, unsigned long &length, const char *buffer, size_t size);
+
+  /**
+   * Read a part of the last HTTP response.
+   *
+   * @param buffer the buffer to read into
+   * @param start the position in the response
+   * @param length the number of bytes to read
+   * @return the number of bytes read
+   */
+  size_t HTTP_read(char *buffer, uint32_t start, size_t length);
+
+private:
+  const __FlashStringHelper *apn;
+  const __FlashStringHelper *user;
+  const __FlashStringHelper *pass;
+
+  bool bearer(PGM_P parameter, const __FlashStringHelper *value);
+};
+
+#endif //UBIRCH_SIM800_H
@@ -0,0 +1,77 @@
+/**
+ * Cache for the approximate GSM location.
+ *
+ * Copyright 2016 ubirch GmbH (http://www.ubirch.com)
+ *
+ * == LICENSE ==
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+#include "location_cache.h"
+
+static bool _moved(int32_t a, int32_t b) {
+  int32_t d = a - b;
+  return d > LOCATION_CACHE_TOLERANCE || d < -LOCATION_CACHE_TOLERANCE;
+}
+
+void location_cache_init(location_cache_t *cache) {
+  memset(cache, 0, sizeof(*cache));
+}
+
+bool location_cache_due(location_cache_t *cache, const sim800_cell_t *cell, uint16_t refresh) {
+  if (cache->age < UINT16_MAX) cache->age++;
+
+  if (!(cache->flags & LOCATION_VALID) || (cache->flags & LOCATION_REQUESTED)) return true;
+  if (refresh && cache->age >= refresh) return true;
+  // a cell change is only meaningful if both cells are known
+  return cell != NULL && (cache->flags & LOCATION_CELL) &&
+         (cell->lac != cache->cell.lac || cell->cell != cache->cell.cell);
+}
+
+bool location_cache_update(location_cache_t *cache, const sim800_location_t *fix, const sim800_cell_t *cell) {
+  bool changed = !(cache->flags & LOCATION_VALID) ||
+                 _moved(fix->lat, cache->fix.lat) || _moved(fix->lon, cache->fix.lon);
+
+  // keep the reported coordinates if the fix just jitters, but take the new time
+  if (changed) {
+    cache->fix = *fix;
+    cache->flags |= LOCATION_CHANGED;
+  } else {
+    cache->fix.time = fix->time;
+  }
+
+  if (cell != NULL) {
+    cache->cell = *cell;
+    cache->flags |= LOCATION_CELL;
+  } else {
+    cache->flags &= ~LOCATION_CELL;
+  }
+
+  cache->age = 0;
+  cache->flags |= LOCATION_VALID;
+  cache->flags &= ~LOCATION_REQUESTED;
+  return changed;
+}
+
+void location_cache_request(location_cache_t *cache) {
+  cache->flags |= LOCATION_REQUESTED;
+}
+
+bool location_cache_changed(const location_cache_t *cache) {
+  return (cache->flags & LOCATION_CHANGED) != 0;
+}
+
+void location_cache_reported(location_cache_t *cache) {
+  cache->flags &= ~LOCATION_CHANGED;
+}
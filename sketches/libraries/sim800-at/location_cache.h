@@ -0,0 +1,98 @@
+/**
+ * Cache for the approximate GSM location.
+ *
+ * Querying the location (AT+CIPGSMLOC) is a slow network round-trip and for fixed
+ * installations the result hardly ever changes. The cache decides when a new fix is
+ * needed: every n-th cycle, if the serving cell changed or if the backend asked for
+ * it. A new fix is only reported if it moved more than LOCATION_CACHE_TOLERANCE.
+ *
+ * Copyright 2016 ubirch GmbH (http://www.ubirch.com)
+ *
+ * == LICENSE ==
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef UBIRCH_LOCATION_CACHE_H
+#define UBIRCH_LOCATION_CACHE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "sim800_at.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// GSM locations jitter, ignore changes below this (millionths of a degree, ~100m)
+#ifndef LOCATION_CACHE_TOLERANCE
+#  define LOCATION_CACHE_TOLERANCE 1000
+#endif
+
+// cache flags
+#define LOCATION_VALID     0x01 // the cache holds a fix
+#define LOCATION_CHANGED   0x02 // the fix has not been reported yet
+#define LOCATION_REQUESTED 0x04 // refresh on the next cycle
+#define LOCATION_CELL      0x08 // the cell is known
+
+typedef struct {
+  sim800_location_t fix; // the last fix
+  sim800_cell_t cell;    // the serving cell at the last fix
+  uint16_t age;          // cycles since the last fix
+  uint8_t flags;
+} location_cache_t;
+
+/**
+ * Initialize an empty cache, the first check will ask for a fix.
+ */
+void location_cache_init(location_cache_t *cache);
+
+/**
+ * Check whether a new fix is needed, call this once per cycle.
+ *
+ * @param cache the cache
+ * @param cell the current serving cell or NULL if unknown
+ * @param refresh refresh after this many cycles, 0 never refreshes by age
+ * @return true if the location should be queried
+ */
+bool location_cache_due(location_cache_t *cache, const sim800_cell_t *cell, uint16_t refresh);
+
+/**
+ * Store a new fix and mark it as changed if it moved.
+ *
+ * @param cache the cache
+ * @param fix the location just queried
+ * @param cell the serving cell at the time of the fix or NULL if unknown
+ * @return true if the location changed
+ */
+bool location_cache_update(location_cache_t *cache, const sim800_location_t *fix, const sim800_cell_t *cell);
+
+/**
+ * Ask for a new fix in the next cycle (e.g. requested by the backend).
+ */
+void location_cache_request(location_cache_t *cache);
+
+/**
+ * @return true if the fix changed and needs to be reported
+ */
+bool location_cache_changed(const location_cache_t *cache);
+
+/**
+ * Mark the current fix as reported.
+ */
+void location_cache_reported(location_cache_t *cache);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //UBIRCH_LOCATION_CACHE_H
@@ -0,0 +1,365 @@
+/**
+ * Streaming AT response matcher for the SIM800.
+ *
+ * Copyright 2016 ubirch GmbH (http://www.ubirch.com)
+ *
+ * == LICENSE ==
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+#include <Arduino.h>
+#include "sim800_at.h"
+
+// +CIPGSMLOC: 0,13.475882,52.505257,2016/06/09,12:34:56 (longitude first)
+static const char p_cipgsmloc[] PROGMEM = "+CIPGSMLOC: 0,%f,%f,%d,%t";
+static const uint8_t o_cipgsmloc[] PROGMEM = {
+    offsetof(sim800_location_t, lon), offsetof(sim800_location_t, lat),
+    offsetof(sim800_location_t, time), offsetof(sim800_location_t, time)
+};
+const at_pattern_t AT_P_CIPGSMLOC PROGMEM = {p_cipgsmloc, o_cipgsmloc};
+
+// +CBC: 0,100,4200
+static const char p_cbc[] PROGMEM = "+CBC: %u,%u,%u";
+static const uint8_t o_cbc[] PROGMEM = {
+    offsetof(sim800_battery_t, status), offsetof(sim800_battery_t, percent), offsetof(sim800_battery_t, voltage)
+};
+const at_pattern_t AT_P_CBC PROGMEM = {p_cbc, o_cbc};
+
+// 123456789012345
+static const char p_gsn[] PROGMEM = "%15s";
+static const uint8_t o_gsn[] PROGMEM = {0};
+const at_pattern_t AT_P_GSN PROGMEM = {p_gsn, o_gsn};
+
+// +CREG: 2,1,"1A2B","3C4D"
+static const char p_creg[] PROGMEM = "+CREG: %*,%*,\"%x\",\"%x\"";
+static const uint8_t o_creg[] PROGMEM = {offsetof(sim800_cell_t, lac), offsetof(sim800_cell_t, cell)};
+const at_pattern_t AT_P_CREG PROGMEM = {p_creg, o_creg};
+
+// +CCLK: "16/06/09,14:34:56+08" (local time and zone in quarter hours)
+static const char p_cclk[] PROGMEM = "+CCLK: \"%d,%t%i\"";
+static const uint8_t o_cclk[] PROGMEM = {
+    offsetof(sim800_clock_t, time), offsetof(sim800_clock_t, time), offsetof(sim800_clock_t, zone)
+};
+const at_pattern_t AT_P_CCLK PROGMEM = {p_cclk, o_cclk};
+
+// cumulative days before each month (non-leap year)
+static const uint16_t month_days[12] PROGMEM = {0, 31, 59, 90, 120, 151, 181, 212, 243, 273, 304, 334};
+
+// rewind to the beginning of the pattern
+static void _reset(at_matcher_t *m) {
+  m->pos = m->start;
+  m->offsets = m->offsets_start;
+  m->state = AT_MATCHING;
+  m->conversion = 0;
+}
+
+void at_match_init(at_matcher_t *matcher, const at_pattern_t *pattern, void *out) {
+  at_pattern_t p;
+  memcpy_P(&p, pattern, sizeof(p));
+  matcher->start = p.pattern;
+  matcher->offsets_start = p.offsets;
+  matcher->out = (uint8_t *) out;
+  _reset(matcher);
+}
+
+static void _start_conversion(at_matcher_t *m) {
+  uint8_t width = 0;
+  char c;
+  while ((c = pgm_read_byte(++m->pos)) >= '0' && c <= '9') width = (uint8_t) (width * 10 + (c - '0'));
+  m->pos++;
+  m->conversion = c;
+  m->width = width;
+  m->digits = 0;
+  m->fraction = 0xff;
+  m->part = 0;
+  m->negative = false;
+  m->value = 0;
+  m->parts[0] = m->parts[1] = m->parts[2] = 0;
+}
+
+// accept a character into the current conversion, returns false if it does not belong to it
+static bool _accept(at_matcher_t *m, char c) {
+  bool digit = c >= '0' && c <= '9';
+
+  switch (m->conversion) {
+    case '*':
+      return c != (char) pgm_read_byte(m->pos);
+    case 's':
+      if (!digit || m->digits >= m->width) return false;
+      m->out[pgm_read_byte(m->offsets) + m->digits++] = (uint8_t) c;
+      return true;
+    case 'd':
+    case 't':
+      if (c == (m->conversion == 'd' ? '/' : ':') && m->part < 2) {
+        m->part++;
+        return true;
+      }
+      if (!digit) return false;
+      m->parts[m->part] = (uint16_t) (m->parts[m->part] * 10 + (c - '0'));
+      m->digits++;
+      return true;
+    case 'x':
+      if (c >= 'a' && c <= 'f') c -= 'a' - 'A';
+      if (c >= 'A' && c <= 'F') c -= 'A' - ('9' + 1);
+      else if (!digit) return false;
+      m->value = (m->value << 4) + (c - '0');
+      m->digits++;
+      return true;
+    case 'f':
+      if (c == '.' && m->fraction == 0xff) {
+        m->fraction = 0;
+        return true;
+      }
+      // fall through
+    case 'i':
+      if ((c == '-' || c == '+') && !m->digits && !m->negative) {
+        m->negative = c == '-';
+        return true;
+      }
+      // fall through
+    default:
+      if (!digit) return false;
+      if (m->fraction < 0xff) {
+        // ignore additional fraction digits
+        if (m->fraction >= 6) return true;
+        m->fraction++;
+      }
+      m->value = m->value * 10 + (c - '0');
+      m->digits++;
+      return true;
+  }
+}
+
+// store the converted value into the output structure, returns false if the field was empty
+static bool _store(at_matcher_t *m) {
+  char conversion = m->conversion;
+  m->conversion = 0;
+
+  if (conversion == '*') return true;
+  if (!m->digits) return false;
+
+  uint8_t *field = m->out + pgm_read_byte(m->offsets++);
+  switch (conversion) {
+    case 'u':
+    case 'x':
+      *(uint16_t *) field = (uint16_t) m->value;
+      break;
+    case 'U':
+      *(uint32_t *) field = (uint32_t) m->value;
+      break;
+    case 'i':
+      *(int16_t *) field = (int16_t) (m->negative ? -m->value : m->value);
+      break;
+    case 'f': {
+      uint8_t fraction = m->fraction == 0xff ? 0 : m->fraction;
+      while (fraction++ < 6) m->value *= 10;
+      *(int32_t *) field = m->negative ? -m->value : m->value;
+      break;
+    }
+    case 'd': {
+      uint16_t year = m->parts[0] < 100 ? m->parts[0] : m->parts[0] - 2000;
+      uint8_t month = (uint8_t) (m->parts[1] ? m->parts[1] - 1 : 0);
+      if (month > 11) return false;
+      uint16_t days = (uint16_t) (365 * year + (year + 3) / 4 + pgm_read_word(&month_days[month]));
+      if (month > 1 && !(year & 3)) days++;
+      days += m->parts[2] ? m->parts[2] - 1 : 0;
+      *(uint32_t *) field = days * 86400UL;
+      break;
+    }
+    case 't':
+      *(uint32_t *) field += m->parts[0] * 3600UL + m->parts[1] * 60UL + m->parts[2];
+      break;
+    case 's':
+      field[m->digits] = '\0';
+      break;
+    default:
+      return false;
+  }
+  return true;
+}
+
+uint8_t at_match_feed(at_matcher_t *matcher, char c) {
+  at_matcher_t *m = matcher;
+  bool eol = c == '\r' || c == '\n';
+
+  if (m->state == AT_MATCHED) return AT_MATCHED;
+  if (m->state == AT_SKIP) {
+    if (eol) _reset(m);
+    return AT_MATCHING;
+  }
+
+  // a running conversion ends with the first character it does not accept
+  if (m->conversion) {
+    if (!eol && _accept(m, c)) return AT_MATCHING;
+    if (!_store(m)) {
+      m->state = AT_SKIP;
+      if (eol) _reset(m);
+      return AT_MATCHING;
+    }
+  }
+
+  char p = (char) pgm_read_byte(m->pos);
+  if (eol) {
+    // a trailing %* matches an empty rest of the line as well
+    if (p == '%' && pgm_read_byte(m->pos + 1) == '*' && !pgm_read_byte(m->pos + 2)) p = '\0';
+    if (p == '\0' && m->pos != m->start) {
+      m->state = AT_MATCHED;
+      return AT_MATCHED;
+    }
+    _reset(m);
+    return AT_MATCHING;
+  }
+
+  if (p == '%') {
+    _start_conversion(m);
+    if (_accept(m, c)) return AT_MATCHING;
+    // an empty conversion only works for %*, continue with the literal
+    if (!_store(m)) {
+      m->state = AT_SKIP;
+      return AT_MATCHING;
+    }
+    p = (char) pgm_read_byte(m->pos);
+  }
+
+  if (p == c) {
+    m->pos++;
+  } else {
+    m->state = AT_SKIP;
+  }
+  return AT_MATCHING;
+}
+
+bool at_match_str(const at_pattern_t *pattern, void *out, const char *str) {
+  at_matcher_t matcher;
+  at_match_init(&matcher, pattern, out);
+  while (*str) at_match_feed(&matcher, *str++);
+  return at_match_feed(&matcher, '\n') == AT_MATCHED;
+}
+
+char *at_fixed6_str(char *buffer, int32_t value) {
+  uint32_t abs_value = (uint32_t) (value < 0 ? -value : value);
+  sprintf_P(buffer, PSTR("%s%lu.%06lu"), value < 0 ? "-" : "",
+            (unsigned long) (abs_value / 1000000UL), (unsigned long) (abs_value % 1000000UL));
+  return buffer;
+}
+
+void at_puts_P(PGM_P str) {
+  char c;
+  while ((c = (char) pgm_read_byte(str++))) at_putc(c);
+}
+
+size_t at_read(char *buffer, size_t length, uint16_t timeout) {
+  size_t count = 0;
+  unsigned long last = millis();
+  while (count < length && millis() - last < timeout) {
+    int c = at_getc();
+    if (c < 0) continue;
+    buffer[count++] = (char) c;
+    last = millis();
+  }
+  return count;
+}
+
+// the final result codes, only the start of a line is needed
+#define AT_OK     1
+#define AT_ERROR  2
+
+static uint8_t _result(const char *line) {
+  if (!strcmp_P(line, PSTR("OK"))) return AT_OK;
+  if (!strcmp_P(line, PSTR("ERROR")) || !strncmp_P(line, PSTR("+CME ERROR"), 10)) return AT_ERROR;
+  return 0;
+}
+
+// feed the modem output into the matcher (if any) until the wanted result, an error or the timeout
+static bool _receive(const at_pattern_t *pattern, void *out, uint16_t timeout, bool until_ok) {
+  at_matcher_t matcher;
+  bool matched = pattern == NULL;
+  char line[12];
+  uint8_t length = 0;
+
+  if (pattern != NULL) at_match_init(&matcher, pattern, out);
+
+  unsigned long start = millis();
+  while (millis() - start < timeout) {
+    int c = at_getc();
+    if (c < 0) continue;
+
+    if (!matched) {
+      matched = at_match_feed(&matcher, (char) c) == AT_MATCHED;
+      if (matched && !until_ok) return true;
+    }
+
+    if (c == '\r' || c == '\n') {
+      line[length] = '\0';
+      switch (_result(line)) {
+        case AT_OK:
+          if (until_ok) return matched;
+          break;
+        case AT_ERROR:
+          return false;
+        default:
+          break;
+      }
+      length = 0;
+    } else if (length < sizeof(line) - 1) {
+      line[length++] = (char) c;
+    }
+  }
+  return false;
+}
+
+bool at_expect(const at_pattern_t *pattern, void *out, uint16_t timeout) {
+  return _receive(pattern, out, timeout, false);
+}
+
+bool at_response(const at_pattern_t *pattern, void *out, uint16_t timeout) {
+  return _receive(pattern, out, timeout, true);
+}
+
+bool at_command_P(PGM_P cmd, const at_pattern_t *pattern, void *out, uint16_t timeout) {
+  at_clear();
+  at_puts_P(cmd);
+  at_putc('\r');
+  return at_response(pattern, out, timeout);
+}
+
+bool sim800_location(sim800_location_t *location) {
+  return at_command_P(PSTR("AT+CIPGSMLOC=1,1"), &AT_P_CIPGSMLOC, location, 10000);
+}
+
+bool sim800_battery(sim800_battery_t *battery) {
+  return at_command_P(PSTR("AT+CBC"), &AT_P_CBC, battery, 1000);
+}
+
+bool sim800_imei(char *imei) {
+  return at_command_P(PSTR("AT+GSN"), &AT_P_GSN, imei, 1000) && strlen(imei) == 15;
+}
+
+bool sim800_time(uint32_t *time) {
+  sim800_clock_t clock;
+  // let the modem take the time from the network, the clock starts in 2004 otherwise
+  if (!at_command_P(PSTR("AT+CLTS=1"), NULL, NULL, 1000) ||
+      !at_command_P(PSTR("AT+CCLK?"), &AT_P_CCLK, &clock, 1000))
+    return false;
+  if (clock.time < SIM800_TIME_MIN) return false;
+  *time = clock.time - clock.zone * 900L;
+  return true;
+}
+
+bool sim800_cell(sim800_cell_t *cell) {
+  // the location area and cell id are only reported in mode 2
+  return at_command_P(PSTR("AT+CREG=2"), NULL, NULL, 1000) &&
+         at_command_P(PSTR("AT+CREG?"), &AT_P_CREG, cell, 1000);
+}
+
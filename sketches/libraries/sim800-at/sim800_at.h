@@ -0,0 +1,237 @@
+/**
+ * Streaming AT response matcher for the SIM800.
+ *
+ * Responses are matched character by character against patterns stored in
+ * program memory. Numeric fields are converted while they arrive and stored
+ * directly into typed output structures, no intermediate strings are kept.
+ *
+ * Pattern syntax (everything else must match literally, matching is line based):
+ *
+ *   %u  unsigned decimal            -> uint16_t
+ *   %U  unsigned decimal            -> uint32_t
+ *   %i  signed decimal (+/-)        -> int16_t
+ *   %x  hexadecimal                 -> uint16_t
+ *   %f  decimal fraction, 6 digits  -> int32_t (value * 1000000)
+ *   %d  date yyyy/mm/dd or yy/mm/dd -> uint32_t (seconds since 2000-01-01, sets the field)
+ *   %t  time hh:mm:ss               -> uint32_t (seconds of the day, adds to the field)
+ *   %Ns digit string, max N digits  -> char[N+1]
+ *   %*  skip until the next literal character
+ *
+ * Each conversion (except %*) takes the next offset from the patterns offset table.
+ *
+ * Copyright 2016 ubirch GmbH (http://www.ubirch.com)
+ *
+ * == LICENSE ==
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef UBIRCH_SIM800_AT_H
+#define UBIRCH_SIM800_AT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <avr/pgmspace.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// matcher states
+#define AT_MATCHING 0
+#define AT_MATCHED  1
+#define AT_SKIP     2
+
+// the size of a formatted fixed point coordinate string including terminator ("-180.000000")
+#define AT_FIXED6_STRLEN 12
+
+// network times before 2016-01-01 are not plausible (seconds since 2000-01-01)
+#define SIM800_TIME_MIN 504921600UL
+
+// a response pattern and the output offsets of its conversions, both in PROGMEM
+typedef struct {
+  PGM_P pattern;
+  const uint8_t *offsets;
+} at_pattern_t;
+
+typedef struct {
+  PGM_P start;            // start of the pattern
+  PGM_P pos;              // current pattern position
+  const uint8_t *offsets_start;
+  const uint8_t *offsets; // next output offset
+  uint8_t *out;           // the output structure
+  uint8_t state;          // AT_MATCHING, AT_MATCHED or AT_SKIP
+  char conversion;        // active conversion or 0
+  uint8_t width;          // %s maximum width
+  uint8_t digits;         // digits seen in the current conversion
+  uint8_t fraction;       // fraction digits seen (%f), 0xff before the decimal point
+  uint8_t part;           // current date/time part
+  bool negative;
+  int32_t value;
+  uint16_t parts[3];
+} at_matcher_t;
+
+// the approximate location and network time (from AT+CIPGSMLOC)
+typedef struct {
+  int32_t lat;   // latitude in millionths of a degree
+  int32_t lon;   // longitude in millionths of a degree
+  uint32_t time; // seconds since 2000-01-01 00:00:00 UTC
+} sim800_location_t;
+
+// battery charge state (from AT+CBC)
+typedef struct {
+  uint16_t status;  // 0 not charging, 1 charging, 2 charged
+  uint16_t percent; // 0-100
+  uint16_t voltage; // in mV
+} sim800_battery_t;
+
+// the network time (from AT+CCLK?)
+typedef struct {
+  uint32_t time; // local time, seconds since 2000-01-01 00:00:00
+  int16_t zone;  // time zone in quarter hours
+} sim800_clock_t;
+
+// the serving cell (from AT+CREG? with AT+CREG=2)
+typedef struct {
+  uint16_t lac;  // location area code
+  uint16_t cell; // cell id
+} sim800_cell_t;
+
+extern const at_pattern_t AT_P_CIPGSMLOC PROGMEM;
+extern const at_pattern_t AT_P_CBC PROGMEM;
+extern const at_pattern_t AT_P_GSN PROGMEM;
+extern const at_pattern_t AT_P_CREG PROGMEM;
+extern const at_pattern_t AT_P_CCLK PROGMEM;
+
+/**
+ * Initialize a matcher.
+ * @param matcher the matcher state
+ * @param pattern the pattern table entry (PROGMEM)
+ * @param out the output structure
+ */
+void at_match_init(at_matcher_t *matcher, const at_pattern_t *pattern, void *out);
+
+/**
+ * Feed a single received character into the matcher. Lines that do not match
+ * are skipped. The output structure is only valid after AT_MATCHED was returned.
+ *
+ * @param matcher the matcher state
+ * @param c the character received
+ * @return AT_MATCHED if a line matched completely, else AT_MATCHING
+ */
+uint8_t at_match_feed(at_matcher_t *matcher, char c);
+
+/**
+ * Match a string (in RAM) against a pattern.
+ * @param pattern the pattern table entry (PROGMEM)
+ * @param out the output structure
+ * @param str the string to match, the end of the string ends the line
+ * @return true if the string matched
+ */
+bool at_match_str(const at_pattern_t *pattern, void *out, const char *str);
+
+/**
+ * Format a fixed point value (millionths) as a decimal string.
+ * @param buffer the target, at least AT_FIXED6_STRLEN bytes
+ * @param value the fixed point value
+ * @return the buffer
+ */
+char *at_fixed6_str(char *buffer, int32_t value);
+
+/**
+ * The modem connection, implemented by the UbirchSIM800 on the stream it was created with.
+ */
+int at_getc(void);
+void at_putc(char c);
+void at_write(const char *buffer, size_t length);
+void at_clear(void);
+
+/**
+ * Send a zero terminated string located in program memory to the modem.
+ */
+void at_puts_P(PGM_P str);
+
+/**
+ * Read a number of raw bytes (e.g. HTTP data) from the modem.
+ *
+ * @param buffer the buffer to read into
+ * @param length the number of bytes to read
+ * @param timeout maximum time to wait for the next byte in milliseconds
+ * @return the number of bytes read
+ */
+size_t at_read(char *buffer, size_t length, uint16_t timeout);
+
+/**
+ * Wait for a line matching the pattern, e.g. an unsolicited result or a prompt.
+ *
+ * @param pattern the expected line (PROGMEM)
+ * @param out the output structure
+ * @param timeout the maximum time to wait in milliseconds
+ * @return true if the line matched before an ERROR was received
+ */
+bool at_expect(const at_pattern_t *pattern, void *out, uint16_t timeout);
+
+/**
+ * Match the response of an AT command that has already been sent, until OK or ERROR is received.
+ *
+ * @param pattern the expected response pattern (PROGMEM) or NULL if only OK is expected
+ * @param out the output structure
+ * @param timeout the maximum time to wait in milliseconds
+ * @return true if the modem returned OK and the response matched
+ */
+bool at_response(const at_pattern_t *pattern, void *out, uint16_t timeout);
+
+/**
+ * Send an AT command and match the response until OK or ERROR is received.
+ *
+ * @param cmd the command (PROGMEM) without line ending
+ * @param pattern the expected response pattern (PROGMEM) or NULL if only OK is expected
+ * @param out the output structure
+ * @param timeout the maximum time to wait in milliseconds
+ * @return true if the modem returned OK and the response matched
+ */
+bool at_command_P(PGM_P cmd, const at_pattern_t *pattern, void *out, uint16_t timeout);
+
+/**
+ * Query the approximate location and network time (the GPRS bearer must be up).
+ */
+bool sim800_location(sim800_location_t *location);
+
+/**
+ * Query the battery state.
+ */
+bool sim800_battery(sim800_battery_t *battery);
+
+/**
+ * Query the IMEI.
+ * @param imei a buffer for 15 digits and the terminator
+ */
+bool sim800_imei(char *imei);
+
+/**
+ * Query the serving cell, the network must be registered.
+ */
+bool sim800_cell(sim800_cell_t *cell);
+
+/**
+ * Query the network time (NITZ). The clock is only valid if the network sends the time.
+ * @param time seconds since 2000-01-01 00:00:00 UTC
+ * @return true if the modem returned a plausible time
+ */
+bool sim800_time(uint32_t *time);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //UBIRCH_SIM800_AT_H
@@ -0,0 +1,140 @@
+/**
+ * Baud rate negotiation for the SIM800 on the hardware UART.
+ *
+ * Copyright 2016 ubirch GmbH (http://www.ubirch.com)
+ *
+ * == LICENSE ==
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifdef SIM800_HW_UART
+
+#include <stdio.h>
+#include <string.h>
+#include <avr/eeprom.h>
+#include <uart.h>
+#include "sim800_at.h"
+#include "sim800_baud.h"
+
+// rates supported by the SIM800, highest first (230400 has a 3.5% error at 16MHz, it may not work)
+static const uint32_t rates[] PROGMEM = {230400, 115200, 57600, 38400, 19200, 9600};
+#define RATE_COUNT (sizeof(rates) / sizeof(rates[0]))
+
+static uint32_t EEMEM ee_baud = 0xffffffff;
+static sim800_baud_stats_t stats = {0, 0, 0};
+
+static uint32_t _rate(uint8_t index) {
+  return pgm_read_dword(&rates[index]);
+}
+
+static uint8_t _index(uint32_t baud) {
+  for (uint8_t i = 0; i < RATE_COUNT; i++) if (_rate(i) == baud) return i;
+  return RATE_COUNT;
+}
+
+static void _use(uint32_t baud) {
+  uart_set_baud(baud);
+  stats.baud = baud;
+  stats.checks = 0;
+  stats.errors = 0;
+}
+
+// keep a working rate in EEPROM and in the modem profile (AT&W), the modem would start
+// auto-bauding again after a power down and miss the first commands at a fixed UART rate
+static void _store(uint32_t baud) {
+  eeprom_update_dword(&ee_baud, baud);
+  at_command_P(PSTR("AT&W"), NULL, NULL, 1000);
+}
+
+// a single link check, the IMEI reply is long enough to catch garbled characters
+static bool _check(void) {
+  char imei[16];
+  uart_errors();
+  return at_command_P(PSTR("AT"), NULL, NULL, 500) && sim800_imei(imei) && !uart_errors();
+}
+
+static bool _probe(void) {
+  for (uint8_t i = 0; i < SIM800_BAUD_PROBES; i++) if (!_check()) return false;
+  return true;
+}
+
+// ask the modem to change its rate, it answers OK at the old rate and switches afterwards
+static bool _switch(uint32_t baud) {
+  char cmd[20];
+  sprintf_P(cmd, PSTR("AT+IPR=%lu\r"), (unsigned long) baud);
+  at_clear();
+  at_write(cmd, strlen(cmd));
+  if (!at_response(NULL, NULL, 1000)) return false;
+  _use(baud);
+  return true;
+}
+
+uint32_t sim800_baud_load(void) {
+  uint32_t baud = eeprom_read_dword(&ee_baud);
+  return _index(baud) < RATE_COUNT ? baud : SIM800_BAUD;
+}
+
+uint32_t sim800_baud_detect(void) {
+  // try the last known rate first, then all others
+  uint32_t baud = stats.baud ? stats.baud : sim800_baud_load();
+  for (uint8_t i = 0; i <= RATE_COUNT; i++) {
+    if (i > 0) baud = _rate(i - 1);
+    _use(baud);
+    // the first AT may be swallowed by the modems auto-bauding, try twice
+    if (at_command_P(PSTR("AT"), NULL, NULL, 300) || at_command_P(PSTR("AT"), NULL, NULL, 300)) return baud;
+  }
+  stats.baud = 0;
+  return 0;
+}
+
+uint32_t sim800_baud_negotiate(void) {
+  uint32_t current = sim800_baud_detect();
+  if (!current) return 0;
+
+  // go down from the highest rate until one works, the current rate is known to work
+  for (uint8_t i = 0; i < _index(current); i++) {
+    if (_switch(_rate(i)) && _probe()) {
+      current = _rate(i);
+      break;
+    }
+    // the link is broken at this rate, find the modem again
+    current = sim800_baud_detect();
+    if (!current) return 0;
+  }
+
+  _use(current);
+  _store(current);
+  return current;
+}
+
+bool sim800_baud_check(void) {
+  bool ok = _check();
+  stats.checks++;
+  if (!ok) stats.errors++;
+
+  if (stats.errors > 1 && stats.errors * SIM800_BAUD_MAX_ERROR_RATIO > stats.checks) {
+    uint8_t lower = (uint8_t) (_index(stats.baud) + 1);
+    if (lower < RATE_COUNT) {
+      // switch down, if the modem did not follow find it again
+      if (!_switch(_rate(lower)) || !at_command_P(PSTR("AT"), NULL, NULL, 500)) sim800_baud_detect();
+      if (stats.baud) _store(stats.baud);
+    }
+  }
+  return ok;
+}
+
+const sim800_baud_stats_t *sim800_baud_stats(void) {
+  return &stats;
+}
+
+#endif
@@ -0,0 +1,89 @@
+/**
+ * Baud rate negotiation for the SIM800 on the hardware UART.
+ *
+ * At startup the highest baud rate that works reliably with the wiring is probed
+ * and stored in EEPROM and in the modem profile. During operation every check is counted and the rate is
+ * lowered if the link produces too many errors.
+ *
+ * Copyright 2016 ubirch GmbH (http://www.ubirch.com)
+ *
+ * == LICENSE ==
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef UBIRCH_SIM800_BAUD_H
+#define UBIRCH_SIM800_BAUD_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef SIM800_BAUD
+#  define SIM800_BAUD 115200
+#endif
+
+// number of consecutive successful checks required to accept a rate
+#ifndef SIM800_BAUD_PROBES
+#  define SIM800_BAUD_PROBES 5
+#endif
+
+// fall back to the next lower rate if more than 1/SIM800_BAUD_MAX_ERROR_RATIO of the checks fail
+#ifndef SIM800_BAUD_MAX_ERROR_RATIO
+#  define SIM800_BAUD_MAX_ERROR_RATIO 8
+#endif
+
+typedef struct {
+  uint32_t baud;   // the current baud rate
+  uint16_t checks; // link checks done at this rate
+  uint16_t errors; // link checks failed at this rate
+} sim800_baud_stats_t;
+
+/**
+ * Load the last negotiated baud rate from EEPROM, or SIM800_BAUD if there is none.
+ */
+uint32_t sim800_baud_load(void);
+
+/**
+ * Find the baud rate the modem currently answers at and set the UART to it.
+ * @return the baud rate or 0 if the modem did not answer
+ */
+uint32_t sim800_baud_detect(void);
+
+/**
+ * Probe the highest reliable baud rate, switch the modem and the UART to it and
+ * store it in EEPROM.
+ * @return the baud rate or 0 if the modem did not answer at all
+ */
+uint32_t sim800_baud_negotiate(void);
+
+/**
+ * Check the link: the modem must answer AT and report its IMEI without UART errors.
+ * Failed checks are counted and if the error rate becomes too high the next lower
+ * rate is negotiated.
+ * @return true if the check succeeded
+ */
+bool sim800_baud_check(void);
+
+/**
+ * Statistics of the current rate, e.g. for telemetry.
+ */
+const sim800_baud_stats_t *sim800_baud_stats(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //UBIRCH_SIM800_BAUD_H
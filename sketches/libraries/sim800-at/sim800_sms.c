@@ -0,0 +1,78 @@
+/**
+ * Binary SMS (PDU mode) for the SIM800.
+ *
+ * Copyright 2016 ubirch GmbH (http://www.ubirch.com)
+ *
+ * == LICENSE ==
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <Arduino.h>
+#include "sim800_at.h"
+#include "sim800_sms.h"
+
+// +CMGS: 12
+static const char p_cmgs[] PROGMEM = "+CMGS: %u";
+static const uint8_t o_cmgs[] PROGMEM = {0};
+static const at_pattern_t at_p_cmgs PROGMEM = {p_cmgs, o_cmgs};
+
+static void _put_hex(uint8_t b) {
+  static const char hex[] PROGMEM = "0123456789ABCDEF";
+  at_putc((char) pgm_read_byte(&hex[b >> 4]));
+  at_putc((char) pgm_read_byte(&hex[b & 0x0f]));
+}
+
+// wait for the "> " prompt of AT+CMGS
+static bool _prompt(uint16_t timeout) {
+  unsigned long start = millis();
+  while (millis() - start < timeout) if (at_getc() == '>') return true;
+  return false;
+}
+
+bool sim800_sms_send(const char *number, const uint8_t *data, uint8_t length) {
+  bool international = number[0] == '+';
+  const char *digits = international ? number + 1 : number;
+  uint8_t digit_count = (uint8_t) strlen(digits);
+  uint16_t message_reference;
+  char cmd[16];
+
+  if (length > SMS_UD_MAX) return false;
+  if (!at_command_P(PSTR("AT+CMGF=0"), NULL, NULL, 1000)) return false;
+
+  // TPDU length without the SMSC: first octet, MR, DA length, DA type, DA digits, PID, DCS, UDL, UD
+  uint8_t tpdu_length = (uint8_t) (4 + (digit_count + 1) / 2 + 3 + length);
+  sprintf_P(cmd, PSTR("AT+CMGS=%u\r"), tpdu_length);
+  at_clear();
+  at_write(cmd, strlen(cmd));
+  if (!_prompt(5000)) return false;
+
+  _put_hex(0x00); // use the SMSC stored on the SIM
+  _put_hex(0x01); // SMS-SUBMIT, no validity period
+  _put_hex(0x00); // message reference set by the modem
+  _put_hex(digit_count);
+  _put_hex(international ? 0x91 : 0x81);
+  for (uint8_t i = 0; i < digit_count; i += 2) {
+    uint8_t high = (uint8_t) (i + 1 < digit_count ? digits[i + 1] - '0' : 0x0f);
+    _put_hex((uint8_t) ((high << 4) | (digits[i] - '0')));
+  }
+  _put_hex(0x00); // protocol identifier
+  _put_hex(0x04); // data coding scheme: 8 bit data
+  _put_hex(length);
+  for (uint8_t i = 0; i < length; i++) _put_hex(data[i]);
+  at_putc(0x1a);
+
+  // the network confirmation may take a while
+  return at_response(&at_p_cmgs, &message_reference, 60000);
+}
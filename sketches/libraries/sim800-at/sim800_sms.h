@@ -0,0 +1,47 @@
+/**
+ * Binary SMS (PDU mode) for the SIM800.
+ *
+ * Copyright 2016 ubirch GmbH (http://www.ubirch.com)
+ *
+ * == LICENSE ==
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef UBIRCH_SIM800_SMS_H
+#define UBIRCH_SIM800_SMS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// maximum user data of a single 8 bit SMS
+#define SMS_UD_MAX 140
+
+/**
+ * Send binary data (8 bit data coding) as a single SMS. The network must be registered.
+ *
+ * @param number the destination number, international numbers start with '+'
+ * @param data the user data
+ * @param length the length of the user data, at most SMS_UD_MAX bytes
+ * @return true if the modem accepted the message
+ */
+bool sim800_sms_send(const char *number, const uint8_t *data, uint8_t length);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //UBIRCH_SIM800_SMS_H
@@ -0,0 +1,71 @@
+/**
+ * Compact binary sample records for the SMS fallback uplink.
+ *
+ * Copyright 2016 ubirch GmbH (http://www.ubirch.com)
+ *
+ * == LICENSE ==
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <avrnacl.h>
+#include <uplink_key.h>
+#include "sms_uplink.h"
+
+static uint8_t *_put16(uint8_t *p, uint16_t v) {
+  *p++ = (uint8_t) (v >> 8);
+  *p++ = (uint8_t) v;
+  return p;
+}
+
+static uint8_t *_put32(uint8_t *p, uint32_t v) {
+  p = _put16(p, (uint16_t) (v >> 16));
+  return _put16(p, (uint16_t) v);
+}
+
+uint8_t sms_pack_sensor(uint8_t *buffer, const sms_sensor_record_t *records, uint8_t count) {
+  crypto_auth_hmacsha512256_state state;
+  unsigned char mac[UPLINK_TAG_BYTES];
+  const uint8_t *imei = buffer;
+  uint8_t *p = buffer + SMS_IMEI_LENGTH;
+
+  if (count == 0 || count > SMS_SENSOR_RECORDS_MAX) return 0;
+  if (!uplink_key_init(&state)) return 0;
+
+  *p++ = (SMS_FORMAT_VERSION << 4) | SMS_TYPE_SENSOR;
+  // 15 digits packed into 8 bytes, the last nibble is the filler
+  for (uint8_t i = 0; i < SMS_IMEI_LENGTH + 1; i += 2) {
+    uint8_t low = (uint8_t) (i + 1 < SMS_IMEI_LENGTH ? imei[i + 1] - '0' : 0x0f);
+    *p++ = (uint8_t) (((imei[i] - '0') << 4) | low);
+  }
+  *p++ = count;
+
+  for (const sms_sensor_record_t *r = records; r < records + count; r++) {
+    p = _put16(p, r->loop);
+    p = _put32(p, r->time);
+    p = _put16(p, r->red);
+    p = _put16(p, r->green);
+    p = _put16(p, r->blue);
+    *p++ = r->flags;
+    *p++ = r->battery;
+    *p++ = r->error;
+    p = _put32(p, (uint32_t) r->lat);
+    p = _put32(p, (uint32_t) r->lon);
+  }
+
+  // tagged with the device key like the UPLINK_HMAC payload, the IMEI is sent in the clear
+  crypto_auth_hmacsha512256_update(&state, buffer, (crypto_uint16) (p - buffer));
+  crypto_auth_hmacsha512256_final(&state, mac);
+  for (uint8_t i = 0; i < SMS_MAC_BYTES; i++) *p++ = mac[i];
+
+  return (uint8_t) (p - buffer - SMS_IMEI_LENGTH);
+}
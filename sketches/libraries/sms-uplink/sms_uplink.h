@@ -0,0 +1,93 @@
+/**
+ * Compact binary sample records for the SMS fallback uplink.
+ *
+ * If GPRS is not available, but the GSM network is, samples are sent as a single
+ * binary SMS (8 bit data coding, max. 140 bytes user data):
+ *
+ *   offset  size  content
+ *   0       1     format version (high nibble) and record type (low nibble)
+ *   1       8     IMEI, packed BCD, the last nibble is 0xF
+ *   9       1     number of records
+ *   10      n*r   records (big endian)
+ *   end-8   8     MAC, the first 8 bytes of the HMAC-SHA512-256 of IMEI{DATA} with the
+ *                 device key (uplink_key.h), where IMEI is the 15 digit string and DATA
+ *                 all bytes before the MAC
+ *
+ * Sensor record (23 bytes):
+ *
+ *   loop counter (2), time (4), red (2), green (2), blue (2), flags (1, bit 0 = 10k lux),
+ *   battery percent (1), error flags (1), latitude (4), longitude (4)
+ *
+ * The time is in seconds since 2000-01-01 00:00:00 UTC, 0 if unknown. Coordinates
+ * are fixed point (value * 1000000), SMS_NO_LOCATION if unknown.
+ *
+ * Copyright 2016 ubirch GmbH (http://www.ubirch.com)
+ *
+ * == LICENSE ==
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef UBIRCH_SMS_UPLINK_H
+#define UBIRCH_SMS_UPLINK_H
+
+#include <stdint.h>
+#include <sim800_sms.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SMS_FORMAT_VERSION 3
+#define SMS_TYPE_SENSOR    1
+
+#define SMS_IMEI_LENGTH    15
+#define SMS_HEADER_BYTES   10
+#define SMS_MAC_BYTES      8
+
+#define SMS_SENSOR_RECORD_BYTES 23
+#define SMS_SENSOR_RECORDS_MAX  ((SMS_UD_MAX - SMS_HEADER_BYTES - SMS_MAC_BYTES) / SMS_SENSOR_RECORD_BYTES)
+
+#define SMS_FLAG_10KLUX 0x01
+
+// marks an unknown coordinate
+#define SMS_NO_LOCATION INT32_MIN
+
+typedef struct {
+  uint16_t loop;
+  uint32_t time;
+  uint16_t red, green, blue;
+  uint8_t flags;
+  uint8_t battery;
+  uint8_t error;
+  int32_t lat, lon;
+} sms_sensor_record_t;
+
+/**
+ * Pack sensor records into a binary SMS message and append the MAC.
+ *
+ * The buffer must start with the 15 digit IMEI, the message is written right after
+ * it, so the MAC covers the same IMEI{DATA} structure as the UPLINK_HMAC payload tag.
+ *
+ * @param buffer the IMEI followed by space for the message (SMS_IMEI_LENGTH + SMS_UD_MAX bytes)
+ * @param records the records to pack
+ * @param count the number of records, at most SMS_SENSOR_RECORDS_MAX
+ * @return the length of the message at buffer + SMS_IMEI_LENGTH or 0 if count is out of range
+ *         or no device key was provisioned (uplink_key_provision)
+ */
+uint8_t sms_pack_sensor(uint8_t *buffer, const sms_sensor_record_t *records, uint8_t count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //UBIRCH_SMS_UPLINK_H
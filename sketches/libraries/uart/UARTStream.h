@@ -0,0 +1,59 @@
+/**
+ * Arduino Stream adapter for the interrupt driven UART.
+ *
+ * Allows stream based drivers (like the UbirchSIM800) to use the hardware
+ * UART instead of a SoftwareSerial.
+ *
+ * Copyright 2016 ubirch GmbH (http://www.ubirch.com)
+ *
+ * == LICENSE ==
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef UBIRCH_UART_STREAM_H
+#define UBIRCH_UART_STREAM_H
+
+#include <Stream.h>
+#include "uart.h"
+
+class UARTStream : public Stream {
+public:
+  void begin(uint32_t baud) { uart_init(baud); }
+
+  void end() { uart_end(); }
+
+  virtual int available() { return uart_available(); }
+
+  virtual int read() { return uart_getc(); }
+
+  virtual int peek() { return uart_peek(); }
+
+  virtual void flush() { uart_flush(); }
+
+  virtual size_t write(uint8_t c) {
+    uart_putc(c);
+    return 1;
+  }
+
+  virtual size_t write(const uint8_t *buffer, size_t size) {
+    uart_write((const char *) buffer, size);
+    return size;
+  }
+
+  using Print::write;
+
+  // Stream::readBytes() waits byte by byte, read directly from the ring buffer instead
+  size_t readBytes(char *buffer, size_t length) { return uart_read(buffer, length, (uint16_t) _timeout); }
+};
+
+#endif //UBIRCH_UART_STREAM_H
@@ -0,0 +1,206 @@
+/**
+ * Interrupt driven hardware UART (USART0) with receive and transmit ring buffers.
+ *
+ * Copyright 2016 ubirch GmbH (http://www.ubirch.com)
+ *
+ * == LICENSE ==
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/pgmspace.h>
+#include <util/atomic.h>
+#include <Arduino.h>
+#include <scheduler.h>
+#include "uart.h"
+
+#if (UART_RX_BUFSIZE & (UART_RX_BUFSIZE - 1)) || UART_RX_BUFSIZE > 256
+#  error "UART_RX_BUFSIZE must be a power of two <= 256"
+#endif
+#if (UART_TX_BUFSIZE & (UART_TX_BUFSIZE - 1)) || UART_TX_BUFSIZE > 256
+#  error "UART_TX_BUFSIZE must be a power of two <= 256"
+#endif
+
+#define RX_MASK (UART_RX_BUFSIZE - 1)
+#define TX_MASK (UART_TX_BUFSIZE - 1)
+
+static volatile uint8_t rx_buffer[UART_RX_BUFSIZE];
+static volatile uint8_t rx_head = 0, rx_tail = 0;
+static volatile uint8_t tx_buffer[UART_TX_BUFSIZE];
+static volatile uint8_t tx_head = 0, tx_tail = 0;
+static volatile uint8_t error_flags = 0;
+static volatile uint8_t notify_event = 0;
+static bool tx_used = false;
+
+static void _set_baud(uint32_t baud) {
+  // use double speed mode, it has a smaller error for the higher baud rates at 16MHz
+  uint16_t ubrr = (uint16_t) ((F_CPU / 4 / baud - 1) / 2);
+  UCSR0A = _BV(U2X0);
+  UBRR0H = (uint8_t) (ubrr >> 8);
+  UBRR0L = (uint8_t) ubrr;
+}
+
+void uart_init(uint32_t baud) {
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    rx_head = rx_tail = 0;
+    tx_head = tx_tail = 0;
+    error_flags = 0;
+  }
+  tx_used = false;
+
+  _set_baud(baud);
+  UCSR0C = _BV(UCSZ01) | _BV(UCSZ00);
+  UCSR0B = _BV(RXEN0) | _BV(TXEN0) | _BV(RXCIE0);
+}
+
+void uart_set_baud(uint32_t baud) {
+  uart_flush();
+  UCSR0B &= ~(_BV(RXEN0) | _BV(TXEN0) | _BV(RXCIE0));
+  _set_baud(baud);
+  UCSR0B |= _BV(RXEN0) | _BV(TXEN0) | _BV(RXCIE0);
+  uart_clear();
+}
+
+void uart_end(void) {
+  uart_flush();
+  UCSR0B &= ~(_BV(RXEN0) | _BV(TXEN0) | _BV(RXCIE0) | _BV(UDRIE0));
+  uart_clear();
+}
+
+uint16_t uart_available(void) {
+  return (uint8_t) (rx_head - rx_tail) & RX_MASK;
+}
+
+int uart_getc(void) {
+  if (rx_head == rx_tail) return -1;
+  uint8_t c = rx_buffer[rx_tail];
+  rx_tail = (uint8_t) ((rx_tail + 1) & RX_MASK);
+  return c;
+}
+
+int uart_peek(void) {
+  if (rx_head == rx_tail) return -1;
+  return rx_buffer[rx_tail];
+}
+
+size_t uart_read(char *buffer, size_t length, uint16_t timeout) {
+  size_t count = 0;
+  unsigned long last = millis();
+  while (count < length) {
+    int c = uart_getc();
+    if (c >= 0) {
+      buffer[count++] = (char) c;
+      last = millis();
+    } else if (millis() - last > timeout) {
+      break;
+    }
+  }
+  return count;
+}
+
+void uart_clear(void) {
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    rx_tail = rx_head;
+  }
+}
+
+void uart_putc(uint8_t c) {
+  tx_used = true;
+
+  // shortcut: if the queue is empty and the data register is free, write directly
+  if (tx_head == tx_tail && (UCSR0A & _BV(UDRE0))) {
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+      UDR0 = c;
+      UCSR0A |= _BV(TXC0);
+    }
+    return;
+  }
+
+  uint8_t next = (uint8_t) ((tx_head + 1) & TX_MASK);
+  // wait for the interrupt to free a slot, poll the register if interrupts are disabled
+  while (next == tx_tail) {
+    if (bit_is_clear(SREG, SREG_I) && (UCSR0A & _BV(UDRE0))) {
+      UDR0 = tx_buffer[tx_tail];
+      UCSR0A |= _BV(TXC0);
+      tx_tail = (uint8_t) ((tx_tail + 1) & TX_MASK);
+    }
+  }
+  tx_buffer[tx_head] = c;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    tx_head = next;
+    UCSR0B |= _BV(UDRIE0);
+  }
+}
+
+void uart_write(const char *buffer, size_t length) {
+  while (length--) uart_putc((uint8_t) *buffer++);
+}
+
+void uart_puts_P(const char *str) {
+  char c;
+  while ((c = pgm_read_byte(str++))) uart_putc((uint8_t) c);
+}
+
+void uart_flush(void) {
+  // nothing was ever sent, TXC0 will never be set
+  if (!tx_used) return;
+  while ((UCSR0B & _BV(UDRIE0)) || bit_is_clear(UCSR0A, TXC0));
+}
+
+uint8_t uart_errors(void) {
+  uint8_t flags;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    flags = error_flags;
+    error_flags = 0;
+  }
+  return flags;
+}
+
+void uart_notify(uint8_t event) {
+  notify_event = event;
+}
+
+// receive complete: store the byte in the ring buffer, record errors
+ISR(USART_RX_vect) {
+  uint8_t status = UCSR0A;
+  uint8_t c = UDR0;
+
+  if (status & _BV(FE0)) error_flags |= UART_E_FRAME;
+  if (status & _BV(DOR0)) error_flags |= UART_E_OVERRUN;
+  if (status & _BV(UPE0)) error_flags |= UART_E_PARITY;
+
+  uint8_t next = (uint8_t) ((rx_head + 1) & RX_MASK);
+  if (next != rx_tail) {
+    rx_buffer[rx_head] = c;
+    rx_head = next;
+  } else {
+    error_flags |= UART_E_BUFFER;
+  }
+  // someone waits for data, tell the scheduler once
+  if (notify_event) {
+    sched_post(notify_event);
+    notify_event = 0;
+  }
+}
+
+// data register empty: send the next queued byte or stop the interrupt
+ISR(USART_UDRE_vect) {
+  if (tx_head == tx_tail) {
+    UCSR0B &= ~_BV(UDRIE0);
+    return;
+  }
+  UDR0 = tx_buffer[tx_tail];
+  UCSR0A |= _BV(TXC0);
+  tx_tail = (uint8_t) ((tx_tail + 1) & TX_MASK);
+}
@@ -0,0 +1,143 @@
+/**
+ * Interrupt driven hardware UART (USART0) with receive and transmit ring buffers.
+ *
+ * Received bytes are stored by the RX interrupt, so the caller can read large
+ * responses in one go without losing characters. Written bytes are queued and
+ * sent by the data register empty interrupt, the CPU does not wait for each bit.
+ *
+ * The driver replaces the Arduino HardwareSerial, do not use Serial together with it.
+ *
+ * Copyright 2016 ubirch GmbH (http://www.ubirch.com)
+ *
+ * == LICENSE ==
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef UBIRCH_UART_H
+#define UBIRCH_UART_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// buffer sizes must be a power of two and at most 256 bytes
+#ifndef UART_RX_BUFSIZE
+#  define UART_RX_BUFSIZE 128
+#endif
+#ifndef UART_TX_BUFSIZE
+#  define UART_TX_BUFSIZE 64
+#endif
+
+// error flags, accumulated until read with uart_errors()
+#define UART_E_FRAME    0b00000001 // framing error (wrong baud rate or noise)
+#define UART_E_OVERRUN  0b00000010 // hardware data overrun
+#define UART_E_PARITY   0b00000100 // parity error
+#define UART_E_BUFFER   0b10000000 // receive ring buffer was full, data lost
+
+/**
+ * Initialize the UART (8N1) with the given baud rate and enable interrupts.
+ * @param baud the baud rate to use
+ */
+void uart_init(uint32_t baud);
+
+/**
+ * Change the baud rate. Waits until the transmit queue is empty and clears the receive buffer.
+ * @param baud the new baud rate
+ */
+void uart_set_baud(uint32_t baud);
+
+/**
+ * Disable the UART and its interrupts, releasing the pins.
+ */
+void uart_end(void);
+
+/**
+ * Number of bytes waiting in the receive buffer.
+ */
+uint16_t uart_available(void);
+
+/**
+ * Read a single byte from the receive buffer.
+ * @return the byte read or -1 if the buffer is empty
+ */
+int uart_getc(void);
+
+/**
+ * Look at the next byte in the receive buffer without removing it.
+ * @return the next byte or -1 if the buffer is empty
+ */
+int uart_peek(void);
+
+/**
+ * Read up to length bytes, waiting for more data until timeout milliseconds
+ * have passed without receiving a byte.
+ *
+ * @param buffer the buffer to read into
+ * @param length the number of bytes to read
+ * @param timeout maximum time to wait for the next byte in milliseconds
+ * @return the number of bytes read
+ */
+size_t uart_read(char *buffer, size_t length, uint16_t timeout);
+
+/**
+ * Drop all received data.
+ */
+void uart_clear(void);
+
+/**
+ * Queue a byte for sending. Blocks only if the transmit queue is full.
+ * @param c the byte to send
+ */
+void uart_putc(uint8_t c);
+
+/**
+ * Queue a number of bytes for sending.
+ * @param buffer the data to send
+ * @param length the amount of bytes
+ */
+void uart_write(const char *buffer, size_t length);
+
+/**
+ * Queue a zero terminated string located in program memory for sending.
+ * @param str the string in PROGMEM
+ */
+void uart_puts_P(const char *str);
+
+/**
+ * Wait until all queued bytes have left the transmitter.
+ */
+void uart_flush(void);
+
+/**
+ * Return the accumulated error flags (UART_E_*) and reset them.
+ */
+uint8_t uart_errors(void);
+
+/**
+ * Post an event to the scheduler (sched_post) when the next byte is received, once.
+ * Used to notice unsolicited output while nobody reads, the receive interrupt does
+ * not wake the MCU from power down.
+ *
+ * @param event the event to post, 0 disarms
+ */
+void uart_notify(uint8_t event);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //UBIRCH_UART_H
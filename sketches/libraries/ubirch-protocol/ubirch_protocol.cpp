@@ -0,0 +1,292 @@
+/**
+ * Signed JSON protocol shared by the lights sketches.
+ *
+ * Copyright 2016 ubirch GmbH (http://www.ubirch.com)
+ *
+ * == LICENSE ==
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <alloca.h>
+#include <avr/pgmspace.h>
+#include <Base64.h>
+#include <arena.h>
+#include <freeram.h>
+#include <policy.h>
+#include <logging.h>
+#include <uplink_key.h>
+#include <uplink_box.h>
+#include "ubirch_protocol.h"
+
+extern "C" {
+#include <avrnacl.h>
+}
+
+uint16_t protocol_token_key(const char *json, const jsmntok_t &token) {
+  if (token.type != JSMN_STRING) return 0;
+  switch (token.end - token.start) {
+    case 1:
+      return (uint8_t) json[token.start];
+    case 2:
+      return (uint16_t) ((uint8_t) json[token.start] | (uint8_t) json[token.start + 1] << 8);
+    default:
+      return 0;
+  }
+}
+
+unsigned int protocol_to_uint(const char *ptr, size_t len) {
+  unsigned int ret = 0;
+  for (uint8_t i = 0; i < len; i++) {
+    ret = (ret * 10) + (ptr[i] - '0');
+  }
+  return ret;
+}
+
+int protocol_to_int(const char *ptr, size_t len) {
+  return *ptr == '-' ? -(int) protocol_to_uint(ptr + 1, len - 1) : (int) protocol_to_uint(ptr, len);
+}
+
+uint8_t protocol_skip_token(const jsmntok_t *token, uint8_t index, uint8_t count) {
+  const int end = token[index].end;
+  while (index + 1 < count && token[index + 1].start < end) index++;
+  return index;
+}
+
+// the text of a token for the log
+static inline log_span_t _span(const char *json, const jsmntok_t &token) {
+  return log_span(json + token.start, (uint8_t) (token.end - token.start));
+}
+
+// parse json into tokens allocated from the arena, returns the number of tokens or 0
+static uint8_t _parse(const char *json, jsmntok_t *&token) {
+  jsmn_parser parser;
+  jsmn_init(&parser);
+
+  // identify the number of tokens first
+  const int count = jsmn_parse(&parser, json, strlen(json), NULL, 0);
+  token = count > 0 && count < 256 ? (jsmntok_t *) arena_alloc(sizeof(*token) * count) : NULL;
+  if (token == NULL) return 0;
+
+  // reset parser, parse and store tokens
+  jsmn_init(&parser);
+  if (jsmn_parse(&parser, json, strlen(json), token, (unsigned int) count) != count ||
+      token[0].type != JSMN_OBJECT) {
+    return 0;
+  }
+  return (uint8_t) count;
+}
+
+void protocol_process_response(char *response, const char *key, char *&payload, char *&signature,
+                               uint8_t &error_flag) {
+  char tmp_signature[crypto_hash_BYTES], *tmp_payload = NULL;
+  bool signed_response = false;
+  const size_t key_length = strlen(key);
+
+  jsmntok_t *token;
+  const uint8_t token_count = _parse(response, token);
+  if (token_count) {
+    uint8_t index = 0;
+    while (++index + 1 < token_count) {
+      const jsmntok_t &value = token[index + 1];
+      switch (protocol_token_key(response, token[index])) {
+        case protocol_key(P_VERSION):
+          if (value.type != JSMN_STRING) break;
+          index++;
+          if (strncmp_P(response + value.start, PSTR(PROTOCOL_VERSION_MIN), 3) != 0) {
+            LOG_WARN("protocol version mismatch: %t", _span(response, value));
+
+            // do not continue if the version does not match
+            error_flag |= PROTOCOL_E_VERSION;
+            index = (uint8_t) (token_count - 1);
+          }
+          continue;
+        case protocol_key(P_SIGNATURE):
+          // only a base64 encoded hash fits the signature buffer
+          if (value.type != JSMN_STRING || value.end - value.start != (crypto_hash_BYTES + 2) / 3 * 4) break;
+          index++;
+          LOG_DEBUG("signature: %t", _span(response, value));
+
+          // extract signature and decode it
+          base64_decode(tmp_signature, (char *) (response + value.start), value.end - value.start);
+          signed_response = true;
+          continue;
+        case protocol_key(P_PAYLOAD): {
+          if (value.type != JSMN_OBJECT) break;
+          index++;
+          LOG_DEBUG("payload: %t", _span(response, value));
+
+          // allocate the temporary payload on the stack, it is copied to the arena after the response is released
+          const uint8_t tmp_payload_length = (uint8_t) (value.end - value.start);
+          tmp_payload = (char *) alloca(key_length + tmp_payload_length + 1);
+          memcpy(tmp_payload, key, key_length);
+          memcpy(tmp_payload + key_length, response + value.start, tmp_payload_length);
+          tmp_payload[key_length + tmp_payload_length] = '\0';
+
+          index = protocol_skip_token(token, index, token_count);
+          continue;
+        }
+        default:
+          break;
+      }
+
+      // simply ignore unknown keys
+      LOG_DEBUG("unknown key: %t", _span(response, token[index]));
+      index = protocol_skip_token(token, (uint8_t) (index + 1), token_count);
+    }
+  } else {
+    error_flag |= PROTOCOL_E_JSON;
+  }
+
+  // release the no longer used response and the tokens allocated after it
+  arena_free(response);
+
+  // copy the locally (stack) allocated payload and signature to the arena
+  if (tmp_payload != NULL && signed_response) {
+    payload = arena_strdup(tmp_payload);
+    signature = (char *) arena_alloc(crypto_hash_BYTES);
+    if (signature != NULL) memcpy(signature, tmp_signature, crypto_hash_BYTES);
+  }
+}
+
+bool protocol_verify_payload(const char *payload, const char *signature, uint8_t &error_flag) {
+  // don't even start if we get NULLs
+  if (payload == NULL || signature == NULL) return false;
+
+  // required ram for signature verification: SHA512 (stack), the hash is compared in place
+  const int required_ram = SHA512_STACK;
+  const int free_sram = query_free_sram();
+
+  LOG_DEBUG("payload verification: %d byte free (%d byte required)", free_sram, required_ram);
+
+  bool signature_verified = false;
+  if (required_ram < free_sram) {
+    // hash payload and check whether it matches the signature hash (constant time)
+    LOG_DEBUG_HEX("[HASH] ", signature, crypto_hash_BYTES);
+    signature_verified = crypto_hash_verify((const unsigned char *) signature,
+                                            (const unsigned char *) payload, strlen(payload)) == 0;
+    if (!signature_verified) error_flag |= PROTOCOL_E_SIGNATURE;
+  } else {
+    LOG_ERROR("payload too large, may crash...");
+    error_flag |= PROTOCOL_E_MEMORY;
+  }
+
+  return signature_verified;
+}
+
+// find the field of a key in the PROGMEM table
+static bool _find(const protocol_field_t *fields, uint8_t count, uint16_t key, protocol_field_t &field) {
+  if (key == 0) return false;
+  for (uint8_t i = 0; i < count; i++) {
+    if (pgm_read_word(&fields[i].key) == key) {
+      memcpy_P(&field, &fields[i], sizeof(field));
+      return true;
+    }
+  }
+  return false;
+}
+
+bool protocol_process_payload(const char *payload, const protocol_field_t *fields, uint8_t count,
+                              uint8_t &error_flag) {
+  jsmntok_t *token;
+  const uint8_t token_count = _parse(payload, token);
+  if (!token_count) {
+    error_flag |= PROTOCOL_E_JSON;
+    arena_free(token);
+    return false;
+  }
+
+  uint8_t index = 0;
+  while (++index < token_count) {
+    protocol_field_t field;
+    const bool known = _find(fields, count, protocol_token_key(payload, token[index]), field);
+    if (++index >= token_count) break;
+    const jsmntok_t &value = token[index];
+
+    if (known && field.type != PROTOCOL_TABLE && value.type == JSMN_PRIMITIVE) {
+      const unsigned int number = protocol_to_uint(payload + value.start, (size_t) (value.end - value.start));
+      switch (field.type) {
+        case PROTOCOL_FLAG:
+          field.flag(payload[value.start] != '0');
+          break;
+        case PROTOCOL_UINT8:
+          field.uint8((uint8_t) number);
+          break;
+        default:
+          field.uint16((uint16_t) number);
+          break;
+      }
+    } else if (known && field.type == PROTOCOL_TABLE && value.type == JSMN_ARRAY) {
+      index = field.table(payload, token, index, token_count);
+    } else {
+      LOG_DEBUG("unknown payload key: %t", _span(payload, token[index - 1]));
+      index = protocol_skip_token(token, index, token_count);
+    }
+  }
+
+  arena_free(token);
+  return true;
+}
+
+uint8_t protocol_read_policy(const char *json, jsmntok_t *token, uint8_t index, uint8_t count) {
+  const uint8_t last = protocol_skip_token(token, index, count);
+  policy_t table[POLICY_ROWS];
+  uint8_t rows = 0;
+
+  bool valid = token[index].size <= POLICY_ROWS;
+  while (valid && index < last) {
+    jsmntok_t &row = token[++index];
+    valid = row.type == JSMN_ARRAY && row.size == 5 && index + 5 <= last;
+    int values[5];
+    for (uint8_t i = 0; valid && i < 5; i++) {
+      jsmntok_t &value = token[++index];
+      valid = value.type == JSMN_PRIMITIVE;
+      values[i] = protocol_to_int(json + value.start, (size_t) (value.end - value.start));
+    }
+    if (valid) table[rows++] = {(uint8_t) values[0], (int8_t) values[1], (uint16_t) values[2],
+                                (uint8_t) values[3], (uint8_t) values[4]};
+  }
+
+  if (valid && policy_set(table, rows)) LOG_INFO("policy updated");
+  else LOG_WARN("policy rejected");
+  return last;
+}
+
+// not inlined, the state is only on the stack while tagging
+bool __attribute__ ((noinline)) protocol_authenticate(unsigned char *tag, const char *data) {
+  crypto_auth_hmacsha512256_state state;
+  if (!uplink_key_init(&state)) return false;
+  crypto_auth_hmacsha512256_update(&state, (const unsigned char *) data, (crypto_uint16) strlen(data));
+  crypto_auth_hmacsha512256_final(&state, tag);
+  return true;
+}
+
+void protocol_envelope_hmac(char *message, const char *device, const unsigned char *tag) {
+  // the head ends with the payload key, the null is not written to keep the payload
+  strcpy_P(message, PSTR("{\"v\":\"0.1.0\",\"id\":\""));
+  strcat(message, device);
+  strcat_P(message, PSTR("\",\"m\":\""));
+  base64_encode(message + strlen(message), (char *) tag, UPLINK_TAG_BYTES);
+  memcpy_P(message + strlen(message), PSTR("\",\"p\":"), 6);
+  strcat_P(message, PSTR("}"));
+}
+
+void protocol_envelope_box(char *message, const char *device, const unsigned char *prefix, uint32_t counter,
+                           const unsigned char *box, uint16_t length) {
+  sprintf_P(message, PSTR("{\"v\":\"0.2.1\",\"id\":\"%s\",\"np\":\""), device);
+  base64_encode(message + strlen(message), (char *) prefix, UPLINK_BOX_PREFIXBYTES);
+  sprintf_P(message + strlen(message), PSTR("\",\"n\":%lu,\"c\":\""), (unsigned long) counter);
+  base64_encode(message + strlen(message), (char *) box, length);
+  strcat_P(message, PSTR("\"}"));
+}
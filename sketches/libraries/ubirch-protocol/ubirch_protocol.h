@@ -0,0 +1,213 @@
+/**
+ * Signed JSON protocol shared by the lights sketches.
+ *
+ * The backend responds with an envelope that holds the protocol version, the
+ * payload and its signature (the base64 encoded SHA512 of IMEI{PAYLOAD}):
+ *
+ *   {"v":"0.0.2","s":"<base64>","p":{"i":1800,"l":1}}
+ *
+ * The payload keys a sketch understands are declared once in a PROGMEM table of
+ * protocol_field_t. Each entry holds the packed key, the expected value type and
+ * a typed setter that is called with the parsed value:
+ *
+ *   static void set_interval(uint16_t value) { interval = value; }
+ *   static const protocol_field_t payload_fields[] PROGMEM = {
+ *     {protocol_key(P_INTERVAL), set_interval},
+ *     {protocol_key(P_POLICY), protocol_read_policy},
+ *   };
+ *
+ * Keys are at most two characters long and packed into 16 bit, so a key token is
+ * matched without any string compare.
+ *
+ * Copyright 2016 ubirch GmbH (http://www.ubirch.com)
+ *
+ * == LICENSE ==
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef UBIRCH_PROTOCOL_H
+#define UBIRCH_PROTOCOL_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <jsmn.h>
+
+// protocol version check
+#define PROTOCOL_VERSION_MIN "0.0"
+
+// envelope keys
+#define P_SIGNATURE "s"
+#define P_VERSION "v"
+#define P_PAYLOAD "p"
+// the authenticated uplink envelope (UPLINK_HMAC) sends the device id and a tag instead of hashes
+#define P_DEVICE "id"
+#define P_TAG "m"
+// the encrypted uplink envelope (UPLINK_BOX) sends the device id, the nonce prefix and counter and the box
+#define P_PREFIX "np"
+#define P_NONCE "n"
+#define P_BOX "c"
+
+// error flags, the same bits as the E_* flags sent by the sketches
+#define PROTOCOL_E_VERSION   0b00000010
+#define PROTOCOL_E_SIGNATURE 0b00000100
+#define PROTOCOL_E_JSON      0b00001000
+#define PROTOCOL_E_MEMORY    0b10000000
+
+// stack used by crypto_hash_sha512() (avrnacl stack.mk), compare with the "sk" telemetry
+#ifndef SHA512_STACK
+#  define SHA512_STACK 669
+#endif
+
+// payload value types
+#define PROTOCOL_FLAG   0 // 0 or 1
+#define PROTOCOL_UINT8  1
+#define PROTOCOL_UINT16 2
+#define PROTOCOL_TABLE  3 // an array, read by the setter itself
+
+typedef void (*protocol_flag_setter_t)(bool value);
+typedef void (*protocol_uint8_setter_t)(uint8_t value);
+typedef void (*protocol_uint16_setter_t)(uint16_t value);
+// reads the value starting at token[index] and returns the index of its last token
+typedef uint8_t (*protocol_table_reader_t)(const char *json, jsmntok_t *token, uint8_t index, uint8_t count);
+
+// not defined, keys longer than two characters fail to compile
+uint16_t protocol_key_too_long(void);
+
+/**
+ * Pack a key of one or two characters into 16 bit at compile time.
+ */
+template<size_t N>
+constexpr uint16_t protocol_key(const char (&key)[N]) {
+  return N == 2 ? (uint8_t) key[0] :
+         N == 3 ? (uint16_t) ((uint8_t) key[0] | (uint8_t) key[1] << 8) :
+         protocol_key_too_long();
+}
+
+struct protocol_field_t {
+  uint16_t key;
+  uint8_t type;
+  union {
+    protocol_flag_setter_t flag;
+    protocol_uint8_setter_t uint8;
+    protocol_uint16_setter_t uint16;
+    protocol_table_reader_t table;
+  };
+
+  protocol_field_t() = default;
+  constexpr protocol_field_t(uint16_t key, protocol_flag_setter_t set) : key(key), type(PROTOCOL_FLAG), flag(set) {}
+  constexpr protocol_field_t(uint16_t key, protocol_uint8_setter_t set) : key(key), type(PROTOCOL_UINT8), uint8(set) {}
+  constexpr protocol_field_t(uint16_t key, protocol_uint16_setter_t set) : key(key), type(PROTOCOL_UINT16), uint16(set) {}
+  constexpr protocol_field_t(uint16_t key, protocol_table_reader_t read) : key(key), type(PROTOCOL_TABLE), table(read) {}
+};
+
+/**
+ * @return the packed key of a string token or 0 if it is not a key of one or two characters
+ */
+uint16_t protocol_token_key(const char *json, const jsmntok_t &token);
+
+/**
+ * Convert a number of characters into an unsigned integer value.
+ */
+unsigned int protocol_to_uint(const char *ptr, size_t len);
+
+/**
+ * Convert a number of characters into a signed integer value.
+ */
+int protocol_to_int(const char *ptr, size_t len);
+
+/**
+ * @return the index of the last token belonging to the token at index (e.g. all elements of an array)
+ */
+uint8_t protocol_skip_token(const jsmntok_t *token, uint8_t index, uint8_t count);
+
+/**
+ * Process the JSON response from the backend. The protocol version is checked and
+ * the payload and its signature are extracted. The payload is prefixed with the key
+ * for verification.
+ *
+ * @param response the response, it is released here (must be the top of the arena)
+ * @param key the device key (IMEI)
+ * @param payload the extracted payload (key + JSON), allocated from the arena
+ * @param signature the decoded signature, allocated from the arena
+ * @param error_flag PROTOCOL_E_* flags are added here
+ */
+void protocol_process_response(char *response, const char *key, char *&payload, char *&signature,
+                               uint8_t &error_flag);
+
+/**
+ * Verify the payload using the given signature.
+ *
+ * @param payload the payload to check (including the prepended key!)
+ * @param signature the signature for verification
+ * @param error_flag PROTOCOL_E_* flags are added here
+ * @return true if the verification was successful
+ */
+bool protocol_verify_payload(const char *payload, const char *signature, uint8_t &error_flag);
+
+/**
+ * Parse the payload and call the setter of each known key. Unknown keys and
+ * values of the wrong type are skipped.
+ *
+ * @param payload the JSON payload (without the key), should be verified
+ * @param fields the known keys (PROGMEM)
+ * @param count the number of fields
+ * @param error_flag PROTOCOL_E_* flags are added here
+ * @return true if the payload could be parsed
+ */
+bool protocol_process_payload(const char *payload, const protocol_field_t *fields, uint8_t count,
+                              uint8_t &error_flag);
+
+/**
+ * Read a policy table ([[battery,trend,interval,upload,features],...]) and apply
+ * it, an empty table restores the defaults. Use it as a PROTOCOL_TABLE setter.
+ */
+uint8_t protocol_read_policy(const char *json, jsmntok_t *token, uint8_t index, uint8_t count);
+
+/**
+ * Tag data with the device key (HMAC-SHA512-256, UPLINK_HMAC). The key midstate
+ * is read from EEPROM, so this costs the data blocks and one block of the outer hash.
+ *
+ * @param tag the tag (UPLINK_TAG_BYTES)
+ * @param data the data to authenticate
+ * @return false if no key was provisioned
+ */
+bool protocol_authenticate(unsigned char *tag, const char *data);
+
+/**
+ * Write the authenticated envelope (0.1.0) around a payload. The head is written
+ * in front of the payload, which must directly follow it in the message buffer:
+ *
+ *   {"v":"0.1.0","id":"<device>","m":"<base64 tag>","p":{PAYLOAD}}
+ *
+ * @param message the message buffer, the payload starts after the head
+ * @param device the device id (IMEI)
+ * @param tag the tag of the payload (UPLINK_TAG_BYTES)
+ */
+void protocol_envelope_hmac(char *message, const char *device, const unsigned char *tag);
+
+/**
+ * Write the encrypted envelope (0.2.1) of a box into the message buffer:
+ *
+ *   {"v":"0.2.1","id":"<device>","np":"<base64 prefix>","n":<counter>,"c":"<base64 box>"}
+ *
+ * @param message the message buffer
+ * @param device the device id (IMEI)
+ * @param prefix the random nonce prefix (UPLINK_BOX_PREFIXBYTES)
+ * @param counter the nonce counter of the box
+ * @param box the ciphertext without its zero bytes
+ * @param length the length of the ciphertext
+ */
+void protocol_envelope_box(char *message, const char *device, const unsigned char *prefix, uint32_t counter,
+                           const unsigned char *box, uint16_t length);
+
+#endif // UBIRCH_PROTOCOL_H
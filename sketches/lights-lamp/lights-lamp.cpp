@@ -29,8 +29,32 @@
 #include <UbirchSIM800.h>
 #include <avrnacl.h>
 #include <jsmn.h>
-#include <alloca.h>
+#include <ubirch_protocol.h>
+#include <entropy.h>
 #include <freeram.h>
+#include <scheduler.h>
+#include <walltime.h>
+#include <probe.h>
+#include <policy.h>
+#include <store.h>
+#include <arena.h>
+#include <json_schema.h>
+#include <debug.h>
+#include <logging.h>
+#include <sim800_at.h>
+#include <location_cache.h>
+#if defined(UPLINK_HMAC) || defined(UPLINK_KEY)
+#  include <uplink_key.h>
+#endif
+#if defined(UPLINK_BOX) || defined(UPLINK_BOX_SECRET)
+#  include <uplink_box.h>
+#endif
+#ifdef SIM800_HW_UART
+#  include <UARTStream.h>
+#  include <sim800_baud.h>
+#else
+#  include <SoftwareSerial.h>
+#endif
 
 extern "C" {
 #include <avrsleep.h>
@@ -43,73 +67,220 @@ extern "C" {
 // default sleep interval is 30 minutes
 #define DEFAULT_INTERVAL  30*60
 
+// query the GSM location every n-th cycle (default 24 hours)
+#ifndef LOCATION_REFRESH
+#  define LOCATION_REFRESH 48
+#endif
+
+// reseed from fresh noise and store a new random seed every n-th cycle (default 8 hours),
+// it is also replaced at every reset
+#ifndef ENTROPY_SAVE_CYCLES
+#  define ENTROPY_SAVE_CYCLES 16
+#endif
+
 #define PIXEL_PIN 10
 #define PIXEL_COUNT 1
 
 #define LED 13
 #define WATCHDOG 6
 
-// protocol version check
-#define PROTOCOL_VERSION_MIN "0.0"
-// json keys
-#define P_SIGNATURE "s"
-#define P_VERSION "v"
-#define P_PAYLOAD "p"
+// payload keys
 #define P_INTERVAL "i"
+#define P_LOCATE "l"
 #define P_RED "r"
 #define P_GREEN "g"
 #define P_BLUE "b"
 #define P_BLINK "bf"
 #define P_PIXEL_TYPE "t"
+#define P_POLICY "pp"
+
+// EEPROM records
+#define STORE_CONFIG  0
+#define STORE_COUNTER 1
 
 // error flags
 #define E_LAMP_FAILED   0b00000001 // does not happen, we have no way to detect failure at the moment
-#define E_PROTOCOL_FAIL 0b00000010
-#define E_SIG_VRFY_FAIL 0b00000100
-#define E_JSON_FAILED   0b00001000
-#define E_NO_MEMORY     0b10000000
+#define E_PROTOCOL_FAIL PROTOCOL_E_VERSION
+#define E_SIG_VRFY_FAIL PROTOCOL_E_SIGNATURE
+#define E_JSON_FAILED   PROTOCOL_E_JSON
+#define E_NO_MEMORY     PROTOCOL_E_MEMORY
 #define E_NO_CONNECTION 0b01000000
 
+// the phase timing statistics are only sent if PROBE_REPORT is defined
+#ifdef PROBE_REPORT
+#  define PROBE_ENABLED true
+#else
+#  define PROBE_ENABLED false
+#endif
+
+// the stack and heap statistics are only sent if MEMORY_REPORT is defined
+#ifdef MEMORY_REPORT
+#  define MEMORY_ENABLED true
+#else
+#  define MEMORY_ENABLED false
+#endif
+
+// SRAM set aside for the message buffers of a cycle
+#ifndef ARENA_BUDGET
+#  define ARENA_BUDGET 1024
+#endif
+
+// the IMEI is prepended to the payload for hashing
+#define IMEI_LEN 15
+// a base64 encoded payload hash
+constexpr uint16_t HASH_B64_LEN = json::base64(crypto_hash_BYTES);
+
+#if defined(UPLINK_HMAC) && defined(UPLINK_BOX)
+#  error "UPLINK_HMAC and UPLINK_BOX are exclusive, the box is authenticated with the shared key"
+#endif
+
+// uplink payload, the worst case includes all fields that are only sent sometimes
+constexpr json_t UPLINK = json::object(
+    json::field("ba", json::UINT16), json::field("lp", json::INT16), json::field("e", json::UINT8),
+    json::field("pl", json::UINT8), json::field("hw", json::UINT16),
+    json::field("la", json::string(AT_FIXED6_STRLEN - 1)), json::field("lo", json::string(AT_FIXED6_STRLEN - 1)),
+    json::field("ts", json::UINT32), json::field("br", json::UINT32),
+    json::when(PROBE_ENABLED, json::field("pt", json::array(PROBE_PHASES, json::UINT16))),
+    json::when(PROBE_ENABLED, json::field("px", json::array(PROBE_PHASES, json::UINT16))),
+    json::when(MEMORY_ENABLED, json::field("sk", json::UINT16)),
+    json::when(MEMORY_ENABLED, json::field("hf", json::UINT16)),
+    json::when(MEMORY_ENABLED, json::field("hl", json::UINT16)));
+
+// downlink payload, the color values may be 16 bit, the policy table values are at most 6 characters
+constexpr json_t DOWNLINK = json::object(
+    json::field(P_BLINK, json::FLAG), json::field(P_PIXEL_TYPE, json::UINT8), json::field(P_RED, json::UINT16),
+    json::field(P_GREEN, json::UINT16), json::field(P_BLUE, json::UINT16), json::field(P_INTERVAL, json::UINT16),
+    json::field(P_LOCATE, json::FLAG),
+    json::field(P_POLICY, json::array(POLICY_ROWS, json::array(5, json::INT16))));
+
+#if defined(UPLINK_HMAC)
+// the uplink is authenticated with a tag of IMEI{DATA} instead of the hashes
+constexpr uint16_t UPLOAD_HASH_BYTES = UPLINK_TAG_BYTES;
+#elif defined(UPLINK_BOX)
+// the uplink is IMEI{DATA} encrypted with the shared key, the box replaces the hashes
+constexpr uint16_t UPLOAD_HASH_BYTES = UPLINK_BOX_ZEROBYTES + IMEI_LEN + UPLINK.length + 1;
+constexpr uint16_t BOX_B64_LEN = json::base64(UPLOAD_HASH_BYTES - 1 - UPLINK_BOX_BOXZEROBYTES);
+#else
+constexpr uint16_t UPLOAD_HASH_BYTES = 2 * crypto_hash_BYTES;
+#endif
+
+// the envelopes, the version is "0.0.1" up ("0.1.0" with UPLINK_HMAC, "0.2.1" with UPLINK_BOX)
+// and "0.0.x" down
+#if defined(UPLINK_HMAC)
+constexpr json_t MESSAGE = json::object(
+    json::field(P_VERSION, json::string(5)), json::field(P_DEVICE, json::string(IMEI_LEN)),
+    json::field(P_TAG, json::string(json::base64(UPLINK_TAG_BYTES))), json::field(P_PAYLOAD, UPLINK));
+#elif defined(UPLINK_BOX)
+constexpr json_t MESSAGE = json::object(
+    json::field(P_VERSION, json::string(5)), json::field(P_DEVICE, json::string(IMEI_LEN)),
+    json::field(P_PREFIX, json::string(json::base64(UPLINK_BOX_PREFIXBYTES))),
+    json::field(P_NONCE, json::UINT32), json::field(P_BOX, json::string(BOX_B64_LEN)));
+#else
+constexpr json_t MESSAGE = json::object(
+    json::field(P_VERSION, json::string(5)), json::field("a", json::string(HASH_B64_LEN)),
+    json::field(P_SIGNATURE, json::string(HASH_B64_LEN)), json::field(P_PAYLOAD, UPLINK));
+#endif
+constexpr json_t RESPONSE = json::object(
+    json::field(P_VERSION, json::string(8)), json::field(P_SIGNATURE, json::string(HASH_B64_LEN)),
+    json::field(P_PAYLOAD, DOWNLINK));
+
+// the message buffer including the terminating zero, the payload starts after the envelope head
+constexpr uint16_t MESSAGE_SIZE = MESSAGE.length + 1;
+constexpr uint16_t MESSAGE_HEAD = MESSAGE.length - UPLINK.length - 1;
+
+// all message buffers of a cycle are allocated from a static arena, it must hold the worst case of
+// sending (message and binary hashes) and receiving (response and tokens, then payload, signature and hash)
+constexpr uint16_t UPLOAD_PEAK = MESSAGE_SIZE + UPLOAD_HASH_BYTES;
+constexpr uint16_t RESPONSE_PEAK = RESPONSE.length + 1 + RESPONSE.tokens * sizeof(jsmntok_t);
+constexpr uint16_t DOWNLINK_PEAK = IMEI_LEN + DOWNLINK.length + 1 + crypto_hash_BYTES +
+                                   json::max(crypto_hash_BYTES, DOWNLINK.tokens * sizeof(jsmntok_t));
+constexpr uint16_t ARENA_SIZE = json::max(UPLOAD_PEAK, json::max(RESPONSE_PEAK, DOWNLINK_PEAK));
+
+static_assert(ARENA_SIZE <= ARENA_BUDGET, "message buffers exceed the SRAM budget (ARENA_BUDGET)");
+static_assert(DOWNLINK.length < 256, "the downlink payload length must fit into 8 bit");
+
 Adafruit_NeoPixel neo_pixel = Adafruit_NeoPixel(PIXEL_COUNT, PIXEL_PIN);
-UbirchSIM800 sim800h = UbirchSIM800();
+#ifdef SIM800_HW_UART
+// the modem is connected to the hardware UART, interrupt driven and buffered
+UARTStream sim800_serial;
+#else
+SoftwareSerial sim800_serial(SIM800_RX, SIM800_TX);
+#endif
+UbirchSIM800 sim800h = UbirchSIM800(sim800_serial);
+
+// events posted by interrupts, handled in sched_run()
+#define EVENT_RING  1 // the modem pulled RI low (incoming call or SMS)
+#define EVENT_MODEM 2 // unsolicited modem output on the hardware UART
+
+// with its RI pin wired (an external interrupt pin, hardware UART only) the modem stays in
+// standby between cycles, so the backend can call or text the device to ask for an update
+#if defined(SIM800_HW_UART) && defined(SIM800_RI)
+#  define MODEM_STANDBY
+static bool modem_standby = false;
+#endif
 
 // this counts up as long as we don't have a reset
 int loop_counter = 1; //loop counter
 uint8_t error_flag = 0x00;
+// the update cycle task
+static int8_t cycle_task = -1;
+static void cycle();
+static uint16_t cycle_interval();
 
 // internal lamp state
 uint16_t interval = DEFAULT_INTERVAL;
 uint8_t red = 0, green = 0, blue = 0;
 uint8_t pixel_type = NEO_RGB;
-
-static int jsoneq(const char *json, jsmntok_t &token, const char *key) {
-  if (token.type == JSMN_STRING &&
-      strlen(key) == (size_t) (token.end - token.start) &&
-      strncmp(json + token.start, key, (size_t) (token.end - token.start)) == 0) {
-    return 0;
-  }
-  return -1;
-}
-
-// JSMN helper function to print the current token for debugging
-static inline void print_token(const char *response, jsmntok_t &token) {
-  Serial.write(response + token.start, (size_t) (token.end - token.start));
-  Serial.println();
+static location_cache_t location_cache;
+static uint8_t arena_buffer[ARENA_SIZE];
+
+// the persistent part of the lamp state
+typedef struct {
+  uint16_t interval;
+  uint8_t pixel_type;
+  uint8_t red, green, blue;
+} lamp_config_t;
+
+// degrade gracefully as the battery drains (battery %, trend %/day, interval s, update every n-th, features)
+static const policy_t default_policy[] PROGMEM = {
+  {10, POLICY_ANY_TREND, 3600, 2, 0},
+  {25, POLICY_ANY_TREND, 1800, 1, 0},
+  {50, 0, 900, 1, POLICY_LOCATION},
+  {100, POLICY_ANY_TREND, 0, 1, POLICY_ALL}
+};
+
+// colors above 255 are scaled down from 16 bit
+static inline uint8_t to_uint8(uint16_t value) {
+  if (value > 255) return value >> 8;
+  return value;
 }
 
-// convert a number of characters into an unsigned integer value
-unsigned int to_uint(const char *ptr, size_t len) {
-  unsigned int ret = 0;
-  for (uint8_t i = 0; i < len; i++) {
-    ret = (ret * 10) + (ptr[i] - '0');
+// the blink animation runs as a task: two color fades in 3ms steps, seven red, green and blue
+// flashes of 100ms each, then the new color is shown after a second
+#define BLINK_FADE    255
+#define BLINK_FLASH   (2 * BLINK_FADE)
+#define BLINK_DONE    (BLINK_FLASH + 7 * 3)
+static int8_t animation_task = -1;
+static uint16_t animation_step;
+
+static void animate() {
+  const uint16_t step = animation_step++;
+  if (step < BLINK_FADE) {
+    neo_pixel.setPixelColor(0, step, 255 - step, 0);
+  } else if (step < BLINK_FLASH) {
+    const uint8_t z = (uint8_t) (step - BLINK_FADE);
+    neo_pixel.setPixelColor(0, 0, z, 255 - z);
+    if (step == BLINK_FLASH - 1) sched_period(animation_task, 100);
+  } else if (step < BLINK_DONE) {
+    const uint8_t color = (uint8_t) ((step - BLINK_FLASH) % 3);
+    neo_pixel.setPixelColor(0, color == 0 ? 255 : 0, color == 1 ? 255 : 0, color == 2 ? 255 : 0);
+    if (step == BLINK_DONE - 1) sched_period(animation_task, 1100);
+  } else {
+    neo_pixel.setPixelColor(0, red, green, blue);
+    sched_cancel(animation_task);
+    animation_task = -1;
   }
-  return ret;
-}
-
-inline uint8_t to_uint8(const char *ptr, size_t len) {
-  unsigned int tmp = to_uint(ptr, len);
-  if(tmp > 255) return tmp >> 8;
-  return tmp;
+  neo_pixel.show();
 }
 
 void set_rgb_color(uint8_t r, uint8_t g, uint8_t b, bool blink) {
@@ -119,383 +290,382 @@ void set_rgb_color(uint8_t r, uint8_t g, uint8_t b, bool blink) {
     blue = b;
     neo_pixel.updateType(pixel_type);
 
-    Serial.print(F("updating color: "));
-    Serial.print(red);
-    Serial.print(F(":"));
-    Serial.print(green);
-    Serial.print(F(":"));
-    Serial.println(blue);
+    LOG_INFO("updating color: %u:%u:%u", red, green, blue);
 
+    // the animation runs after the cycle, the modem is not kept on for it
+    sched_cancel(animation_task);
     if (blink) {
-      Serial.println(F("blink lamp"));
-
-      for (uint8_t z = 0; z < 255; z++) {
-        neo_pixel.setPixelColor(0, z, 255 - z, 0);
-        neo_pixel.show();
-        delay(3);
-      }
-      for (uint8_t z = 0; z < 255; z++) {
-        neo_pixel.setPixelColor(0, 0, z, 255 - z);
-        neo_pixel.show();
-        delay(3);
-      }
-      for (int z = 0; z < 7; z++) {
-        neo_pixel.setPixelColor(0, 255, 0, 0);
-        neo_pixel.show();
-        delay(100);
-        neo_pixel.setPixelColor(0, 0, 255, 0);
-        neo_pixel.show();
-        delay(100);
-        neo_pixel.setPixelColor(0, 0, 0, 255);
-        neo_pixel.show();
-        delay(100);
-      }
+      LOG_DEBUG("blink lamp");
+      animation_step = 0;
+      animation_task = sched_add(animate, 0, 3);
+    } else {
+      animation_step = BLINK_DONE;
+      animation_task = sched_add(animate, 1000, 0);
+    }
+    if (animation_task < 0) {
+      neo_pixel.setPixelColor(0, red, green, blue);
+      neo_pixel.show();
     }
+  }
+}
 
-    delay(1000);
+// the color received with the payload, it is applied after all keys are read
+static uint8_t rcv_red, rcv_green, rcv_blue;
+static bool rcv_blink;
 
-    neo_pixel.setPixelColor(0, red, green, blue);
-    neo_pixel.show();
-
-    delay(100);
-  }
+// payload setters, called by protocol_process_payload()
+static void set_blink(bool blink) { rcv_blink = blink; }
+static void set_pixel_type(uint16_t type) { pixel_type = to_uint8(type); }
+static void set_red(uint16_t value) { rcv_red = to_uint8(value); }
+static void set_green(uint16_t value) { rcv_green = to_uint8(value); }
+static void set_blue(uint16_t value) { rcv_blue = to_uint8(value); }
 
+static void set_interval(uint16_t seconds) {
+  interval = seconds;
+  LOG_INFO("Interval: %us", interval);
 }
 
-static inline void print_hash(const char *sig) {
-  Serial.print(F("[HASH] "));
-  for (uint8_t i = 0; i < crypto_hash_BYTES; i++) Serial.print((unsigned char) sig[i], 16);
-  Serial.println();
+static void set_locate(bool requested) {
+  if (requested) {
+    LOG_INFO("location requested");
+    location_cache_request(&location_cache);
+  }
 }
 
+// the payload keys we understand
+static const protocol_field_t payload_fields[] PROGMEM = {
+  {protocol_key(P_BLINK), set_blink},
+  {protocol_key(P_PIXEL_TYPE), set_pixel_type},
+  {protocol_key(P_RED), set_red},
+  {protocol_key(P_GREEN), set_green},
+  {protocol_key(P_BLUE), set_blue},
+  {protocol_key(P_INTERVAL), set_interval},
+  {protocol_key(P_LOCATE), set_locate},
+  {protocol_key(P_POLICY), protocol_read_policy}
+};
 
 /*!
- * Process the JSON response from the backend. It should contain configuration
- * parameters that need to be set. The response must be signed and will be
- * checked for signature match and protocol version.
- *
- * @param response the request response, will be freed here
- * @param payload the extracted payload
- * @param signature the extracted payload signature
+ * Process payload and set configuration parameters from it.
+ * @param payload the payload to use, should be checked
  */
-void process_response(char *response, char *&payload, char *&signature) {
-  char tmp_signature[crypto_hash_BYTES], *tmp_payload = NULL;
-
-  jsmntok_t *token;
-  jsmn_parser parser;
-  jsmn_init(&parser);
-
-  // identify the number of tokens in our response, we expect 13
-  const uint8_t token_count = (const uint8_t) jsmn_parse(&parser, response, strlen(response), NULL, 0);
-  token = (jsmntok_t *) malloc(sizeof(*token) * token_count);
-
-  // TODO check token count and return if too many
-
-  // reset parser, parse and store tokens
-  jsmn_init(&parser);
-  const int parsed_token_count = jsmn_parse(&parser, response, strlen(response), token, token_count);
-  if (parsed_token_count == token_count && token[0].type == JSMN_OBJECT) {
-    uint8_t index = 0;
-    while (++index < token_count) {
-      if (jsoneq(response, token[index], P_VERSION) == 0 && token[index + 1].type == JSMN_STRING) {
-        index++;
-        if (strncmp_P(response + token[index].start, PSTR(PROTOCOL_VERSION_MIN), 3) != 0) {
-          Serial.print(F("protocol version mismatch: "));
-          print_token(response, token[index]);
-
-          // do not continue if the version does not match, free already copied payload or sig
-          error_flag |= E_PROTOCOL_FAIL;
-          break;
-        }
-      } else if (jsoneq(response, token[index], P_SIGNATURE) == 0 && token[index + 1].type == JSMN_STRING) {
-        index++;
-        Serial.print(F("signature: "));
-        print_token(response, token[index]);
-
-        // extract signature and decode it
-        base64_decode(tmp_signature, (response + token[index].start), token[index].end - token[index].start);
-      } else if (jsoneq(response, token[index], P_PAYLOAD) == 0 && token[index + 1].type == JSMN_OBJECT) {
-        index++;
-        Serial.print(F("payload: "));
-        print_token(response, token[index]);
-
-        // extract payload from json
-        uint8_t tmp_payload_length = (uint8_t) (token[index].end - token[index].start);
-        // allocate the temporary payload on the stack, we will copy it to heap after freeing some space
-        tmp_payload = (char *) alloca((size_t) (16 + tmp_payload_length));
-        sim800h.IMEI(tmp_payload);
-        strncpy(tmp_payload + 15, response + token[index].start, tmp_payload_length);
-        tmp_payload[15 + tmp_payload_length] = '\0';
-
-        index += 2 * token[index].size;
-      } else {
-        // simply ignore unknown keys
-        Serial.print(F("unknown key: "));
-        print_token(response, token[index]);
-        index++;
-      }
-    }
-  } else {
-    error_flag |= E_JSON_FAILED;
-  }
-
-  // free used heap, the token and the no longer used response
-  free(token);
-  free(response);
-
-  // copy the locally (stack) allocated payload and signature to heap
-  if(tmp_payload != NULL && tmp_signature != NULL) {
-    payload = strdup(tmp_payload);
-    signature = (char *) malloc(crypto_hash_BYTES);
-    memcpy(signature , tmp_signature, crypto_hash_BYTES);
+void process_payload(const char *payload) {
+  rcv_red = rcv_green = rcv_blue = 0;
+  rcv_blink = false;
+
+  if (protocol_process_payload(payload, payload_fields, sizeof(payload_fields) / sizeof(payload_fields[0]),
+                               error_flag)) {
+    // set new color and possibly, blink (unless the battery runs low)
+    set_rgb_color(rcv_red, rcv_green, rcv_blue, rcv_blink && (policy_current()->features & POLICY_ANIMATION));
   }
 }
 
 /*!
- * Verify payload using the given signature.
- *
- * @param payload the json payload to check (including prepended key!)
- * @param signature the signature for verification
- * @return true if the verification was successful
+ * Read the battery status from the modem.
  */
-bool verify_payload(const char *payload, const char *signature) {
-  // don't even start if we get NULLs
-  if (payload == NULL || signature == NULL) return false;
-
-  // first verify the payload signature
-  // required ram for signature verification: (PAYLOAD + IMEI) + SHA512 + HASH SIZE
-  const int required_ram = (strlen(payload) + 1) + 669 + crypto_hash_BYTES;
-  const int free_sram = query_free_sram();
-
-  Serial.print(F("payload verification: "));
-  Serial.print(free_sram);
-  Serial.print(F(" byte free ("));
-  Serial.print(required_ram);
-  Serial.println(F(" byte required)"));
-
-  bool signature_verified = false;
-  if (required_ram < free_sram) {
-
-    // hash payload and check whether it matches the signature hash
-    char *payload_hash = (char *) malloc(crypto_hash_BYTES);
-
-    crypto_hash_sha512((unsigned char *) payload_hash, (const unsigned char *) payload, strlen(payload));
-    print_hash(payload_hash);
-    print_hash(signature);
-
-    signature_verified = !memcmp(signature, payload_hash, crypto_hash_BYTES);
-    if (!signature_verified) error_flag |= E_SIG_VRFY_FAIL;
-
-    // free the payload hash
-    free(payload_hash);
-  } else {
-    Serial.println(F("payload too large, may crash..."));
-    error_flag |= E_NO_MEMORY;
-  }
-
-  return signature_verified;
+static bool read_battery(sim800_battery_t &battery) {
+  return sim800_battery(&battery);
 }
 
-
 /*!
- * Process payload and set configuration parameters from it.
- * @param payload the payload to use, should be checked
+ * Read the approximate GSM location and network time into fixed point values,
+ * the response is parsed while it arrives.
  */
-void process_payload(char *payload) {
-  jsmntok_t *token;
-  jsmn_parser parser;
-  jsmn_init(&parser);
-
-  // identify the number of tokens in our response, we expect 13
-  const uint8_t token_count = (const uint8_t) jsmn_parse(&parser, payload, strlen(payload), NULL, 0);
-  token = (jsmntok_t *) malloc(sizeof(*token) * token_count);
-
-  // reset parser, parse and store tokens
-  jsmn_init(&parser);
-  if (jsmn_parse(&parser, payload, strlen(payload), token, token_count) == token_count &&
-      token[0].type == JSMN_OBJECT) {
-    uint8_t index = 0;
-    uint8_t rcv_red = 0, rcv_green = 0, rcv_blue = 0;
-    bool blink = false;
-
-    while (++index < token_count) {
-      if (jsoneq(payload, token[index], P_BLINK) == 0 && token[index + 1].type == JSMN_PRIMITIVE) {
-        index++;
-        blink = (*(payload + token[index].start) - '0') != 0;
-      } else if (jsoneq(payload, token[index], P_PIXEL_TYPE) == 0 && token[index + 1].type == JSMN_PRIMITIVE) {
-        index++;
-        pixel_type = to_uint8(payload + token[index].start, (size_t) token[index].end - token[index].start);
-      } else if (jsoneq(payload, token[index], P_RED) == 0 && token[index + 1].type == JSMN_PRIMITIVE) {
-        index++;
-        rcv_red = to_uint8(payload + token[index].start, (size_t) token[index].end - token[index].start);
-      } else if (jsoneq(payload, token[index], P_GREEN) == 0 && token[index + 1].type == JSMN_PRIMITIVE) {
-        index++;
-        rcv_green = to_uint8(payload + token[index].start, (size_t) token[index].end - token[index].start);
-      } else if (jsoneq(payload, token[index], P_BLUE) == 0 && token[index + 1].type == JSMN_PRIMITIVE) {
-        index++;
-        rcv_blue = to_uint8(payload + token[index].start, (size_t) token[index].end - token[index].start);
-      } else if (jsoneq(payload, token[index], P_INTERVAL) == 0 && token[index + 1].type == JSMN_PRIMITIVE) {
-        index++;
-        Serial.print(F("Interval: "));
-        interval = to_uint(payload + token[index].start, (size_t) token[index].end - token[index].start);
-        Serial.print(interval);
-        Serial.println("s");
-      } else {
-        Serial.print(F("unknown payload key: "));
-        print_token(payload, token[index]);
-        index++;
-      }
-    }
+static bool read_location(sim800_location_t &location) {
+  return sim800_location(&location);
+}
 
-    // set new color and possibly, blink
-    set_rgb_color(rcv_red, rcv_green, rcv_blue, blink);
-  } else {
-    error_flag |= E_JSON_FAILED;
+/*!
+ * Query the location only if the cache needs a refresh: every LOCATION_REFRESH
+ * cycles, if the serving cell changed or if the backend
+ * asked for it.
+ */
+static void update_location() {
+  sim800_location_t location;
+  sim800_cell_t cell;
+  const sim800_cell_t *current = sim800_cell(&cell) ? &cell : NULL;
+
+  // unless the backend asks for it, the location is dropped if the battery runs low
+  if (!(policy_current()->features & POLICY_LOCATION) && !(location_cache.flags & LOCATION_REQUESTED)) return;
+  if (!location_cache_due(&location_cache, current, LOCATION_REFRESH)) return;
+  probe_start(PROBE_LOCATION);
+  bool found = read_location(location);
+  probe_stop(PROBE_LOCATION);
+  if (found) {
+    if (location_cache_update(&location_cache, &location, current)) LOG_INFO("new location >>> %lu", location.time);
+    else LOG_DEBUG(">>> %lu", location.time);
+    // the location reply carries the network time (UTC)
+    walltime_set(location.time);
   }
+}
 
-  free(token);
+/*!
+ * Take the network time from the modem clock (NITZ), if the network sends it.
+ */
+static void sync_time() {
+  uint32_t now;
+  if (sim800_time(&now)) walltime_set(now);
 }
 
 /*!
  * Send some information about the lamp and receive new RGB values.
  * The messages are signed using a board specific key
+ *
+ * @param battery the battery status read this cycle
  */
-void receive_rgb_data() {
-  uint16_t bat_status = 0, bat_percent = 0, bat_voltage = 0;
-  char *lat = NULL, *lon = NULL, *date = NULL, *time = NULL;
-  char *payload, *payload_hash, *auth_hash;
-  char *signature, *message;
-
-  // read battery status
-  sim800h.battery(bat_status, bat_percent, bat_voltage);
-  // read GSM approx. location
-  if (sim800h.location(lat, lon, date, time)) {
-    Serial.print(F(">>> "));
-    Serial.print(date);
-    Serial.print(F(" "));
-    Serial.println(time);
+void receive_rgb_data(const sim800_battery_t &battery) {
+  char imei[IMEI_LEN + 1];
+  char *payload, *signature = NULL, *message;
+  unsigned char *hashes;
+
+  sync_time();
+  // refresh the GSM approx. location if necessary
+  update_location();
+  uint32_t sampled = walltime_now();
+
+  // all buffers of this upload are released at the end
+  const arena_mark_t mark = arena_mark();
+
+  // the message is assembled in place: the payload is written to its end with the IMEI (key)
+  // in front of it for hashing, the envelope and the hashes are filled in afterwards
+  message = (char *) arena_alloc(MESSAGE_SIZE);
+  hashes = (unsigned char *) arena_alloc(UPLOAD_HASH_BYTES);
+  if (message == NULL || hashes == NULL) {
+    LOG_ERROR("out of memory");
+    error_flag |= E_NO_MEMORY;
+    arena_release(mark);
+    return;
   }
+#ifdef UPLINK_BOX
+  // the payload structure is written into the box after its zero bytes
+  memset(hashes, 0, UPLINK_BOX_ZEROBYTES);
+  payload = (char *) hashes + UPLINK_BOX_ZEROBYTES;
+#else
+  payload = message + MESSAGE_HEAD - IMEI_LEN;
+#endif
 
-  // read device IMEI, which is our key
-  payload = (char *) malloc(128);
-  if (sim800h.IMEI(payload)) {
-    Serial.print(F("authorization: "));
-    Serial.println(payload);
+  // read device IMEI, which is our key, it is kept to verify the response
+  if (sim800_imei(imei)) {
+    LOG_DEBUG("authorization: %s", imei);
+    memcpy(payload, imei, IMEI_LEN);
+    // the IMEI makes the random pool differ between devices, even before the first seed
+    static bool imei_added = false;
+    if (!imei_added) entropy_add(imei, IMEI_LEN);
+    imei_added = true;
   } else {
-    Serial.println(F("IMEI not found, can't send"));
-    free(payload);
-    free(lat);
-    free(lon);
-    free(date);
-    free(time);
+    LOG_ERROR("IMEI not found, can't send");
+    arena_release(mark);
     return;
   }
 
   // hashed payload structure IMEI{DATA}
-  // Example: '123456789012345{"lat":"12.475886","lon":"51.505264","bat":100,"lps":99999}'
+  // Example: '123456789012345{"ba":100,"lp":99999,"e":0,"la":"12.475886","lo":"51.505264"}'
   sprintf_P(payload + 15,
-            PSTR("{\"la\":\"%s\",\"lo\":\"%s\",\"ba\":%3d,\"lp\":%d,\"e\":%u}"),
-            lat == NULL ? "" : lat, lon == NULL ? "" : lon, bat_percent, loop_counter, error_flag);
-
-  // free latitude and longitude
-  free(lat);
-  free(lon);
-  free(date);
-  free(time);
-
-  // create hashes from the payload structure as well as the IMEI (key), sig buffer is used twice!
-  signature = (char *) malloc(crypto_hash_BYTES);
-
-  payload_hash = (char *) malloc(89);
-  crypto_hash((unsigned char *) signature, (const unsigned char *) payload, strlen(payload));
-  base64_encode(payload_hash, signature, crypto_hash_BYTES);
-
-  auth_hash = (char *) malloc(89);
-  Serial.print(F("payload hash: "));
-  Serial.println(payload_hash);
-
-  crypto_hash((unsigned char *) signature, (const unsigned char *) payload, 15);
-  base64_encode(auth_hash, signature, crypto_hash_BYTES);
-
-  // free signature buffer
-  free(signature);
-  signature = NULL;
-
-  Serial.print(F("auth hash   : "));
-  Serial.println(auth_hash);
+            PSTR("{\"ba\":%3d,\"lp\":%d,\"e\":%u"),
+            battery.percent, loop_counter, error_flag);
+  // the battery policy in use
+  sprintf_P(payload + strlen(payload), PSTR(",\"pl\":%u"), policy_level());
+  // the message buffer high-water mark
+  sprintf_P(payload + strlen(payload), PSTR(",\"hw\":%u"), arena_peak());
+  // the location is only sent if it changed
+  if (location_cache_changed(&location_cache)) {
+    char lat[AT_FIXED6_STRLEN], lon[AT_FIXED6_STRLEN];
+    sprintf_P(payload + strlen(payload), PSTR(",\"la\":\"%s\",\"lo\":\"%s\""),
+              at_fixed6_str(lat, location_cache.fix.lat), at_fixed6_str(lon, location_cache.fix.lon));
+  }
+  // the sampling time (unix time, UTC), if the network time is known
+  if (sampled) sprintf_P(payload + strlen(payload), PSTR(",\"ts\":%lu"), sampled + WALLTIME_UNIX_OFFSET);
+#ifdef SIM800_HW_UART
+  // report the negotiated modem baud rate, so we can compare sites
+  sprintf_P(payload + strlen(payload), PSTR(",\"br\":%lu"), (unsigned long) sim800_baud_stats()->baud);
+#endif
+#ifdef PROBE_REPORT
+  // where the awake time goes, average and longest phase durations
+  probe_json(payload + strlen(payload));
+#endif
+#ifdef MEMORY_REPORT
+  // stack high-water mark and heap fragmentation
+  heap_stats_t heap;
+  query_heap_stats(&heap);
+  sprintf_P(payload + strlen(payload), PSTR(",\"sk\":%u,\"hf\":%u,\"hl\":%u"),
+            query_stack_peak(), heap.blocks, heap.largest);
+#endif
+  strcat_P(payload, PSTR("}"));
+
+#ifdef UPLINK_HMAC
+  // authenticate the payload structure with the device key
+  probe_start(PROBE_HASH);
+  if (!protocol_authenticate(hashes, payload)) {
+    probe_stop(PROBE_HASH);
+    LOG_ERROR("no device key, can't send");
+    arena_release(mark);
+    return;
+  }
 
-  // finally, compile the message
-  message = (char *) malloc(300);
-  sprintf_P(message,
-            PSTR("{\"v\":\"0.0.1\",\"a\":\"%s\",\"s\":\"%s\",\"p\":%s}"),
-            auth_hash, payload_hash, payload + 15);
+  // fill in the envelope in front of the payload, this overwrites the IMEI
+  protocol_envelope_hmac(message, imei, hashes);
+#elif defined(UPLINK_BOX)
+  // encrypt the payload structure in place, it costs no Curve25519 operation
+  probe_start(PROBE_HASH);
+  const uint16_t box_length = (uint16_t) (UPLINK_BOX_ZEROBYTES + strlen(payload));
+  uint32_t counter;
+  if (!uplink_box_seal(hashes, hashes, box_length, &counter)) {
+    probe_stop(PROBE_HASH);
+    LOG_ERROR("no shared key or nonce, can't send");
+    arena_release(mark);
+    return;
+  }
 
-  // free payload and hashes
-  free(payload);
+  // the envelope is written into the message buffer, the box is sent without its zero bytes
+  protocol_envelope_box(message, imei, uplink_box_prefix(), counter, hashes + UPLINK_BOX_BOXZEROBYTES,
+                        box_length - UPLINK_BOX_BOXZEROBYTES);
+#else
+  // create hashes from the payload structure as well as the IMEI (key)
+  probe_start(PROBE_HASH);
+  crypto_hash(hashes, (const unsigned char *) payload, strlen(payload));
+  crypto_hash(hashes + crypto_hash_BYTES, (const unsigned char *) payload, IMEI_LEN);
+
+  // fill in the envelope in front of the payload, this overwrites the IMEI
+  strcpy_P(message, PSTR("{\"v\":\"0.0.1\",\"a\":\""));
+  base64_encode(message + strlen(message), (char *) hashes + crypto_hash_BYTES, crypto_hash_BYTES);
+  strcat_P(message, PSTR("\",\"s\":\""));
+  base64_encode(message + strlen(message), (char *) hashes, crypto_hash_BYTES);
+  memcpy_P(message + strlen(message), PSTR("\",\"p\":"), 6);
+  strcat_P(message, PSTR("}"));
+#endif
   payload = NULL;
-  free(payload_hash);
-  free(auth_hash);
+  probe_stop(PROBE_HASH);
 
-  Serial.print(F("message: '"));
-  Serial.print(message);
-  Serial.println("'");
-  Serial.println(strlen(message));
+  LOG_DEBUG("message: '%s' (%u)", message, strlen(message));
 
   // send the request
   unsigned long response_length;
   unsigned int http_status;
+  probe_start(PROBE_HTTP);
   http_status = sim800h.HTTP_post(PUSH_URL, response_length, message, strlen(message));
-  // free message after it's been sent
-  free(message);
+  // release message and hashes after it's been sent
+  arena_release(mark);
+  message = NULL;
 
-  Serial.print(http_status);
-  Serial.print(F(" ("));
-  Serial.print(response_length);
-  Serial.println(F(")"));
+  LOG_INFO("%u (%lu)", http_status, response_length);
 
   if (http_status != 200) {
-    Serial.println(F("HTTP POST failed"));
+    probe_stop(PROBE_HTTP);
+    LOG_WARN("HTTP POST failed");
   } else {
-    if (response_length < 300) {
-      char *response = (char *) malloc((size_t) response_length + 1);
+    // the backend has the location now
+    location_cache_reported(&location_cache);
+#ifdef PROBE_REPORT
+    // and the phase statistics, start over
+    probe_reset();
+#endif
+
+    if (response_length <= RESPONSE.length) {
+      char *response = (char *) arena_alloc((size_t) response_length + 1);
+      if (response == NULL) {
+        probe_stop(PROBE_HTTP);
+        LOG_ERROR("out of memory");
+        error_flag |= E_NO_MEMORY;
+        return;
+      }
       response[response_length] = '\0';
+#ifdef SIM800_HW_UART
+      // the interrupt driven UART buffers everything, read the response in one go
+      sim800h.HTTP_read(response, 0, (size_t) response_length);
+#else
+      uint32_t pos = 0;
       // we need to read the response in little chunks, else the
       // software serial will just return trash, omissions etc.
-      uint32_t pos = 0;
       do pos += sim800h.HTTP_read(response + pos, pos, SIM800_BUFSIZE); while (pos < response_length);
+#endif
+      probe_stop(PROBE_HTTP);
 
-      Serial.print(F("RESPONSE: '"));
-      Serial.print(response);
-      Serial.println(F("'"));
+      LOG_DEBUG("RESPONSE: '%s'", response);
 
       // process response, extract payload and signature
-      process_response(response, payload, signature);
+      probe_start(PROBE_RESPONSE);
+      protocol_process_response(response, imei, payload, signature, error_flag);
       // verify and process payload
-      if (verify_payload(payload, signature)) {
-        Serial.println(F("signature verified OK"));
-        process_payload(payload + 15);
+      if (protocol_verify_payload(payload, signature, error_flag)) {
+        LOG_INFO("signature verified OK");
+        process_payload(payload + IMEI_LEN);
       } else {
-        Serial.println(F("signature failed to verify"));
+        LOG_WARN("signature failed to verify");
       }
-      free(signature);
-      free(payload);
+      arena_release(mark);
+      probe_stop(PROBE_RESPONSE);
 
     } else {
-      Serial.print(F("HTTP RESPONSE too long: "));
-      Serial.println(response_length);
+      probe_stop(PROBE_HTTP);
+      LOG_WARN("HTTP RESPONSE too long: %lu", response_length);
     }
   }
 }
 
+/*!
+ * Restore the last configuration and the loop counter from EEPROM, so the
+ * device does not need a network round-trip after a reset.
+ */
+static void load_config() {
+  store_init();
+  lamp_config_t config;
+  if (store_load(STORE_CONFIG, &config, sizeof(config))) {
+    interval = config.interval;
+    pixel_type = config.pixel_type;
+    red = config.red;
+    green = config.green;
+    blue = config.blue;
+  }
+  store_load(STORE_COUNTER, &loop_counter, sizeof(loop_counter));
+}
+
+/*!
+ * Save the configuration and the loop counter, only changes are written.
+ */
+static void save_config() {
+  lamp_config_t config = {interval, pixel_type, red, green, blue};
+  store_save(STORE_CONFIG, &config, sizeof(config));
+  store_save(STORE_COUNTER, &loop_counter, sizeof(loop_counter));
+}
+
+#ifdef MODEM_STANDBY
+/*!
+ * RI interrupt. The low level wakes the MCU from power down as well, so the interrupt
+ * is detached until the next cycle is done.
+ */
+static void ring() {
+  detachInterrupt(digitalPinToInterrupt(SIM800_RI));
+  sched_post(EVENT_RING);
+}
+#endif
+
+/*!
+ * A call, SMS or unsolicited output of the modem asks for an update, run the cycle now.
+ */
+static void on_event(uint8_t event) {
+  LOG_INFO("event %u", event);
+  sched_delay(cycle_task, 0);
+}
+
 /*!
  * Initial setup.
  */
 void setup() {
-  Serial.begin(BAUD);
+  DEBUG_SERIAL.begin(DEBUG_BAUD);
+  log_init(DEBUG_SERIAL);
 
   pinMode(LED, OUTPUT);
   pinMode(WATCHDOG, INPUT);
 
+  // phase timing (Timer1), must be started before the watchdog calibration borrows the timer
+  probe_init();
+  // calibrates the watchdog, so all following sleeps are accurate
+  sched_init(on_event);
+  // boot into the last known configuration
+  load_config();
+  // the random pool (randombytes) from the seed in EEPROM and fresh noise, borrows Timer1 as well
+  entropy_init();
+  arena_init(arena_buffer, sizeof(arena_buffer));
+
   digitalWrite(LED, HIGH);
   delay(100);
   digitalWrite(LED, LOW);
@@ -504,6 +674,35 @@ void setup() {
   // edit APN settings in config.h
   sim800h.setAPN(F(FONA_APN), F(FONA_USER), F(FONA_PASS));
 
+  location_cache_init(&location_cache);
+  policy_init(default_policy, sizeof(default_policy) / sizeof(default_policy[0]));
+
+#ifdef UPLINK_KEY
+  // store the device key, the EEPROM is only written if it changed
+  {
+    const uint8_t key[UPLINK_KEY_BYTES] = {UPLINK_KEY};
+    if (!uplink_key_provision(key)) LOG_ERROR("device key not stored");
+  }
+#endif
+#ifdef UPLINK_BOX_SECRET
+  // store the key shared with the backend, only computed if the keys changed (one Curve25519 operation)
+  {
+    const uint8_t secret_key[UPLINK_BOX_KEYBYTES] = {UPLINK_BOX_SECRET};
+    const uint8_t peer_key[UPLINK_BOX_KEYBYTES] = {UPLINK_BOX_PEER};
+    if (!uplink_box_provision(secret_key, peer_key)) LOG_ERROR("shared key not stored");
+  }
+#endif
+#ifdef UPLINK_BOX
+  if (!uplink_box_init()) LOG_ERROR("no shared key");
+#endif
+
+#ifdef SIM800_HW_UART
+  // start with the last negotiated modem baud rate
+  sim800_serial.begin(sim800_baud_load());
+#else
+  sim800_serial.begin(SIM800_SOFT_BAUD);
+#endif
+
   neo_pixel.begin(); // initialize NeoPixel
   neo_pixel.updateType(pixel_type);
   neo_pixel.show(); // Initialize all pixels to 'off'
@@ -517,47 +716,133 @@ void setup() {
   neo_pixel.setPixelColor(0, 0, 0, 255);
   neo_pixel.show();
   sleep(5);
-  neo_pixel.setPixelColor(0, 0, 0, 0);
+  // restore the last color right away, the modem may take a while
+  neo_pixel.setPixelColor(0, red, green, blue);
   neo_pixel.show();
 
+  cycle_task = sched_add(cycle, 0, cycle_interval() * 1000UL);
 }
 
-void loop() {
+/*!
+ * The cycle interval, the backend setting unless the battery policy requires a longer
+ * one. The lamp has nothing to do between updates, so it simply waits longer.
+ */
+static uint16_t cycle_interval() {
+  const policy_t *policy = policy_current();
+  const uint16_t minimum = policy->interval > interval ? policy->interval : interval;
+  const uint32_t wait = (uint32_t) minimum * policy->upload;
+  return (uint16_t) (wait > 65535 ? 65535 : wait);
+}
+
+/*!
+ * Attach GPRS, measured as its own phase.
+ */
+static bool enable_gprs() {
+  probe_start(PROBE_GPRS);
+  bool attached = sim800h.enableGPRS();
+  probe_stop(PROBE_GPRS);
+  return attached;
+}
+
+/*!
+ * Update cycle. Initializes the mobile network and requests the
+ * current color. Runs every interval seconds.
+ */
+static void cycle() {
+  // nothing is left from the last cycle
+  arena_reset();
+
   digitalWrite(LED, HIGH);
   pinMode(WATCHDOG, INPUT);
 
   // wake up the SIM800
-  if (sim800h.wakeup()) {
+  probe_start(PROBE_WAKEUP);
+  bool awake = sim800h.wakeup();
+#ifdef SIM800_HW_UART
+  // the modem keeps its stored rate, find it if ours differs (e.g. the EEPROM was erased)
+  if (!awake && sim800_baud_detect()) awake = sim800h.wakeup();
+#endif
+  probe_stop(PROBE_WAKEUP);
+  if (awake) {
+    // the battery decides how this and the next cycles run
+    sim800_battery_t battery = {0, 0, 0};
+    if (read_battery(battery)) policy_update((uint8_t) battery.percent);
+    // the lamp has no sensor, the low bits of the battery voltage and the wakeup time are noise
+    const uint32_t woken = micros();
+    entropy_add(&battery.voltage, sizeof(battery.voltage));
+    entropy_add(&woken, sizeof(woken));
+
+#ifdef SIM800_HW_UART
+    // negotiate the fastest reliable modem link once, then keep checking it
+    static bool baud_negotiated = false;
+    if (!baud_negotiated) baud_negotiated = sim800_baud_negotiate() != 0;
+    else sim800_baud_check();
+#endif
+
     // try to connect and enable GPRS, send if successful
     uint8_t tries;
     for (tries = 2; tries > 0; tries--) {
-      if (sim800h.registerNetwork(60000) && sim800h.enableGPRS()) {
-        Serial.print(query_free_sram());
-        Serial.println(F(" byte free"));
-
-        receive_rgb_data();
-
-        Serial.print(query_free_sram());
-        Serial.println(F(" byte free"));
+      probe_start(PROBE_REGISTER);
+      bool registered = sim800h.registerNetwork(60000);
+      probe_stop(PROBE_REGISTER);
+      if (registered && enable_gprs()) {
+        LOG_DEBUG("%d byte free", query_free_sram());
+        receive_rgb_data(battery);
+        LOG_DEBUG("%d byte free", query_free_sram());
 
         break;
       }
-      Serial.println();
-      Serial.println(F("mobile network failed"));
+      LOG_WARN("mobile network failed");
     }
     if (tries == 0) error_flag |= E_NO_CONNECTION;
   }
+#ifdef MODEM_STANDBY
+  // stay reachable, the modem wakes us with RI
+  modem_standby = awake && sim800h.standby();
+  if (!modem_standby) sim800h.shutdown();
+#else
   sim800h.shutdown();
+#endif
 
   pinMode(WATCHDOG, OUTPUT);
   digitalWrite(LED, LOW);
   loop_counter++;
+  save_config();
+  if (loop_counter % ENTROPY_SAVE_CYCLES == 0) entropy_save();
+
+  // start the next cycle on the wall clock boundary (e.g. every full 5 minutes) if the time is
+  // known, else relative to the start of this one; the backend or the battery policy may have
+  // changed the interval
+  const uint16_t next = cycle_interval();
+  sched_period(cycle_task, next * 1000UL);
+  if (walltime_valid()) sched_delay(cycle_task, walltime_until(next));
+
+#if LOG_LEVEL >= LOG_LEVEL_DEBUG
+  char probes[PROBE_JSON_LEN];
+  LOG_DEBUG("phases%s", probe_json(probes));
+
+  heap_stats_t heap;
+  query_heap_stats(&heap);
+  LOG_DEBUG("arena peak %u, stack peak %u, heap %u free blocks, largest %u",
+            arena_peak(), query_stack_peak(), heap.blocks, heap.largest);
+#endif
 
-  Serial.print(F("sleeping for "));
-  Serial.print(interval);
-  Serial.println(F("s"));
+  LOG_INFO("policy %u, trend %d%%/d, interval %us", policy_level(), policy_trend(), next);
   delay(100);
 
-  // sleep interval seconds (put MCU in low power mode)
-  sleep(interval);
+#ifdef MODEM_STANDBY
+  // listen to the modem until the next cycle, the rest of the last response is dropped
+  if (modem_standby) {
+    uart_clear();
+    uart_notify(EVENT_MODEM);
+    attachInterrupt(digitalPinToInterrupt(SIM800_RI), ring, LOW);
+  }
+#endif
+}
+
+/*!
+ * Main loop. Runs the cycle task and sleeps (MCU in low power mode) in between.
+ */
+void loop() {
+  sched_run();
 }
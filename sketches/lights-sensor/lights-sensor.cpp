@@ -26,11 +26,37 @@
 #include <UbirchSIM800.h>
 #include <Base64.h>
 #include <jsmn.h>
+#include <ubirch_protocol.h>
 #include <i2c.h>
 #include <isl29125.h>
 #include <avrsleep.h>
+#include <entropy.h>
 #include <freeram.h>
-#include <alloca.h>
+#include <scheduler.h>
+#include <walltime.h>
+#include <probe.h>
+#include <policy.h>
+#include <store.h>
+#include <arena.h>
+#include <json_schema.h>
+#include <debug.h>
+#include <logging.h>
+#include <sim800_at.h>
+#include <location_cache.h>
+#if defined(UPLINK_HMAC) || defined(UPLINK_KEY)
+#  include <uplink_key.h>
+#endif
+#if defined(UPLINK_BOX) || defined(UPLINK_BOX_SECRET)
+#  include <uplink_box.h>
+#endif
+#include <sim800_sms.h>
+#include <sms_uplink.h>
+#ifdef SIM800_HW_UART
+#  include <UARTStream.h>
+#  include <sim800_baud.h>
+#else
+#  include <SoftwareSerial.h>
+#endif
 
 extern "C" {
 #include <avrnacl.h>
@@ -43,251 +69,252 @@ extern "C" {
 // default wakup interval in seconds
 #define DEFAULT_INTERVAL 5*60
 
+// query the GSM location every n-th cycle (default 8 hours)
+#ifndef LOCATION_REFRESH
+#  define LOCATION_REFRESH 96
+#endif
+
+// reseed from fresh noise and store a new random seed every n-th cycle (default 8 hours),
+// it is also replaced at every reset
+#ifndef ENTROPY_SAVE_CYCLES
+#  define ENTROPY_SAVE_CYCLES 96
+#endif
+
 #define LED 13
 #define WATCHDOG 6
 
-// protocol version check
-#define PROTOCOL_VERSION_MIN "0.0"
-// json keys
-#define P_SIGNATURE "s"
-#define P_VERSION "v"
-#define P_PAYLOAD "p"
+// payload keys
 #define P_SENSITIVITY "s"
 #define P_IR_FILTER "ir"
 #define P_INTERVAL "i"
+#define P_LOCATE "l"
+#define P_POLICY "pp"
+
+// EEPROM records
+#define STORE_CONFIG  0
+#define STORE_COUNTER 1
 
 // error flags
 #define E_SENSOR_FAILED 0b00000001
-#define E_PROTOCOL_FAIL 0b00000010
-#define E_SIG_VRFY_FAIL 0b00000100
-#define E_JSON_FAILED   0b00001000
-#define E_NO_MEMORY     0b10000000
+#define E_PROTOCOL_FAIL PROTOCOL_E_VERSION
+#define E_SIG_VRFY_FAIL PROTOCOL_E_SIGNATURE
+#define E_JSON_FAILED   PROTOCOL_E_JSON
+#define E_NO_MEMORY     PROTOCOL_E_MEMORY
 #define E_NO_CONNECTION 0b01000000
 
 #define ISL_327LUX_MAX 65000
 #define ISL_10KLUX_MIN 8000
 
-UbirchSIM800 sim800h = UbirchSIM800();
+// the phase timing statistics are only sent if PROBE_REPORT is defined
+#ifdef PROBE_REPORT
+#  define PROBE_ENABLED true
+#else
+#  define PROBE_ENABLED false
+#endif
+
+// the stack and heap statistics are only sent if MEMORY_REPORT is defined
+#ifdef MEMORY_REPORT
+#  define MEMORY_ENABLED true
+#else
+#  define MEMORY_ENABLED false
+#endif
+
+// SRAM set aside for the message buffers of a cycle
+#ifndef ARENA_BUDGET
+#  define ARENA_BUDGET 1024
+#endif
+
+// the IMEI is prepended to the payload for hashing
+#define IMEI_LEN 15
+// a base64 encoded payload hash
+constexpr uint16_t HASH_B64_LEN = json::base64(crypto_hash_BYTES);
+
+#if defined(UPLINK_HMAC) && defined(UPLINK_BOX)
+#  error "UPLINK_HMAC and UPLINK_BOX are exclusive, the box is authenticated with the shared key"
+#endif
+
+// uplink payload, the worst case includes all fields that are only sent sometimes
+constexpr json_t BATCH_SAMPLE = json::array(5, json::UINT16);
+constexpr json_t UPLINK = json::object(
+    json::field("r", json::UINT16), json::field("g", json::UINT16), json::field("b", json::UINT16),
+    json::field("s", json::FLAG), json::field("ba", json::UINT16), json::field("lp", json::UINT16),
+    json::field("e", json::UINT8), json::field("pl", json::UINT8), json::field("hw", json::UINT16),
+    json::field("h", json::array(POLICY_UPLOAD_MAX - 1, BATCH_SAMPLE)),
+    json::field("la", json::string(AT_FIXED6_STRLEN - 1)), json::field("lo", json::string(AT_FIXED6_STRLEN - 1)),
+    json::field("ts", json::UINT32), json::field("br", json::UINT32),
+    json::when(PROBE_ENABLED, json::field("pt", json::array(PROBE_PHASES, json::UINT16))),
+    json::when(PROBE_ENABLED, json::field("px", json::array(PROBE_PHASES, json::UINT16))),
+    json::when(MEMORY_ENABLED, json::field("sk", json::UINT16)),
+    json::when(MEMORY_ENABLED, json::field("hf", json::UINT16)),
+    json::when(MEMORY_ENABLED, json::field("hl", json::UINT16)));
+
+// downlink payload, the policy table values are at most 6 characters ("-127", "65535")
+constexpr json_t DOWNLINK = json::object(
+    json::field(P_SENSITIVITY, json::FLAG), json::field(P_IR_FILTER, json::UINT8),
+    json::field(P_INTERVAL, json::UINT16), json::field(P_LOCATE, json::FLAG),
+    json::field(P_POLICY, json::array(POLICY_ROWS, json::array(5, json::INT16))));
+
+#if defined(UPLINK_HMAC)
+// the uplink is authenticated with a tag of IMEI{DATA} instead of the hashes
+constexpr uint16_t UPLOAD_HASH_BYTES = UPLINK_TAG_BYTES;
+#elif defined(UPLINK_BOX)
+// the uplink is IMEI{DATA} encrypted with the shared key, the box replaces the hashes
+constexpr uint16_t UPLOAD_HASH_BYTES = UPLINK_BOX_ZEROBYTES + IMEI_LEN + UPLINK.length + 1;
+constexpr uint16_t BOX_B64_LEN = json::base64(UPLOAD_HASH_BYTES - 1 - UPLINK_BOX_BOXZEROBYTES);
+#else
+constexpr uint16_t UPLOAD_HASH_BYTES = 2 * crypto_hash_BYTES;
+#endif
+
+// the envelopes, the version is "0.0.1" up ("0.1.0" with UPLINK_HMAC, "0.2.1" with UPLINK_BOX)
+// and "0.0.x" down
+#if defined(UPLINK_HMAC)
+constexpr json_t MESSAGE = json::object(
+    json::field(P_VERSION, json::string(5)), json::field(P_DEVICE, json::string(IMEI_LEN)),
+    json::field(P_TAG, json::string(json::base64(UPLINK_TAG_BYTES))), json::field(P_PAYLOAD, UPLINK));
+#elif defined(UPLINK_BOX)
+constexpr json_t MESSAGE = json::object(
+    json::field(P_VERSION, json::string(5)), json::field(P_DEVICE, json::string(IMEI_LEN)),
+    json::field(P_PREFIX, json::string(json::base64(UPLINK_BOX_PREFIXBYTES))),
+    json::field(P_NONCE, json::UINT32), json::field(P_BOX, json::string(BOX_B64_LEN)));
+#else
+constexpr json_t MESSAGE = json::object(
+    json::field(P_VERSION, json::string(5)), json::field("a", json::string(HASH_B64_LEN)),
+    json::field(P_SIGNATURE, json::string(HASH_B64_LEN)), json::field(P_PAYLOAD, UPLINK));
+#endif
+constexpr json_t RESPONSE = json::object(
+    json::field(P_VERSION, json::string(8)), json::field(P_SIGNATURE, json::string(HASH_B64_LEN)),
+    json::field(P_PAYLOAD, DOWNLINK));
+
+// the message buffer including the terminating zero, the payload starts after the envelope head
+constexpr uint16_t MESSAGE_SIZE = MESSAGE.length + 1;
+constexpr uint16_t MESSAGE_HEAD = MESSAGE.length - UPLINK.length - 1;
+
+// all message buffers of a cycle are allocated from a static arena, it must hold the worst case of
+// sending (message and binary hashes) and receiving (response and tokens, then payload, signature and hash)
+constexpr uint16_t UPLOAD_PEAK = MESSAGE_SIZE + UPLOAD_HASH_BYTES;
+constexpr uint16_t RESPONSE_PEAK = RESPONSE.length + 1 + RESPONSE.tokens * sizeof(jsmntok_t);
+constexpr uint16_t DOWNLINK_PEAK = IMEI_LEN + DOWNLINK.length + 1 + crypto_hash_BYTES +
+                                   json::max(crypto_hash_BYTES, DOWNLINK.tokens * sizeof(jsmntok_t));
+constexpr uint16_t ARENA_SIZE = json::max(UPLOAD_PEAK, json::max(RESPONSE_PEAK, DOWNLINK_PEAK));
+
+static_assert(ARENA_SIZE <= ARENA_BUDGET, "message buffers exceed the SRAM budget (ARENA_BUDGET)");
+static_assert(DOWNLINK.length < 256, "the downlink payload length must fit into 8 bit");
+
+// send samples by SMS if GPRS fails
+#ifdef SMS_GATEWAY
+#  define SMS_FALLBACK
+#  ifndef SMS_RECORDS
+#    define SMS_RECORDS 1
+#  endif
+#  if SMS_RECORDS < 1 || SMS_RECORDS > SMS_SENSOR_RECORDS_MAX
+#    error "SMS_RECORDS must be between 1 and SMS_SENSOR_RECORDS_MAX"
+#  endif
+#endif
+
+#ifdef SIM800_HW_UART
+// the modem is connected to the hardware UART, interrupt driven and buffered
+UARTStream sim800_serial;
+#else
+SoftwareSerial sim800_serial(SIM800_RX, SIM800_TX);
+#endif
+UbirchSIM800 sim800h = UbirchSIM800(sim800_serial);
+
+// events posted by interrupts, handled in sched_run()
+#define EVENT_RING  1 // the modem pulled RI low (incoming call or SMS)
+#define EVENT_MODEM 2 // unsolicited modem output on the hardware UART
+
+// with its RI pin wired (an external interrupt pin, hardware UART only) the modem stays in
+// standby between cycles, so the backend can call or text the device to ask for an update
+#if defined(SIM800_HW_UART) && defined(SIM800_RI)
+#  define MODEM_STANDBY
+static bool modem_standby = false;
+#endif
 
 // this counts up as long as we don't have a reset
 static uint16_t loop_counter = 1;
 static uint8_t error_flag = 0x00;
+// the measurement cycle task
+static int8_t cycle_task = -1;
+static void cycle();
+static uint16_t cycle_interval();
 
 // internal sensor state
 static uint16_t interval = DEFAULT_INTERVAL;
 static uint8_t sensitivity = ISL_MODE_375LUX;
 static uint8_t infrared_filter = ISL_FILTER_IR_MAX;
+static location_cache_t location_cache;
+static uint8_t arena_buffer[ARENA_SIZE];
+
+// the persistent part of the sensor state
+typedef struct {
+  uint16_t interval;
+  uint8_t sensitivity;
+  uint8_t infrared_filter;
+} sensor_config_t;
+
+// degrade gracefully as the battery drains (battery %, trend %/day, interval s, upload every n-th, features)
+static const policy_t default_policy[] PROGMEM = {
+  {10, POLICY_ANY_TREND, 3600, 4, 0},
+  {25, POLICY_ANY_TREND, 1800, 2, POLICY_SMS},
+  {50, 0, 900, 1, POLICY_LOCATION | POLICY_SMS},
+  {100, POLICY_ANY_TREND, 0, 1, POLICY_ALL}
+};
+
+// samples taken between uploads, the newest sample is sent with the upload
+typedef struct {
+  uint32_t taken;
+  uint16_t red, green, blue;
+  uint8_t sensitivity;
+} batch_sample_t;
+static batch_sample_t batch[POLICY_UPLOAD_MAX - 1];
+static uint8_t batch_count = 0;
+static uint8_t upload_skipped = 0;
+static bool upload_requested = false;
+
+#ifdef SMS_FALLBACK
+// samples waiting to be sent by SMS
+static sms_sensor_record_t sms_records[SMS_RECORDS];
+static uint8_t sms_record_count = 0;
+#endif
 
-static int jsoneq(const char *json, jsmntok_t &token, const char *key) {
-  if (token.type == JSMN_STRING &&
-      strlen(key) == (size_t) (token.end - token.start) &&
-      strncmp(json + token.start, key, (size_t) (token.end - token.start)) == 0) {
-    return 0;
-  }
-  return -1;
+// payload setters, called by protocol_process_payload()
+static void set_sensitivity(bool high) {
+  sensitivity = high ? ISL_MODE_10KLUX : ISL_MODE_375LUX;
+  LOG_INFO("sensitivity: %u lux", high ? 10000 : 375);
 }
 
-// JSMN helper function to print the current token for debugging
-static inline void print_token(const char *response, jsmntok_t &token) {
-  Serial.write(response + token.start, (size_t) (token.end - token.start));
-  Serial.println();
+static void set_infrared_filter(uint8_t filter) {
+  infrared_filter = filter;
+  LOG_INFO("infrared filter: 0x%x", infrared_filter);
 }
 
-// convert a number of characters into an unsigned integer value
-static unsigned int to_uint(const char *ptr, size_t len) {
-  unsigned int ret = 0;
-  for (uint8_t i = 0; i < len; i++) {
-    ret = (ret * 10) + (ptr[i] - '0');
-  }
-  return ret;
+static void set_interval(uint16_t seconds) {
+  interval = seconds;
+  LOG_INFO("Interval: %us", interval);
 }
 
-// print a hex representation of the has byte array
-static inline void print_hash(const char *sig) {
-  Serial.print(F("[HASH] "));
-  for (uint8_t i = 0; i < crypto_hash_BYTES; i++) Serial.print((unsigned char) sig[i], 16);
-  Serial.println();
-}
-
-/*!
- * Process the JSON response from the backend. It should contain configuration
- * parameters that need to be set. The response must be signed and will be
- * checked for signature match and protocol version.
- *
- * @param response the request response, will be freed here
- * @param payload the extracted payload
- * @param signature the extracted payload signature
- */
-void process_response(char *response, char *&payload, char *&signature) {
-  char tmp_signature[crypto_hash_BYTES], *tmp_payload = NULL;
-
-  jsmntok_t *token;
-  jsmn_parser parser;
-  jsmn_init(&parser);
-
-  // identify the number of tokens in our response, we expect 13
-  const uint8_t token_count = (const uint8_t) jsmn_parse(&parser, response, strlen(response), NULL, 0);
-  token = (jsmntok_t *) malloc(sizeof(*token) * token_count);
-
-  // TODO check token count and return if too many
-
-  // reset parser, parse and store tokens
-  jsmn_init(&parser);
-  const int parsed_token_count = jsmn_parse(&parser, response, strlen(response), token, token_count);
-  if (parsed_token_count == token_count && token[0].type == JSMN_OBJECT) {
-    uint8_t index = 0;
-    while (++index < token_count) {
-      if (jsoneq(response, token[index], P_VERSION) == 0 && token[index + 1].type == JSMN_STRING) {
-        index++;
-        if (strncmp_P(response + token[index].start, PSTR(PROTOCOL_VERSION_MIN), 3) != 0) {
-          Serial.print(F("protocol version mismatch: "));
-          print_token(response, token[index]);
-
-          // do not continue if the version does not match, free already copied payload or sig
-          error_flag |= E_PROTOCOL_FAIL;
-          break;
-        }
-      } else if (jsoneq(response, token[index], P_SIGNATURE) == 0 && token[index + 1].type == JSMN_STRING) {
-        index++;
-        Serial.print(F("signature: "));
-        print_token(response, token[index]);
-
-        // extract signature and decode it
-        base64_decode(tmp_signature, (response + token[index].start), token[index].end - token[index].start);
-      } else if (jsoneq(response, token[index], P_PAYLOAD) == 0 && token[index + 1].type == JSMN_OBJECT) {
-        index++;
-        Serial.print(F("payload: "));
-        print_token(response, token[index]);
-
-        // extract payload from json
-        uint8_t tmp_payload_length = (uint8_t) (token[index].end - token[index].start);
-        // allocate the temporary payload on the stack, we will copy it to heap after freeing some space
-        tmp_payload = (char *) alloca((size_t) (16 + tmp_payload_length));
-        sim800h.IMEI(tmp_payload);
-        strncpy(tmp_payload + 15, response + token[index].start, tmp_payload_length);
-        tmp_payload[15 + tmp_payload_length] = '\0';
-
-        index += 2 * token[index].size;
-      } else {
-        // simply ignore unknown keys
-        Serial.print(F("unknown key: "));
-        print_token(response, token[index]);
-        index++;
-      }
-    }
-  } else {
-    error_flag |= E_JSON_FAILED;
-  }
-
-  // free used heap, the token and the no longer used response
-  free(token);
-  free(response);
-
-  // copy the locally (stack) allocated payload and signature to heap
-  if(tmp_payload != NULL && tmp_signature != NULL) {
-    payload = strdup(tmp_payload);
-    signature = (char *) malloc(crypto_hash_BYTES);
-    memcpy(signature , tmp_signature, crypto_hash_BYTES);
+static void set_locate(bool requested) {
+  if (requested) {
+    LOG_INFO("location requested");
+    location_cache_request(&location_cache);
   }
 }
 
-/*!
- * Verify payload using the given signature.
- *
- * @param payload the json payload to check (including prepended key!)
- * @param signature the signature for verification
- * @return true if the verification was successful
- */
-bool verify_payload(const char *payload, const char *signature) {
-  // don't even start if we get NULLs
-  if (payload == NULL || signature == NULL) return false;
-
-  // first verify the payload signature
-  // required ram for signature verification: (PAYLOAD + IMEI) + SHA512 + HASH SIZE
-  const int required_ram = (strlen(payload) + 1) + 669 + crypto_hash_BYTES;
-  const int free_sram = query_free_sram();
-
-  Serial.print(F("payload verification: "));
-  Serial.print(free_sram);
-  Serial.print(F(" byte free ("));
-  Serial.print(required_ram);
-  Serial.println(F(" byte required)"));
-
-  bool signature_verified = false;
-  if (required_ram < free_sram) {
-
-    // hash payload and check whether it matches the signature hash
-    char *payload_hash = (char *) malloc(crypto_hash_BYTES);
-
-    crypto_hash_sha512((unsigned char *) payload_hash, (const unsigned char *) payload, strlen(payload));
-    print_hash(payload_hash);
-    print_hash(signature);
-
-    signature_verified = !memcmp(signature, payload_hash, crypto_hash_BYTES);
-    if (!signature_verified) error_flag |= E_SIG_VRFY_FAIL;
-
-    // free the payload hash
-    free(payload_hash);
-  } else {
-    Serial.println(F("payload too large, may crash..."));
-    error_flag |= E_NO_MEMORY;
-  }
-
-  return signature_verified;
-}
+// the payload keys we understand
+static const protocol_field_t payload_fields[] PROGMEM = {
+  {protocol_key(P_SENSITIVITY), set_sensitivity},
+  {protocol_key(P_IR_FILTER), set_infrared_filter},
+  {protocol_key(P_INTERVAL), set_interval},
+  {protocol_key(P_LOCATE), set_locate},
+  {protocol_key(P_POLICY), protocol_read_policy}
+};
 
 /*!
  * Process payload and set configuration parameters from it.
  * @param payload the payload to use, should be checked
  */
-void process_payload(char *payload) {
-  jsmntok_t *token;
-  jsmn_parser parser;
-  jsmn_init(&parser);
-
-  // identify the number of tokens in our response, we expect 13
-  const uint8_t token_count = (const uint8_t) jsmn_parse(&parser, payload, strlen(payload), NULL, 0);
-  token = (jsmntok_t *) malloc(sizeof(*token) * token_count);
-
-  // reset parser, parse and store tokens
-  jsmn_init(&parser);
-  if (jsmn_parse(&parser, payload, strlen(payload), token, token_count) == token_count &&
-      token[0].type == JSMN_OBJECT) {
-    uint8_t index = 0;
-    while (++index < token_count) {
-      if (jsoneq(payload, token[index], P_SENSITIVITY) == 0 && token[index + 1].type == JSMN_PRIMITIVE) {
-        index++;
-        Serial.print(F("sensitivity: "));
-        if (*(payload + token[index].start) - '0') {
-          Serial.println(F("10K lux"));
-          sensitivity = ISL_MODE_10KLUX;
-        } else {
-          Serial.println(F("375 lux"));
-          sensitivity = ISL_MODE_375LUX;
-        }
-      } else if (jsoneq(payload, token[index], P_IR_FILTER) == 0 && token[index + 1].type == JSMN_PRIMITIVE) {
-        index++;
-        Serial.print(F("infrared filter: 0x"));
-        infrared_filter = to_uint(payload + token[index].start,
-                                  (size_t) token[index].end - token[index].start);
-        Serial.println(infrared_filter, 16);
-      } else if (jsoneq(payload, token[index], P_INTERVAL) == 0 && token[index + 1].type == JSMN_PRIMITIVE) {
-        index++;
-        Serial.print(F("Interval: "));
-        interval = to_uint(payload + token[index].start, (size_t) token[index].end - token[index].start);
-        Serial.print(interval);
-        Serial.println(F("s"));
-      } else {
-        Serial.print(F("unknown payload key: "));
-        print_token(payload, token[index]);
-        index++;
-      }
-    }
-  } else {
-    error_flag |= E_JSON_FAILED;
-  }
-
-  free(token);
+void process_payload(const char *payload) {
+  protocol_process_payload(payload, payload_fields, sizeof(payload_fields) / sizeof(payload_fields[0]), error_flag);
 }
 
 /*!
@@ -301,19 +328,19 @@ bool sample_rgb(uint16_t &red, uint16_t &green, uint16_t &blue) {
   i2c_init(I2C_SPEED_400KHZ);
 
   if (!isl_reset()) {
-    Serial.println(F("ISL29125 reset failed"));
+    LOG_ERROR("ISL29125 reset failed");
     error_flag |= E_SENSOR_FAILED;
     return false;
   }
   // we need to set the filter first, then as sampling starts with the 0x01 (COLOR_MODE) register
   if (!isl_set(ISL_R_FILTERING, infrared_filter)) {
-    Serial.println(F("ISL29125 set infrared filtering failed"));
+    LOG_ERROR("ISL29125 set infrared filtering failed");
     error_flag |= E_SENSOR_FAILED;
     return false;
   }
   // set sensitivity and color mode and start sampling
   if (!isl_set(ISL_R_COLOR_MODE, sensitivity | ISL_MODE_16BIT | ISL_MODE_RGB)) {
-    Serial.println(F("ISL29125 ir config failed"));
+    LOG_ERROR("ISL29125 ir config failed");
     error_flag |= E_SENSOR_FAILED;
     return false;
   }
@@ -327,6 +354,10 @@ bool sample_rgb(uint16_t &red, uint16_t &green, uint16_t &blue) {
   green = isl_read_green();
   blue = isl_read_blue();
 
+  // the low bits of the readings are sensor noise
+  const uint16_t rgb[3] = {red, green, blue};
+  entropy_add(rgb, sizeof(rgb));
+
   // power down the RGB sensor chip
   isl_set(ISL_R_COLOR_MODE, ISL_MODE_POWERDOWN);
 
@@ -334,16 +365,56 @@ bool sample_rgb(uint16_t &red, uint16_t &green, uint16_t &blue) {
 }
 
 /*!
- * Send samples sensor data to the backend. The payload message will be signed
- * using a board specific key.
+ * Read the battery status from the modem.
  */
-void send_sensor_data() {
-  uint16_t red = 0, green = 0, blue = 0;
-  uint16_t bat_status = 0, bat_percent = 0, bat_voltage = 0;
-  char *lat = NULL, *lon = NULL, *date = NULL, *time = NULL;
-  char *payload, *payload_hash, *auth_hash;
-  char *signature, *message;
+static bool read_battery(sim800_battery_t &battery) {
+  return sim800_battery(&battery);
+}
 
+/*!
+ * Read the approximate GSM location and network time into fixed point values,
+ * the response is parsed while it arrives.
+ */
+static bool read_location(sim800_location_t &location) {
+  return sim800_location(&location);
+}
+
+/*!
+ * Query the location only if the cache needs a refresh: every LOCATION_REFRESH
+ * cycles, if the serving cell changed or if the backend
+ * asked for it.
+ */
+static void update_location() {
+  sim800_location_t location;
+  sim800_cell_t cell;
+  const sim800_cell_t *current = sim800_cell(&cell) ? &cell : NULL;
+
+  // unless the backend asks for it, the location is dropped if the battery runs low
+  if (!(policy_current()->features & POLICY_LOCATION) && !(location_cache.flags & LOCATION_REQUESTED)) return;
+  if (!location_cache_due(&location_cache, current, LOCATION_REFRESH)) return;
+  probe_start(PROBE_LOCATION);
+  bool found = read_location(location);
+  probe_stop(PROBE_LOCATION);
+  if (found) {
+    if (location_cache_update(&location_cache, &location, current)) LOG_INFO("new location >>> %lu", location.time);
+    else LOG_DEBUG(">>> %lu", location.time);
+    // the location reply carries the network time (UTC)
+    walltime_set(location.time);
+  }
+}
+
+/*!
+ * Take the network time from the modem clock (NITZ), if the network sends it.
+ */
+static void sync_time() {
+  uint32_t now;
+  if (sim800_time(&now)) walltime_set(now);
+}
+
+/*!
+ * Sample the RGB sensor and adjust the sensitivity to the brightness.
+ */
+static void sample_compensated(uint16_t &red, uint16_t &green, uint16_t &blue) {
   // do an initial sampling
   sample_rgb(red, green, blue);
 
@@ -356,150 +427,351 @@ void send_sensor_data() {
     sample_rgb(red, green, blue);
   }
 
-  Serial.print(F("RGB: "));
-  if (sensitivity == ISL_MODE_375LUX) Serial.print(F("375LUX:"));
-  else Serial.print(F("10kLUX:"));
-  Serial.print(red);
-  Serial.print(F(":"));
-  Serial.print(green);
-  Serial.print(F(":"));
-  Serial.println(blue);
-
-  // read battery status
-  sim800h.battery(bat_status, bat_percent, bat_voltage);
-  // read GSM approx. location
-  if (sim800h.location(lat, lon, date, time)) {
-    Serial.print(F(">>> "));
-    Serial.print(date);
-    Serial.print(F(" "));
-    Serial.println(time);
+  LOG_INFO("RGB: %uLUX:%u:%u:%u", sensitivity == ISL_MODE_375LUX ? 375 : 10000, red, green, blue);
+}
+
+/*!
+ * Send samples sensor data to the backend. The payload message will be signed
+ * using a board specific key.
+ *
+ * @param battery the battery status read this cycle
+ */
+void send_sensor_data(const sim800_battery_t &battery) {
+  uint16_t red = 0, green = 0, blue = 0;
+  char imei[IMEI_LEN + 1];
+  char *payload, *signature = NULL, *message;
+  unsigned char *hashes;
+
+  sync_time();
+  probe_start(PROBE_SENSOR);
+  sample_compensated(red, green, blue);
+  probe_stop(PROBE_SENSOR);
+  uint32_t sampled = walltime_now();
+
+  // refresh the GSM approx. location if necessary
+  update_location();
+
+  // all buffers of this upload are released at the end
+  const arena_mark_t mark = arena_mark();
+
+  // the message is assembled in place: the payload is written to its end with the IMEI (key)
+  // in front of it for hashing, the envelope and the hashes are filled in afterwards
+  message = (char *) arena_alloc(MESSAGE_SIZE);
+  hashes = (unsigned char *) arena_alloc(UPLOAD_HASH_BYTES);
+  if (message == NULL || hashes == NULL) {
+    LOG_ERROR("out of memory");
+    error_flag |= E_NO_MEMORY;
+    arena_release(mark);
+    return;
   }
+#ifdef UPLINK_BOX
+  // the payload structure is written into the box after its zero bytes
+  memset(hashes, 0, UPLINK_BOX_ZEROBYTES);
+  payload = (char *) hashes + UPLINK_BOX_ZEROBYTES;
+#else
+  payload = message + MESSAGE_HEAD - IMEI_LEN;
+#endif
 
-  // read device IMEI, which is our key
-  payload = (char *) malloc(128);
-  if (sim800h.IMEI(payload)) {
-    Serial.print(F("authorization: "));
-    Serial.println(payload);
+  // read device IMEI, which is our key, it is kept to verify the response
+  if (sim800_imei(imei)) {
+    LOG_DEBUG("authorization: %s", imei);
+    memcpy(payload, imei, IMEI_LEN);
+    // the IMEI makes the random pool differ between devices, even before the first seed
+    static bool imei_added = false;
+    if (!imei_added) entropy_add(imei, IMEI_LEN);
+    imei_added = true;
   } else {
-    Serial.println(F("IMEI not found, can't send"));
-    free(payload);
-    free(lat);
-    free(lon);
-    free(date);
-    free(time);
+    LOG_ERROR("IMEI not found, can't send");
+    arena_release(mark);
     return;
   }
 
   // hashed payload structure IMEI{DATA}
-  // Example: '123456789012345{"r":44,"g":33,"b":22,"s":0,"lat":"12.475886","lon":"51.505264","bat":100,"lps":99999}'
+  // Example: '123456789012345{"r":44,"g":33,"b":22,"s":0,"ba":100,"lp":99999,"e":0,"la":"12.475886","lo":"51.505264"}'
   sprintf_P(payload + 15,
-            PSTR("{\"r\":%u,\"g\":%u,\"b\":%u,\"s\":%1u,\"la\":\"%s\",\"lo\":\"%s\",\"ba\":%u,\"lp\":%u,\"e\":%u}"),
+            PSTR("{\"r\":%u,\"g\":%u,\"b\":%u,\"s\":%1u,\"ba\":%u,\"lp\":%u,\"e\":%u"),
             red, green, blue, sensitivity == ISL_MODE_375LUX ? 0 : 1,
-            lat == NULL ? "" : lat, lon == NULL ? "" : lon,
-            bat_percent, loop_counter, error_flag);
+            battery.percent, loop_counter, error_flag);
+  // the battery policy in use
+  sprintf_P(payload + strlen(payload), PSTR(",\"pl\":%u"), policy_level());
+  // the message buffer high-water mark
+  sprintf_P(payload + strlen(payload), PSTR(",\"hw\":%u"), arena_peak());
+  // the samples taken since the last upload and their age in seconds
+  if (batch_count) {
+    const uint32_t now = sched_now();
+    strcat_P(payload, PSTR(",\"h\":["));
+    for (uint8_t i = 0; i < batch_count; i++) {
+      const uint32_t age = (now - batch[i].taken) / 1000;
+      sprintf_P(payload + strlen(payload), i ? PSTR(",[%u,%u,%u,%u,%u]") : PSTR("[%u,%u,%u,%u,%u]"),
+                batch[i].red, batch[i].green, batch[i].blue, batch[i].sensitivity,
+                (unsigned int) (age > 65535 ? 65535 : age));
+    }
+    strcat_P(payload, PSTR("]"));
+  }
+  // the location is only sent if it changed
+  if (location_cache_changed(&location_cache)) {
+    char lat[AT_FIXED6_STRLEN], lon[AT_FIXED6_STRLEN];
+    sprintf_P(payload + strlen(payload), PSTR(",\"la\":\"%s\",\"lo\":\"%s\""),
+              at_fixed6_str(lat, location_cache.fix.lat), at_fixed6_str(lon, location_cache.fix.lon));
+  }
+  // the sampling time (unix time, UTC), if the network time is known
+  if (sampled) sprintf_P(payload + strlen(payload), PSTR(",\"ts\":%lu"), sampled + WALLTIME_UNIX_OFFSET);
+#ifdef SIM800_HW_UART
+  // report the negotiated modem baud rate, so we can compare sites
+  sprintf_P(payload + strlen(payload), PSTR(",\"br\":%lu"), (unsigned long) sim800_baud_stats()->baud);
+#endif
+#ifdef PROBE_REPORT
+  // where the awake time goes, average and longest phase durations
+  probe_json(payload + strlen(payload));
+#endif
+#ifdef MEMORY_REPORT
+  // stack high-water mark and heap fragmentation
+  heap_stats_t heap;
+  query_heap_stats(&heap);
+  sprintf_P(payload + strlen(payload), PSTR(",\"sk\":%u,\"hf\":%u,\"hl\":%u"),
+            query_stack_peak(), heap.blocks, heap.largest);
+#endif
+  strcat_P(payload, PSTR("}"));
   error_flag = 0;
 
-  // free latitude and longitude
-  free(lat);
-  free(lon);
-  free(date);
-  free(time);
-
-  // create hashes from the payload structure as well as the IMEI (key), sig buffer is used twice!
-  signature = (char *) malloc(crypto_hash_BYTES);
-
-  payload_hash = (char *) malloc(89);
-  crypto_hash((unsigned char *) signature, (const unsigned char *) payload, strlen(payload));
-  base64_encode(payload_hash, signature, crypto_hash_BYTES);
-
-  auth_hash = (char *) malloc(89);
-  Serial.print(F("payload hash: "));
-  Serial.println(payload_hash);
-
-  crypto_hash((unsigned char *) signature, (const unsigned char *) payload, 15);
-  base64_encode(auth_hash, signature, crypto_hash_BYTES);
-
-  // free signature buffer
-  free(signature);
-  signature = NULL;
-
-  Serial.print(F("auth hash   : "));
-  Serial.println(auth_hash);
+#ifdef UPLINK_HMAC
+  // authenticate the payload structure with the device key
+  probe_start(PROBE_HASH);
+  if (!protocol_authenticate(hashes, payload)) {
+    probe_stop(PROBE_HASH);
+    LOG_ERROR("no device key, can't send");
+    arena_release(mark);
+    return;
+  }
 
-  // finally, compile the message
-  message = (char *) malloc(300);
-  sprintf_P(message,
-            PSTR("{\"v\":\"0.0.1\",\"a\":\"%s\",\"s\":\"%s\",\"p\":%s}"),
-            auth_hash, payload_hash, payload + 15);
+  // fill in the envelope in front of the payload, this overwrites the IMEI
+  protocol_envelope_hmac(message, imei, hashes);
+#elif defined(UPLINK_BOX)
+  // encrypt the payload structure in place, it costs no Curve25519 operation
+  probe_start(PROBE_HASH);
+  const uint16_t box_length = (uint16_t) (UPLINK_BOX_ZEROBYTES + strlen(payload));
+  uint32_t counter;
+  if (!uplink_box_seal(hashes, hashes, box_length, &counter)) {
+    probe_stop(PROBE_HASH);
+    LOG_ERROR("no shared key or nonce, can't send");
+    arena_release(mark);
+    return;
+  }
 
-  // free payload and hashes
-  free(payload);
+  // the envelope is written into the message buffer, the box is sent without its zero bytes
+  protocol_envelope_box(message, imei, uplink_box_prefix(), counter, hashes + UPLINK_BOX_BOXZEROBYTES,
+                        box_length - UPLINK_BOX_BOXZEROBYTES);
+#else
+  // create hashes from the payload structure as well as the IMEI (key)
+  probe_start(PROBE_HASH);
+  crypto_hash(hashes, (const unsigned char *) payload, strlen(payload));
+  crypto_hash(hashes + crypto_hash_BYTES, (const unsigned char *) payload, IMEI_LEN);
+
+  // fill in the envelope in front of the payload, this overwrites the IMEI
+  strcpy_P(message, PSTR("{\"v\":\"0.0.1\",\"a\":\""));
+  base64_encode(message + strlen(message), (char *) hashes + crypto_hash_BYTES, crypto_hash_BYTES);
+  strcat_P(message, PSTR("\",\"s\":\""));
+  base64_encode(message + strlen(message), (char *) hashes, crypto_hash_BYTES);
+  memcpy_P(message + strlen(message), PSTR("\",\"p\":"), 6);
+  strcat_P(message, PSTR("}"));
+#endif
   payload = NULL;
-  free(payload_hash);
-  free(auth_hash);
+  probe_stop(PROBE_HASH);
 
-  Serial.print(F("message: '"));
-  Serial.print(message);
-  Serial.println(F("'"));
-  Serial.println(strlen(message));
+  LOG_DEBUG("message: '%s' (%u)", message, strlen(message));
 
   // send the request
   unsigned long response_length;
   unsigned int http_status;
+  probe_start(PROBE_HTTP);
   http_status = sim800h.HTTP_post(PUSH_URL, response_length, message, strlen(message));
-  // free message after it's been sent
-  free(message);
+  // release message and hashes after it's been sent
+  arena_release(mark);
+  message = NULL;
 
-  Serial.print(http_status);
-  Serial.print(F(" ("));
-  Serial.print(response_length);
-  Serial.println(F(")"));
+  LOG_INFO("%u (%lu)", http_status, response_length);
 
   if (http_status != 200) {
-    Serial.println(F("HTTP POST failed"));
+    probe_stop(PROBE_HTTP);
+    LOG_WARN("HTTP POST failed");
   } else {
-    if (response_length < 300) {
-      char *response = (char *) malloc((size_t) response_length + 1);
+    // the backend has the location and the batched samples now
+    location_cache_reported(&location_cache);
+    batch_count = 0;
+#ifdef PROBE_REPORT
+    // and the phase statistics, start over
+    probe_reset();
+#endif
+
+    if (response_length <= RESPONSE.length) {
+      char *response = (char *) arena_alloc((size_t) response_length + 1);
+      if (response == NULL) {
+        probe_stop(PROBE_HTTP);
+        LOG_ERROR("out of memory");
+        error_flag |= E_NO_MEMORY;
+        return;
+      }
       response[response_length] = '\0';
 
+#ifdef SIM800_HW_UART
+      // the interrupt driven UART buffers everything, read the response in one go
+      sim800h.HTTP_read(response, 0, (size_t) response_length);
+#else
+      uint32_t pos = 0;
       // we need to read the response in little chunks, else the
       // software serial will just return trash, omissions etc.
-      uint32_t pos = 0;
       do pos += sim800h.HTTP_read(response + pos, pos, SIM800_BUFSIZE); while (pos < response_length);
+#endif
+      probe_stop(PROBE_HTTP);
 
-      Serial.print(F("RESPONSE: '"));
-      Serial.print(response);
-      Serial.println(F("'"));
+      LOG_DEBUG("RESPONSE: '%s'", response);
 
       // process response, extract payload and signature
-      process_response(response, payload, signature);
+      probe_start(PROBE_RESPONSE);
+      protocol_process_response(response, imei, payload, signature, error_flag);
       // verify and process payload
-      if (verify_payload(payload, signature)) {
-        Serial.println(F("signature verified OK"));
-        process_payload(payload + 15);
+      if (protocol_verify_payload(payload, signature, error_flag)) {
+        LOG_INFO("signature verified OK");
+        process_payload(payload + IMEI_LEN);
       } else {
-        Serial.println(F("signature failed to verify"));
+        LOG_WARN("signature failed to verify");
       }
-      free(signature);
-      free(payload);
+      arena_release(mark);
+      probe_stop(PROBE_RESPONSE);
 
     } else {
-      Serial.print(F("HTTP RESPONSE too long: "));
-      Serial.println(response_length);
+      probe_stop(PROBE_HTTP);
+      LOG_WARN("HTTP RESPONSE too long: %lu", response_length);
     }
   }
 }
 
+#ifdef SMS_FALLBACK
+/*!
+ * Send the sensor data by SMS if GPRS is not available. Samples are collected
+ * until SMS_RECORDS are available and then sent as a single binary message to
+ * SMS_GATEWAY. If sending fails the oldest sample is dropped.
+ *
+ * @param battery the battery status read this cycle
+ */
+void send_sensor_sms(const sim800_battery_t &battery) {
+  uint16_t red = 0, green = 0, blue = 0;
+  uint8_t buffer[SMS_IMEI_LENGTH + SMS_UD_MAX];
+
+  sync_time();
+  probe_start(PROBE_SENSOR);
+  sample_compensated(red, green, blue);
+  probe_stop(PROBE_SENSOR);
+
+  if (sms_record_count == SMS_RECORDS) {
+    memmove(sms_records, sms_records + 1, sizeof(sms_records[0]) * (SMS_RECORDS - 1));
+    sms_record_count--;
+  }
+
+  // the location query needs the GPRS bearer, use the last cached fix
+  sms_sensor_record_t &record = sms_records[sms_record_count++];
+  record.loop = loop_counter;
+  record.time = walltime_now();
+  record.red = red;
+  record.green = green;
+  record.blue = blue;
+  record.flags = (uint8_t) (sensitivity == ISL_MODE_375LUX ? 0 : SMS_FLAG_10KLUX);
+  record.battery = (uint8_t) battery.percent;
+  record.error = error_flag;
+  if (location_cache.flags & LOCATION_VALID) {
+    record.lat = location_cache.fix.lat;
+    record.lon = location_cache.fix.lon;
+  } else {
+    record.lat = record.lon = SMS_NO_LOCATION;
+  }
+
+  if (sms_record_count < SMS_RECORDS) return;
+
+  if (!sim800_imei((char *) buffer)) {
+    LOG_ERROR("IMEI not found, can't send");
+    return;
+  }
+
+  uint8_t length = sms_pack_sensor(buffer, sms_records, sms_record_count);
+  if (!length) {
+    LOG_ERROR("no device key, can't send SMS");
+    return;
+  }
+  LOG_INFO("SMS: %u byte", length);
+
+  if (sim800_sms_send(SMS_GATEWAY, buffer + SMS_IMEI_LENGTH, length)) {
+    sms_record_count = 0;
+  } else {
+    LOG_WARN("SMS failed");
+  }
+}
+#endif
+
+/*!
+ * Restore the last configuration and the loop counter from EEPROM, so the
+ * device does not need a network round-trip after a reset.
+ */
+static void load_config() {
+  store_init();
+  sensor_config_t config;
+  if (store_load(STORE_CONFIG, &config, sizeof(config))) {
+    interval = config.interval;
+    sensitivity = config.sensitivity;
+    infrared_filter = config.infrared_filter;
+  }
+  store_load(STORE_COUNTER, &loop_counter, sizeof(loop_counter));
+}
+
+/*!
+ * Save the configuration and the loop counter, only changes are written.
+ */
+static void save_config() {
+  sensor_config_t config = {interval, sensitivity, infrared_filter};
+  store_save(STORE_CONFIG, &config, sizeof(config));
+  store_save(STORE_COUNTER, &loop_counter, sizeof(loop_counter));
+}
+
+#ifdef MODEM_STANDBY
+/*!
+ * RI interrupt. The low level wakes the MCU from power down as well, so the interrupt
+ * is detached until the next cycle is done.
+ */
+static void ring() {
+  detachInterrupt(digitalPinToInterrupt(SIM800_RI));
+  sched_post(EVENT_RING);
+}
+#endif
+
+/*!
+ * A call, SMS or unsolicited output of the modem asks for an update, run the cycle now.
+ */
+static void on_event(uint8_t event) {
+  LOG_INFO("event %u", event);
+  // upload even if only a sample is due
+  upload_requested = true;
+  sched_delay(cycle_task, 0);
+}
+
 /*!
  * Initial setup.
  */
 void setup() {
-  Serial.begin(115200);
-  Serial.println();
+  DEBUG_SERIAL.begin(DEBUG_BAUD);
+  log_init(DEBUG_SERIAL);
 
   pinMode(LED, OUTPUT);
   pinMode(WATCHDOG, INPUT);
 
+  // phase timing (Timer1), must be started before the watchdog calibration borrows the timer
+  probe_init();
+  // calibrates the watchdog, so all following sleeps are accurate
+  sched_init(on_event);
+  // boot into the last known configuration
+  load_config();
+  // the random pool (randombytes) from the seed in EEPROM and fresh noise, borrows Timer1 as well
+  entropy_init();
+  arena_init(arena_buffer, sizeof(arena_buffer));
+
   digitalWrite(LED, HIGH);
   sleep(1);
   digitalWrite(LED, LOW);
@@ -507,49 +779,190 @@ void setup() {
 
   // edit APN settings in config.h
   sim800h.setAPN(F(FONA_APN), F(FONA_USER), F(FONA_PASS));
+
+  location_cache_init(&location_cache);
+  policy_init(default_policy, sizeof(default_policy) / sizeof(default_policy[0]));
+
+#ifdef UPLINK_KEY
+  // store the device key, the EEPROM is only written if it changed
+  {
+    const uint8_t key[UPLINK_KEY_BYTES] = {UPLINK_KEY};
+    if (!uplink_key_provision(key)) LOG_ERROR("device key not stored");
+  }
+#endif
+#ifdef UPLINK_BOX_SECRET
+  // store the key shared with the backend, only computed if the keys changed (one Curve25519 operation)
+  {
+    const uint8_t secret_key[UPLINK_BOX_KEYBYTES] = {UPLINK_BOX_SECRET};
+    const uint8_t peer_key[UPLINK_BOX_KEYBYTES] = {UPLINK_BOX_PEER};
+    if (!uplink_box_provision(secret_key, peer_key)) LOG_ERROR("shared key not stored");
+  }
+#endif
+#ifdef UPLINK_BOX
+  if (!uplink_box_init()) LOG_ERROR("no shared key");
+#endif
+
+#ifdef SIM800_HW_UART
+  // start with the last negotiated modem baud rate
+  sim800_serial.begin(sim800_baud_load());
+#else
+  sim800_serial.begin(SIM800_SOFT_BAUD);
+#endif
+
+  cycle_task = sched_add(cycle, 0, cycle_interval() * 1000UL);
 }
 
 /*!
- * Main loop. Initialized the mobile network initiates the
- * RGB data sending. Will sleep a set amount of seconds before
- * it finishes.
+ * Sample the sensor without uploading, the sample is sent with the next upload.
+ * If the batch is full the oldest sample is dropped.
  */
-void loop() {
+static void sample_batch() {
+  uint16_t red = 0, green = 0, blue = 0;
+
+  probe_start(PROBE_SENSOR);
+  sample_compensated(red, green, blue);
+  probe_stop(PROBE_SENSOR);
+
+  if (batch_count == sizeof(batch) / sizeof(batch[0])) {
+    memmove(batch, batch + 1, sizeof(batch[0]) * (batch_count - 1));
+    batch_count--;
+  }
+  batch_sample_t &sample = batch[batch_count++];
+  sample.taken = sched_now();
+  sample.red = red;
+  sample.green = green;
+  sample.blue = blue;
+  sample.sensitivity = (uint8_t) (sensitivity == ISL_MODE_375LUX ? 0 : 1);
+}
+
+/*!
+ * The cycle interval, the backend setting unless the battery policy requires a longer one.
+ */
+static uint16_t cycle_interval() {
+  const uint16_t minimum = policy_current()->interval;
+  return minimum > interval ? minimum : interval;
+}
+
+/*!
+ * Attach GPRS, measured as its own phase.
+ */
+static bool enable_gprs() {
+  probe_start(PROBE_GPRS);
+  bool attached = sim800h.enableGPRS();
+  probe_stop(PROBE_GPRS);
+  return attached;
+}
+
+/*!
+ * Measurement cycle. Initialized the mobile network initiates the
+ * RGB data sending. Runs every interval seconds.
+ */
+static void cycle() {
+  // nothing is left from the last cycle
+  arena_reset();
+
   digitalWrite(LED, HIGH);
   pinMode(WATCHDOG, INPUT);
 
-  // wake up the SIM800
-  if (sim800h.wakeup()) {
-    // try to connect and enable GPRS, send if successful
-    uint8_t tries;
-    for (tries = 2; tries > 0; tries--) {
-      if (sim800h.registerNetwork(60000) && sim800h.enableGPRS()) {
-        Serial.print(query_free_sram());
-        Serial.println(F(" byte free"));
-
-        send_sensor_data();
+  // between uploads only the sensor is sampled, the modem is not woken
+  if (!upload_requested && ++upload_skipped < policy_current()->upload) {
+    sample_batch();
+  } else {
+    upload_requested = false;
+    upload_skipped = 0;
+    // wake up the SIM800
+    probe_start(PROBE_WAKEUP);
+    bool awake = sim800h.wakeup();
+#ifdef SIM800_HW_UART
+    // the modem keeps its stored rate, find it if ours differs (e.g. the EEPROM was erased)
+    if (!awake && sim800_baud_detect()) awake = sim800h.wakeup();
+#endif
+    probe_stop(PROBE_WAKEUP);
+    if (awake) {
+      // the battery decides how this and the next cycles run
+      sim800_battery_t battery = {0, 0, 0};
+      if (read_battery(battery)) policy_update((uint8_t) battery.percent);
+
+#ifdef SIM800_HW_UART
+      // negotiate the fastest reliable modem link once, then keep checking it
+      static bool baud_negotiated = false;
+      if (!baud_negotiated) baud_negotiated = sim800_baud_negotiate() != 0;
+      else sim800_baud_check();
+#endif
 
-        Serial.print(query_free_sram());
-        Serial.println(F(" byte free"));
+      // try to connect and enable GPRS, send if successful
+      bool registered = false;
+      uint8_t tries;
+      for (tries = 2; tries > 0; tries--) {
+        probe_start(PROBE_REGISTER);
+        bool registered_now = sim800h.registerNetwork(60000);
+        probe_stop(PROBE_REGISTER);
+        registered |= registered_now;
+        if (registered_now && enable_gprs()) {
+          LOG_DEBUG("%d byte free", query_free_sram());
+          send_sensor_data(battery);
+          LOG_DEBUG("%d byte free", query_free_sram());
 
-        break;
+          break;
+        }
+        LOG_WARN("mobile network failed");
+      }
+      if (tries == 0) {
+        error_flag |= E_NO_CONNECTION;
+#ifdef SMS_FALLBACK
+        // GSM works, but GPRS does not, fall back to SMS
+        if (registered && (policy_current()->features & POLICY_SMS)) send_sensor_sms(battery);
+#endif
       }
-      Serial.println();
-      Serial.println(F("mobile network failed"));
     }
-    if (tries == 0) error_flag |= E_NO_CONNECTION;
+#ifdef MODEM_STANDBY
+    // stay reachable, the modem wakes us with RI
+    modem_standby = awake && sim800h.standby();
+    if (!modem_standby) sim800h.shutdown();
+#else
+    sim800h.shutdown();
+#endif
   }
-  sim800h.shutdown();
 
   pinMode(WATCHDOG, OUTPUT);
   digitalWrite(LED, LOW);
   loop_counter++;
+  save_config();
+  if (loop_counter % ENTROPY_SAVE_CYCLES == 0) entropy_save();
+
+  // start the next cycle on the wall clock boundary (e.g. every full 5 minutes) if the time is
+  // known, else relative to the start of this one; the backend or the battery policy may have
+  // changed the interval
+  const uint16_t next = cycle_interval();
+  sched_period(cycle_task, next * 1000UL);
+  if (walltime_valid()) sched_delay(cycle_task, walltime_until(next));
+
+#if LOG_LEVEL >= LOG_LEVEL_DEBUG
+  char probes[PROBE_JSON_LEN];
+  LOG_DEBUG("phases%s", probe_json(probes));
+
+  heap_stats_t heap;
+  query_heap_stats(&heap);
+  LOG_DEBUG("arena peak %u, stack peak %u, heap %u free blocks, largest %u",
+            arena_peak(), query_stack_peak(), heap.blocks, heap.largest);
+#endif
 
-  Serial.print(F("sleeping for "));
-  Serial.print(interval);
-  Serial.println(F("s"));
+  LOG_INFO("policy %u, trend %d%%/d, interval %us", policy_level(), policy_trend(), next);
   delay(100);
 
-  // sleep interval seconds (put MCU in low power mode)
-  sleep(interval);
+#ifdef MODEM_STANDBY
+  // listen to the modem until the next cycle, the rest of the last response is dropped
+  if (modem_standby) {
+    uart_clear();
+    uart_notify(EVENT_MODEM);
+    attachInterrupt(digitalPinToInterrupt(SIM800_RI), ring, LOW);
+  }
+#endif
+}
+
+/*!
+ * Main loop. Runs the cycle task and sleeps (MCU in low power mode) in between.
+ */
+void loop() {
+  sched_run();
 }
@@ -0,0 +1,242 @@
+/**
+ * Cycles and stack of the response handling, run by the bench target in simavr.
+ *
+ * Each step of a cycle's response handling (protocol_process_response(),
+ * protocol_verify_payload() and protocol_process_payload()) and the base64
+ * encoding and decoding of a signature is run NRUNS times on canned input.
+ * The results are printed like the avrnacl speed and stack programs:
+ *
+ *   protocol_verify_payload: [145] 94716 94716 ...
+ *   protocol_verify_payload: [145] 412 stack bytes
+ *
+ * The length is that of the response or the base64 input. tools/avr-bench.py
+ * collects the output into bench.json. Timer1 counts the CPU cycles, Timer0
+ * (millis) is stopped so it does not add to the results.
+ *
+ * Copyright 2016 ubirch GmbH (http://www.ubirch.com)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "../libraries/arduino-base64/Base64.h"
+
+#include <string.h>
+#include <avr/pgmspace.h>
+#include <avr/interrupt.h>
+#include <avr/sleep.h>
+#include <jsmn.h>
+#include <ubirch_protocol.h>
+#include <freeram.h>
+#include <arena.h>
+
+#ifndef BAUD
+#   define BAUD 9600
+#endif
+
+#define NRUNS 10
+
+// the device key the canned responses are signed for
+#define KEY "351456789012345"
+
+// payload keys, the same as the lamp
+#define P_INTERVAL "i"
+#define P_LOCATE "l"
+#define P_RED "r"
+#define P_GREEN "g"
+#define P_BLUE "b"
+#define P_BLINK "bf"
+#define P_PIXEL_TYPE "t"
+
+// canned responses, the signature is the base64 encoded SHA512 of KEY{PAYLOAD}
+static const char response_short[] PROGMEM =
+  "{\"v\":\"0.0.2\",\"s\":\"p86TLgDLq0SvDTooNm4dC24MDtIqL43oGWMcK4lFurbM8ZFTtdR4NXdrYgPePzyUg6GM1HsAkjPm9l2nHhhFdg==\","
+    "\"p\":{\"i\":1800,\"r\":255,\"g\":128,\"b\":0}}";
+static const char response_long[] PROGMEM =
+  "{\"v\":\"0.0.2\",\"s\":\"4Gm2Q2/pnYaGPynYWvpB1ACqF8XWutT5g5Tc4DCMPERUlBSipmRSXpFRq+45pOh37K5nIRpbNTVooUSBDay7Ow==\","
+    "\"p\":{\"i\":1800,\"r\":255,\"g\":128,\"b\":0,\"bf\":1,\"t\":2,\"l\":1,\"xx\":\"unknown keys are skipped\","
+    "\"yy\":[1,2,3,[4,5,6]],\"zz\":{\"a\":1,\"b\":2}}}";
+
+static volatile uint16_t interval;
+static volatile uint8_t red, green, blue, pixel_type;
+static volatile bool blink, locate;
+
+static void set_interval(uint16_t value) { interval = value; }
+static void set_red(uint8_t value) { red = value; }
+static void set_green(uint8_t value) { green = value; }
+static void set_blue(uint8_t value) { blue = value; }
+static void set_pixel_type(uint8_t value) { pixel_type = value; }
+static void set_blink(bool value) { blink = value; }
+static void set_locate(bool value) { locate = value; }
+
+static const protocol_field_t payload_fields[] PROGMEM = {
+  {protocol_key(P_BLINK), set_blink},
+  {protocol_key(P_PIXEL_TYPE), set_pixel_type},
+  {protocol_key(P_RED), set_red},
+  {protocol_key(P_GREEN), set_green},
+  {protocol_key(P_BLUE), set_blue},
+  {protocol_key(P_INTERVAL), set_interval},
+  {protocol_key(P_LOCATE), set_locate},
+};
+
+static uint8_t arena_buffer[1024];
+
+// the results of one benchmark
+typedef struct {
+  uint32_t cycles[NRUNS];
+  uint16_t stack; // the deepest run
+} bench_t;
+
+// Timer1 overflows, the upper 16 bit of the cycle counter
+static volatile uint16_t overflows;
+
+ISR(TIMER1_OVF_vect) {
+  overflows++;
+}
+
+static uint32_t cycles() {
+  const uint8_t sreg = SREG;
+  cli();
+  const uint16_t low = TCNT1;
+  uint16_t high = overflows;
+  // an overflow that happened after cli() is still pending
+  if ((TIFR1 & _BV(TOV1)) && low < 0x8000) high++;
+  SREG = sreg;
+  return (uint32_t) high << 16 | low;
+}
+
+static uint16_t stack_depth;
+static uint32_t start;
+
+// measure the code between bench_start() and bench_stop(), they are inlined to keep the stack depth
+static inline void bench_start() __attribute__ ((always_inline));
+static inline void bench_start() {
+  stack_repaint();
+  stack_depth = (uint16_t) (RAMEND - SP);
+  start = cycles();
+}
+
+static inline void bench_stop(bench_t &bench, uint8_t run) __attribute__ ((always_inline));
+static inline void bench_stop(bench_t &bench, uint8_t run) {
+  bench.cycles[run] = cycles() - start;
+  const uint16_t used = query_stack_peak() - stack_depth;
+  if (used > bench.stack) bench.stack = used;
+}
+
+static void print_prefix(const __FlashStringHelper *name, uint16_t bytes) {
+  Serial.print(name);
+  Serial.print(F(": ["));
+  Serial.print(bytes);
+  Serial.print(F("] "));
+}
+
+static void print_results(const __FlashStringHelper *name, uint16_t bytes, const bench_t &bench) {
+  print_prefix(name, bytes);
+  for (uint8_t i = 0; i < NRUNS; i++) {
+    Serial.print(bench.cycles[i]);
+    Serial.print(' ');
+  }
+  Serial.println();
+  print_prefix(name, bytes);
+  Serial.print(bench.stack);
+  Serial.println(F(" stack bytes"));
+  Serial.flush();
+}
+
+static void fail(const __FlashStringHelper *error) {
+  Serial.print(F("ERROR: "));
+  Serial.println(error);
+}
+
+static void bench_response(const char *canned) {
+  const uint16_t length = (uint16_t) strlen_P(canned);
+  bench_t process_response = {}, verify_payload = {}, process_payload = {};
+
+  for (uint8_t run = 0; run < NRUNS; run++) {
+    uint8_t error_flag = 0;
+    char *payload = NULL, *signature = NULL;
+    arena_reset();
+    char *response = (char *) arena_alloc(length + 1);
+    strcpy_P(response, canned);
+
+    bench_start();
+    protocol_process_response(response, KEY, payload, signature, error_flag);
+    bench_stop(process_response, run);
+    if (payload == NULL || signature == NULL || error_flag) fail(F("protocol_process_response"));
+
+    bench_start();
+    const bool verified = protocol_verify_payload(payload, signature, error_flag);
+    bench_stop(verify_payload, run);
+    if (!verified) fail(F("protocol_verify_payload"));
+
+    interval = 0;
+    bench_start();
+    const bool processed = protocol_process_payload(payload + sizeof(KEY) - 1, payload_fields,
+                                                    sizeof(payload_fields) / sizeof(payload_fields[0]), error_flag);
+    bench_stop(process_payload, run);
+    if (!processed || interval != 1800) fail(F("protocol_process_payload"));
+  }
+  print_results(F("protocol_process_response"), length, process_response);
+  print_results(F("protocol_verify_payload"), length, verify_payload);
+  print_results(F("protocol_process_payload"), length, process_payload);
+}
+
+static void bench_base64(uint8_t length) {
+  char input[128], encoded[173], decoded[129];
+  bench_t encode = {}, decode = {};
+  for (uint8_t i = 0; i < length; i++) input[i] = (char) (i * 7);
+  const int encoded_length = base64_enc_len(length);
+
+  for (uint8_t run = 0; run < NRUNS; run++) {
+    bench_start();
+    base64_encode(encoded, input, length);
+    bench_stop(encode, run);
+  }
+  print_results(F("base64_encode"), length, encode);
+
+  for (uint8_t run = 0; run < NRUNS; run++) {
+    bench_start();
+    base64_decode(decoded, encoded, encoded_length);
+    bench_stop(decode, run);
+  }
+  if (memcmp(input, decoded, length)) fail(F("base64_decode"));
+  print_results(F("base64_decode"), (uint16_t) encoded_length, decode);
+}
+
+void setup() {
+  Serial.begin(BAUD);
+
+  // Timer1 counts CPU cycles, Timer0 (millis) would add its interrupt to the results
+  TIMSK0 = 0;
+  TCCR1A = 0;
+  TCCR1B = _BV(CS10);
+  TCNT1 = 0;
+  TIMSK1 = _BV(TOIE1);
+  sei();
+
+  arena_init(arena_buffer, sizeof(arena_buffer));
+
+  bench_response(response_short);
+  bench_response(response_long);
+  bench_base64(16);
+  bench_base64(64);
+  bench_base64(128);
+
+  // simavr quits on a sleep with interrupts disabled
+  Serial.flush();
+  cli();
+  sleep_enable();
+  sleep_cpu();
+}
+
+void loop() {
+}
@@ -0,0 +1,173 @@
+#!/usr/bin/env python3
+"""
+Run benchmark programs in simavr and compare the results of two builds.
+
+The programs print their results like the avrnacl speed and stack programs, one
+line per function and message length:
+
+  crypto_hash_sha512: [64] 98361 98361 98361 ...
+  crypto_hash_sha512: [64] 669 stack bytes
+
+The median of the cycles and the stack are collected into JSON (bench.json in the
+build directory, make bench), grouped by the name given to each program. Programs
+with the same name (the speed and stack programs of a primitive) are merged.
+
+usage: avr-bench.py run [--simavr <simavr>] [--mcu <mcu>] [--f-cpu <hz>] <name>=<elf> [...] > bench.json
+       avr-bench.py compare <old bench.json> <new bench.json> [<percent>]
+       avr-bench.py record [--simavr <simavr>] [--mcu <mcu>] [--f-cpu <hz>] <dir> <name>=<elf> [...]
+
+compare lists the results that changed by more than <percent> (default 1) and fails
+if any of them got worse.
+
+record writes the output of each program to <dir>/<name>.out (make nacl-test, the avrnacl
+test programs, checked by the host build of avrnacl).
+
+Copyright 2016 ubirch GmbH (http://www.ubirch.com)
+
+== LICENSE ==
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+"""
+
+import argparse
+import concurrent.futures
+import json
+import os
+import re
+import subprocess
+import sys
+
+# simavr may color the UART output
+ESCAPE = re.compile(r"\x1b\[[0-9;]*m")
+RESULT = re.compile(r"(\w+): (?:\[(\d+)\] )?([\d ]+?)( stack bytes)?\s*$")
+ERROR = re.compile(r"ERROR: .*")
+
+# the longest a program may run (Ed25519 takes a while in simulation)
+TIMEOUT = 3600
+
+
+def simulate(simavr, mcu, f_cpu, elf):
+    """@return the UART output of the program"""
+    try:
+        return subprocess.run([simavr, "-m", mcu, "-f", str(f_cpu), elf], stdout=subprocess.PIPE,
+                              stderr=subprocess.DEVNULL, timeout=TIMEOUT,
+                              universal_newlines=True, errors="replace").stdout
+    except subprocess.TimeoutExpired:
+        return "ERROR: timeout after %d s\n" % TIMEOUT
+
+
+def parse(output, results, errors, name):
+    for line in output.splitlines():
+        line = ESCAPE.sub("", line).strip()
+        error = ERROR.search(line)
+        if error:
+            errors.append("%s: %s" % (name, error.group(0)))
+            continue
+        match = RESULT.search(line)
+        if not match:
+            continue
+        function, length, values, stack = match.groups()
+        entry = results.setdefault(function, {}).setdefault(length or "-", {})
+        values = sorted(int(value) for value in values.split())
+        if stack:
+            entry["stack"] = values[0]
+        else:
+            entry["cycles"] = values[len(values) // 2]
+
+
+def run(args):
+    programs = [program.split("=", 1) for program in args.programs]
+    benchmarks, errors = {}, []
+    with concurrent.futures.ThreadPoolExecutor(max_workers=os.cpu_count()) as pool:
+        outputs = pool.map(lambda program: simulate(args.simavr, args.mcu, args.f_cpu, program[1]), programs)
+        for (name, elf), output in zip(programs, outputs):
+            parse(output, benchmarks.setdefault(name, {}), errors, name)
+
+    json.dump({"mcu": args.mcu, "f_cpu": args.f_cpu, "benchmarks": benchmarks, "errors": errors},
+              sys.stdout, indent=1, sort_keys=True)
+    print()
+    for error in errors:
+        print(error, file=sys.stderr)
+    return 1 if errors else 0
+
+
+def record(args):
+    programs = [program.split("=", 1) for program in args.programs]
+    with concurrent.futures.ThreadPoolExecutor(max_workers=os.cpu_count()) as pool:
+        outputs = pool.map(lambda program: simulate(args.simavr, args.mcu, args.f_cpu, program[1]), programs)
+        for (name, elf), output in zip(programs, outputs):
+            path = os.path.join(args.dir, name + ".out")
+            os.makedirs(os.path.dirname(path), exist_ok=True)
+            with open(path, "w") as f:
+                f.write(ESCAPE.sub("", output).replace("\x04", ""))
+    return 0
+
+
+def compare(args):
+    with open(args.old) as f:
+        old = json.load(f)["benchmarks"]
+    with open(args.new) as f:
+        new = json.load(f)["benchmarks"]
+
+    worse = 0
+    for name in sorted(set(old) & set(new)):
+        for function in sorted(set(old[name]) & set(new[name])):
+            for length in sorted(set(old[name][function]) & set(new[name][function]),
+                                 key=lambda length: int(length) if length.isdigit() else -1):
+                for key in ("cycles", "stack"):
+                    before = old[name][function][length].get(key)
+                    after = new[name][function][length].get(key)
+                    if not before or after is None:
+                        continue
+                    change = 100.0 * (after - before) / before
+                    if abs(change) > args.percent:
+                        print("%s %s [%s] %s: %d -> %d (%+.1f%%)" % (name, function, length, key, before, after,
+                                                                      change))
+                        if change > 0:
+                            worse += 1
+    for name in sorted(set(old) ^ set(new)):
+        print("%s: only in %s" % (name, args.old if name in old else args.new))
+    return 1 if worse else 0
+
+
+def main(argv):
+    parser = argparse.ArgumentParser(description=__doc__.split("\n\n")[0])
+    commands = parser.add_subparsers(dest="command")
+    run_parser = commands.add_parser("run")
+    run_parser.add_argument("--simavr", default="simavr")
+    run_parser.add_argument("--mcu", default="atmega328p")
+    run_parser.add_argument("--f-cpu", type=int, default=16000000)
+    run_parser.add_argument("programs", nargs="+", metavar="name=elf")
+    record_parser = commands.add_parser("record")
+    record_parser.add_argument("--simavr", default="simavr")
+    record_parser.add_argument("--mcu", default="atmega328p")
+    record_parser.add_argument("--f-cpu", type=int, default=16000000)
+    record_parser.add_argument("dir")
+    record_parser.add_argument("programs", nargs="+", metavar="name=elf")
+    compare_parser = commands.add_parser("compare")
+    compare_parser.add_argument("old")
+    compare_parser.add_argument("new")
+    compare_parser.add_argument("percent", nargs="?", type=float, default=1.0)
+    args = parser.parse_args(argv[1:])
+
+    if args.command == "run":
+        return run(args)
+    if args.command == "compare":
+        return compare(args)
+    if args.command == "record":
+        return record(args)
+    parser.print_usage(sys.stderr)
+    return 2
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))
@@ -0,0 +1,175 @@
+#!/usr/bin/env python3
+"""
+Build the message table of the binary log and decode captured logs.
+
+With LOG_BINARY each log message is sent as a record: 0x1e, the 16 bit message id
+and the arguments (see sketches/libraries/common/logging.h). The id is a hash of
+the format string, the table maps it back to the message. It is generated from the
+sources by the build (log-ids.json in the build directory).
+
+usage: log-decode.py table <source dir> [...] > log-ids.json
+       log-decode.py decode <log-ids.json> [<capture>]
+
+The capture is read from stdin if not given, e.g.:
+       cat /dev/cu.SLAB_USBtoUART | log-decode.py decode build/log-ids.json
+
+Copyright 2016 ubirch GmbH (http://www.ubirch.com)
+
+== LICENSE ==
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+"""
+
+import ast
+import json
+import os
+import re
+import struct
+import sys
+
+RECORD = 0x1e
+SOURCES = (".c", ".cpp", ".h", ".ino")
+
+# comments are dropped, strings are kept (they may contain "//")
+LEXICAL = re.compile(r'"(?:\\.|[^"\\])*"|\'(?:\\.|[^\'\\])*\'|//[^\n]*|/\*.*?\*/', re.S)
+CALL = re.compile(r'\bLOG_(ERROR|WARN|INFO|DEBUG)(_HEX)?\s*\(\s*((?:"(?:\\.|[^"\\])*"\s*)+)')
+LITERAL = re.compile(r'"(?:\\.|[^"\\])*"')
+SPEC = re.compile(r'%(l?)([udxcst%])')
+
+
+def log_id(text):
+    """FNV-1a folded to 16 bit, the same as log_id() in logging.h."""
+    value = 2166136261
+    for byte in text.encode("latin-1"):
+        value = ((value ^ byte) * 16777619) & 0xffffffff
+    return (value >> 16) ^ (value & 0xffff)
+
+
+def strip_comments(source):
+    # keep the line breaks of comments for the line numbers
+    return LEXICAL.sub(lambda m: "\n" * m.group(0).count("\n") or " " if m.group(0)[0] == "/" else m.group(0),
+                       source)
+
+
+def scan(directories):
+    """Find all log messages, returns {id: {level, format, hex, where}}."""
+    table = {}
+    for directory in directories:
+        for root, _, files in os.walk(directory):
+            for name in sorted(files):
+                if not name.endswith(SOURCES):
+                    continue
+                path = os.path.join(root, name)
+                with open(path, encoding="latin-1") as f:
+                    source = strip_comments(f.read())
+                for call in CALL.finditer(source):
+                    text = "".join(ast.literal_eval(s) for s in LITERAL.findall(call.group(3)))
+                    entry = {"level": call.group(1), "format": text, "hex": bool(call.group(2)),
+                             "where": "%s:%d" % (path, source.count("\n", 0, call.start()) + 1)}
+                    key = "%04x" % log_id(text)
+                    if key in table and table[key]["format"] != text:
+                        raise ValueError("message id collision: %s (%s) and %s (%s), reword one of them"
+                                         % (table[key]["where"], table[key]["format"], entry["where"], text))
+                    table.setdefault(key, entry)
+    return table
+
+
+class Capture:
+    """Reads a capture as it arrives, e.g. from a serial port."""
+
+    def __init__(self, stream):
+        self.stream = stream
+
+    def take(self, n):
+        chunk = self.stream.read(n)
+        if len(chunk) < n:
+            raise EOFError()
+        return chunk
+
+    def string(self):
+        chars = bytearray()
+        while True:
+            byte = self.take(1)
+            if byte == b"\0":
+                return chars.decode("latin-1")
+            chars += byte
+
+
+def format_record(entry, capture):
+    if entry["hex"]:
+        length = capture.take(1)[0]
+        return entry["format"] + capture.take(length).hex()
+
+    def argument(spec):
+        is_long, conversion = spec.group(1), spec.group(2)
+        if conversion == "%":
+            return "%"
+        if conversion == "s":
+            return capture.string()
+        if conversion == "t":
+            return capture.take(capture.take(1)[0]).decode("latin-1")
+        size = 4 if is_long else 2
+        value = int.from_bytes(capture.take(size), "little", signed=(conversion == "d"))
+        if conversion == "x":
+            return "%X" % value
+        if conversion == "c":
+            return chr(value & 0xff)
+        return str(value)
+
+    return SPEC.sub(argument, entry["format"])
+
+
+def decode(table, stream, out):
+    capture = Capture(stream)
+    while True:
+        byte = stream.read(1)
+        if not byte:
+            return
+        if byte[0] != RECORD:
+            out.write(byte.decode("latin-1"))
+            continue
+        try:
+            key = "%04x" % struct.unpack("<H", capture.take(2))[0]
+            if key not in table:
+                out.write("[?] unknown message id %s\n" % key)
+                continue
+            entry = table[key]
+            out.write("[%s] %s\n" % (entry["level"][0], format_record(entry, capture)))
+            out.flush()
+        except EOFError:
+            out.write("[?] truncated record\n")
+            return
+
+
+def main(argv):
+    if len(argv) >= 3 and argv[1] == "table":
+        try:
+            json.dump(scan(argv[2:]), sys.stdout, indent=1, sort_keys=True)
+        except ValueError as e:
+            print(e, file=sys.stderr)
+            return 1
+        return 0
+    if len(argv) in (3, 4) and argv[1] == "decode":
+        with open(argv[2]) as f:
+            table = json.load(f)
+        if len(argv) == 4:
+            with open(argv[3], "rb", buffering=0) as f:
+                decode(table, f, sys.stdout)
+        else:
+            decode(table, sys.stdin.buffer, sys.stdout)
+        return 0
+    print(__doc__.split("\n\n")[2], file=sys.stderr)
+    return 2
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))
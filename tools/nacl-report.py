@@ -0,0 +1,158 @@
+#!/usr/bin/env python3
+"""
+Report the flash, RAM and cycles of the avrnacl primitives in each variant.
+
+The build links a probe program for each primitive and variant and one for each
+avrnacl_library() (see sketches/libraries/avrnacl-20140813/CMakeLists.txt). The size
+of a primitive is the size of its probe minus the size of a probe without any
+primitive, it includes the internal code it needs (e.g. SHA-512 for Ed25519), so
+the sizes of several primitives do not add up. The cycles are the median of the
+runs at the longest message, taken from the bench.json of avr-bench.py (make bench)
+or else from the speed.log of avrnacl's run_speed.sh.
+
+The report is generated by the build (make nacl-report, nacl-report.md in the
+build directory).
+
+usage: nacl-report.py --size <avr-size> --baseline <elf> [--bench <bench.json>] [--speed <speed.log>]
+                      [--probe <variant> <primitive> <elf>]...
+                      [--library <name> <variants> <elf>]...
+
+Copyright 2016 ubirch GmbH (http://www.ubirch.com)
+
+== LICENSE ==
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+"""
+
+import argparse
+import json
+import os
+import re
+import subprocess
+import sys
+
+SECTION = re.compile(r"^===== Starting benchmark of avrnacl_(\w+)/(\w+) =====")
+SPEED = re.compile(r"^(\w+): (?:\[(\d+)\] )?([\d ]+)$")
+
+
+def size(tool, elf):
+    """@return flash and RAM (static) bytes of the program"""
+    output = subprocess.check_output([tool, elf], universal_newlines=True).splitlines()
+    text, data, bss = (int(value) for value in output[1].split()[:3])
+    return text + data, data + bss
+
+
+def median(values):
+    values = sorted(values)
+    return values[len(values) // 2]
+
+
+def read_speed(path):
+    """@return {(variant, primitive): [(bytes, cycles)]} of the main function of each benchmark"""
+    cycles = {}
+    if not path or not os.path.exists(path):
+        return cycles
+    section = None
+    with open(path, errors="replace") as f:
+        for line in f:
+            line = line.strip()
+            match = SECTION.match(line)
+            if match:
+                section = match.groups()
+                continue
+            match = SPEED.match(line)
+            if section and match and match.group(1) == section[1] and match.group(3).split():
+                length = int(match.group(2) or 0)
+                cycles.setdefault(section, []).append((length, median(int(c) for c in match.group(3).split())))
+    return cycles
+
+
+def read_bench(path):
+    """@return the cycles like read_speed() from the results of avr-bench.py"""
+    cycles = {}
+    if not path or not os.path.exists(path):
+        return cycles
+    with open(path) as f:
+        benchmarks = json.load(f)["benchmarks"]
+    for name, functions in benchmarks.items():
+        variant, _, benchmark = name.partition("/")
+        for length, result in functions.get(benchmark, {}).items():
+            if "cycles" in result:
+                cycles.setdefault((variant, benchmark), []).append((int(length) if length.isdigit() else 0,
+                                                                     result["cycles"]))
+    return cycles
+
+
+def format_cycles(cycles, variant, primitive):
+    """@return the cycles of the benchmarks of a primitive (crypto_verify has two)"""
+    cells = []
+    for (benchmark_variant, benchmark), runs in sorted(cycles.items()):
+        if benchmark_variant != variant or not benchmark.startswith(primitive):
+            continue
+        length, value = max(runs)
+        cells.append("%d" % value if length == 0 else "%d @%dB" % (value, length))
+    return " / ".join(cells) or "-"
+
+
+def main(argv):
+    parser = argparse.ArgumentParser(description=__doc__.split("\n\n")[0])
+    parser.add_argument("--size", required=True)
+    parser.add_argument("--baseline", required=True)
+    parser.add_argument("--bench")
+    parser.add_argument("--speed")
+    parser.add_argument("--probe", nargs=3, action="append", default=[])
+    parser.add_argument("--library", nargs=3, action="append", default=[])
+    args = parser.parse_args(argv[1:])
+
+    base_flash, base_ram = size(args.size, args.baseline)
+    cycles = read_bench(args.bench)
+    source = args.bench
+    if not cycles:
+        cycles = read_speed(args.speed)
+        source = args.speed
+
+    variants, primitives, sizes = [], [], {}
+    for variant, primitive, elf in args.probe:
+        if variant not in variants:
+            variants.append(variant)
+        if primitive not in primitives:
+            primitives.append(primitive)
+        flash, ram = size(args.size, elf)
+        sizes[variant, primitive] = (flash - base_flash, ram - base_ram)
+
+    print("# avrnacl flash/RAM/cycles")
+    print()
+    print("Flash and static RAM in bytes, including the internal code each primitive needs.")
+    print("Cycles from %s." % (os.path.basename(source) if cycles else "neither bench.json (make bench) nor speed.log"))
+    print()
+    print("| primitive | " + " | ".join("%s flash | %s RAM | %s cycles" % ((v,) * 3) for v in variants) + " |")
+    print("|---|" + "---:|---:|---:|" * len(variants))
+    for primitive in primitives:
+        cells = []
+        for variant in variants:
+            flash, ram = sizes[variant, primitive]
+            cells += [str(flash), str(ram), format_cycles(cycles, variant, primitive)]
+        print("| %s | %s |" % (primitive, " | ".join(cells)))
+
+    if args.library:
+        print()
+        print("| library | variants | flash | RAM |")
+        print("|---|---|---:|---:|")
+        for name, description, elf in args.library:
+            flash, ram = size(args.size, elf)
+            print("| %s | %s | %d | %d |" % (name, description.replace(",", ", ").replace("=", " "),
+                                             flash - base_flash, ram - base_ram))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))
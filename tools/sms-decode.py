@@ -0,0 +1,117 @@
+#!/usr/bin/env python3
+"""
+Decode binary SMS fallback messages of the ubirch lights sensor.
+
+The message layout is described in sketches/libraries/sms-uplink/sms_uplink.h. Each
+record is printed as a JSON payload in the same format the sensor uses for HTTP.
+The MAC is checked with the device key (the UPLINK_KEY of tools/uplink-key.py).
+
+usage: sms-decode.py <hex key> <hex user data> [...]
+       echo <hex user data> | sms-decode.py <hex key>
+
+Copyright 2016 ubirch GmbH (http://www.ubirch.com)
+
+== LICENSE ==
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+"""
+
+import hashlib
+import hmac
+import json
+import struct
+import sys
+
+# versions 1 and 2 were not tagged with the device key and are rejected
+FORMAT_VERSIONS = (3,)
+TYPE_SENSOR = 1
+
+HEADER_BYTES = 10
+MAC_BYTES = 8
+KEY_BYTES = 32
+NO_LOCATION = -2 ** 31
+# seconds between 1970-01-01 and 2000-01-01
+UNIX_OFFSET = 946684800
+
+SENSOR_RECORD = struct.Struct(">HIHHHBBBii")
+FLAG_10KLUX = 0x01
+
+
+def fixed6(value):
+    if value == NO_LOCATION:
+        return ""
+    sign = "-" if value < 0 else ""
+    value = abs(value)
+    return "%s%d.%06d" % (sign, value // 1000000, value % 1000000)
+
+
+def decode(key, data):
+    """Decode and verify a message with the device key, returns the IMEI and a list of payload dicts."""
+    if len(data) < HEADER_BYTES + MAC_BYTES:
+        raise ValueError("message too short")
+
+    version, record_type = data[0] >> 4, data[0] & 0x0f
+    if version not in FORMAT_VERSIONS:
+        raise ValueError("unknown format version %d" % version)
+    if record_type != TYPE_SENSOR:
+        raise ValueError("unknown record type %d" % record_type)
+
+    imei = data[1:9].hex()[:15]
+    count = data[9]
+    end = HEADER_BYTES + count * SENSOR_RECORD.size
+    if len(data) != end + MAC_BYTES:
+        raise ValueError("length mismatch: %d records in %d bytes" % (count, len(data)))
+
+    # HMAC-SHA512-256 of IMEI{DATA}, truncated
+    mac = hmac.new(key, imei.encode("ascii") + data[:end], hashlib.sha512).digest()[:MAC_BYTES]
+    if not hmac.compare_digest(mac, data[end:]):
+        raise ValueError("MAC does not match")
+
+    records = []
+    for offset in range(HEADER_BYTES, end, SENSOR_RECORD.size):
+        loop, time, red, green, blue, flags, battery, error, lat, lon = SENSOR_RECORD.unpack_from(data, offset)
+        payload = {
+            "r": red, "g": green, "b": blue,
+            "s": 1 if flags & FLAG_10KLUX else 0,
+            "la": fixed6(lat), "lo": fixed6(lon),
+            "ba": battery, "lp": loop, "e": error
+        }
+        if time:
+            payload["ts"] = time + UNIX_OFFSET
+        records.append(payload)
+    return imei, records
+
+
+def main(args):
+    if not args:
+        sys.stderr.write("usage: sms-decode.py <hex key> [<hex user data> ...]\n")
+        return 2
+    key = bytes.fromhex(args[0])
+    if len(key) != KEY_BYTES:
+        sys.stderr.write("the key must be %d bytes\n" % KEY_BYTES)
+        return 2
+    messages = args[1:] if len(args) > 1 else sys.stdin.read().split()
+    status = 0
+    for message in messages:
+        try:
+            imei, records = decode(key, bytes.fromhex(message))
+        except ValueError as e:
+            sys.stderr.write("%s: %s\n" % (message, e))
+            status = 1
+            continue
+        for record in records:
+            print(json.dumps({"a": imei, "p": record}, separators=(",", ":")))
+    return status
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv[1:]))
@@ -0,0 +1,190 @@
+#!/usr/bin/env python3
+"""
+Generate keys for and open the encrypted uplink of the ubirch lights sketches.
+
+With UPLINK_BOX the sketches send
+{"v":"0.2.1","id":"<IMEI>","np":"<prefix>","n":<counter>,"c":"<box>"}, the box is
+the base64 encoded crypto_box (Curve25519, XSalsa20, Poly1305) of IMEI{PAYLOAD}
+without its zero bytes: the 16 byte tag followed by the ciphertext. The nonce is
+0x75 ('u'), the 19 byte prefix (random, drawn after each reset of the device) and
+the counter (32 bit, big endian). The counter increases with each message, a
+backend must reject counters it has seen. Messages of version 0.2.0 have no prefix,
+their nonce has 19 zero bytes instead.
+
+usage: uplink-box.py keypair
+       uplink-box.py open <hex backend secret key> <hex device public key> <message> [...]
+       echo <message> | uplink-box.py open <hex backend secret key> <hex device public key>
+
+keypair prints a secret and a public key in hex and as a C initializer, once for the
+backend and once for each device (UPLINK_BOX_SECRET, UPLINK_BOX_PEER in config.h).
+open prints the counter and payload of each message and fails if one does not verify.
+This is plain Python for checking messages, it is neither fast nor constant time.
+
+Copyright 2016 ubirch GmbH (http://www.ubirch.com)
+
+== LICENSE ==
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+"""
+
+import argparse
+import base64
+import hmac
+import json
+import os
+import re
+import struct
+import sys
+
+KEY_BYTES = 32
+TAG_BYTES = 16
+DIRECTION = 0x75
+IMEI_LEN = 15
+PREFIX_BYTES = 19
+
+MESSAGE = re.compile(r'^\{"v":"0\.2\.\d+","id":"(\d{15})",(?:"np":"([A-Za-z0-9+/=]+)",)?"n":(\d+),'
+                     r'"c":"([A-Za-z0-9+/=]+)"\}$')
+
+P = 2 ** 255 - 19
+SIGMA = b"expand 32-byte k"
+
+
+def x25519(k, u):
+    """Curve25519 scalar multiplication (RFC 7748)"""
+    k = bytearray(k)
+    k[0] &= 248
+    k[31] = (k[31] & 127) | 64
+    k = int.from_bytes(k, "little")
+    x1 = int.from_bytes(u, "little") & (2 ** 255 - 1)
+    x2, z2, x3, z3, swap = 1, 0, x1, 1, 0
+    for t in reversed(range(255)):
+        bit = (k >> t) & 1
+        swap ^= bit
+        if swap:
+            x2, x3, z2, z3 = x3, x2, z3, z2
+        swap = bit
+        a, b = (x2 + z2) % P, (x2 - z2) % P
+        aa, bb = a * a % P, b * b % P
+        e = (aa - bb) % P
+        c, d = (x3 + z3) % P, (x3 - z3) % P
+        da, cb = d * a % P, c * b % P
+        x3, z3 = (da + cb) ** 2 % P, x1 * (da - cb) ** 2 % P
+        x2, z2 = aa * bb % P, e * (aa + 121665 * e) % P
+    if swap:
+        x2, z2 = x3, z3
+    return (x2 * pow(z2, P - 2, P) % P).to_bytes(32, "little")
+
+
+def _rounds(x):
+    def rotate(v, c):
+        return ((v << c) | (v >> (32 - c))) & 0xffffffff
+
+    def quarter(a, b, c, d):
+        x[b] ^= rotate((x[a] + x[d]) & 0xffffffff, 7)
+        x[c] ^= rotate((x[b] + x[a]) & 0xffffffff, 9)
+        x[d] ^= rotate((x[c] + x[b]) & 0xffffffff, 13)
+        x[a] ^= rotate((x[d] + x[c]) & 0xffffffff, 18)
+
+    for _ in range(10):
+        quarter(0, 4, 8, 12), quarter(5, 9, 13, 1), quarter(10, 14, 2, 6), quarter(15, 3, 7, 11)
+        quarter(0, 1, 2, 3), quarter(5, 6, 7, 4), quarter(10, 11, 8, 9), quarter(15, 12, 13, 14)
+    return x
+
+
+def _input(k, n):
+    c = struct.unpack("<4I", SIGMA)
+    k = struct.unpack("<8I", k)
+    n = struct.unpack("<4I", n)
+    return [c[0], k[0], k[1], k[2], k[3], c[1], n[0], n[1], n[2], n[3], c[2], k[4], k[5], k[6], k[7], c[3]]
+
+
+def hsalsa20(k, n):
+    x = _rounds(_input(k, n))
+    return struct.pack("<8I", *(x[i] for i in (0, 5, 10, 15, 6, 7, 8, 9)))
+
+
+def xsalsa20(k, n, length):
+    k = hsalsa20(k, n[:16])
+    stream = b""
+    for block in range((length + 63) // 64):
+        j = _input(k, n[16:] + struct.pack("<Q", block))
+        x = _rounds(list(j))
+        stream += struct.pack("<16I", *((a + b) & 0xffffffff for a, b in zip(x, j)))
+    return stream[:length]
+
+
+def poly1305(k, m):
+    r = int.from_bytes(k[:16], "little") & 0x0ffffffc0ffffffc0ffffffc0fffffff
+    s = int.from_bytes(k[16:], "little")
+    h, p = 0, 2 ** 130 - 5
+    for i in range(0, len(m), 16):
+        h = (h + int.from_bytes(m[i:i + 16] + b"\x01", "little")) * r % p
+    return ((h + s) % 2 ** 128).to_bytes(16, "little")
+
+
+def open_box(shared, prefix, counter, box):
+    """@return the plaintext of a box (tag and ciphertext) if it verifies"""
+    if len(prefix) != PREFIX_BYTES:
+        raise ValueError("the nonce prefix must be %d bytes" % PREFIX_BYTES)
+    nonce = bytes([DIRECTION]) + prefix + struct.pack(">I", counter)
+    stream = xsalsa20(shared, nonce, 32 + len(box) - TAG_BYTES)
+    tag, ciphertext = box[:TAG_BYTES], box[TAG_BYTES:]
+    if not hmac.compare_digest(poly1305(stream[:32], ciphertext), tag):
+        raise ValueError("box does not verify")
+    return bytes(a ^ b for a, b in zip(ciphertext, stream[32:]))
+
+
+def main(argv):
+    parser = argparse.ArgumentParser(description=__doc__.split("\n\n")[0])
+    commands = parser.add_subparsers(dest="command")
+    commands.add_parser("keypair")
+    open_parser = commands.add_parser("open")
+    open_parser.add_argument("secret_key")
+    open_parser.add_argument("public_key")
+    open_parser.add_argument("messages", nargs="*")
+    args = parser.parse_args(argv[1:])
+
+    if args.command == "keypair":
+        secret = os.urandom(KEY_BYTES)
+        public = x25519(secret, (9).to_bytes(32, "little"))
+        for name, key in (("secret", secret), ("public", public)):
+            print("%s %s" % (name, key.hex()))
+            print("  " + ", ".join("0x%02x" % b for b in key))
+        return 0
+    if args.command == "open":
+        secret, public = bytes.fromhex(args.secret_key), bytes.fromhex(args.public_key)
+        if len(secret) != KEY_BYTES or len(public) != KEY_BYTES:
+            parser.error("the keys must be %d bytes" % KEY_BYTES)
+        shared = hsalsa20(x25519(secret, public), bytes(16))
+        status = 0
+        for message in args.messages or [line for line in sys.stdin.read().splitlines() if line.strip()]:
+            try:
+                match = MESSAGE.match(message.strip())
+                if not match:
+                    raise ValueError("not an encrypted uplink message")
+                imei, counter, box = match.group(1), int(match.group(3)), base64.b64decode(match.group(4))
+                prefix = base64.b64decode(match.group(2)) if match.group(2) else bytes(PREFIX_BYTES)
+                plaintext = open_box(shared, prefix, counter, box).decode("ascii")
+                if plaintext[:IMEI_LEN] != imei:
+                    raise ValueError("IMEI does not match")
+                print(json.dumps({"imei": imei, "counter": counter, "payload": json.loads(plaintext[IMEI_LEN:])},
+                                 sort_keys=True))
+            except ValueError as e:
+                print("%s: %s" % (message[:40], e), file=sys.stderr)
+                status = 1
+        return status
+    parser.print_usage(sys.stderr)
+    return 2
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))
@@ -0,0 +1,95 @@
+#!/usr/bin/env python3
+"""
+Generate device keys and verify the authenticated uplink of the ubirch lights sketches.
+
+With UPLINK_HMAC the sketches send {"v":"0.1.0","id":"<IMEI>","m":"<tag>","p":{...}},
+the tag is the base64 encoded HMAC-SHA512-256 (the first 32 bytes of HMAC-SHA512) of
+IMEI{PAYLOAD} with the device key, PAYLOAD being the text of "p" as it was sent.
+
+usage: uplink-key.py new
+       uplink-key.py verify <hex key> <message> [...]
+       echo <message> | uplink-key.py verify <hex key>
+
+new prints a random key in hex and as UPLINK_KEY for config.h. verify prints the
+payload of each message and fails if a tag does not match.
+
+Copyright 2016 ubirch GmbH (http://www.ubirch.com)
+
+== LICENSE ==
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+"""
+
+import argparse
+import base64
+import hashlib
+import hmac
+import json
+import os
+import re
+import sys
+
+KEY_BYTES = 32
+TAG_BYTES = 32
+
+# the payload is authenticated as sent, so it is taken from the text and not re-serialized
+MESSAGE = re.compile(r'^\{"v":"0\.1\.\d+","id":"(\d{15})","m":"([A-Za-z0-9+/=]+)","p":(\{.*\})\}$')
+
+
+def tag(key, imei, payload):
+    return hmac.new(key, (imei + payload).encode("ascii"), hashlib.sha512).digest()[:TAG_BYTES]
+
+
+def verify(key, message):
+    """@return the IMEI and payload of a message if its tag matches"""
+    match = MESSAGE.match(message.strip())
+    if not match:
+        raise ValueError("not an authenticated uplink message")
+    imei, received, payload = match.groups()
+    if not hmac.compare_digest(tag(key, imei, payload), base64.b64decode(received)):
+        raise ValueError("tag does not match")
+    return imei, json.loads(payload)
+
+
+def main(argv):
+    parser = argparse.ArgumentParser(description=__doc__.split("\n\n")[0])
+    commands = parser.add_subparsers(dest="command")
+    commands.add_parser("new")
+    verify_parser = commands.add_parser("verify")
+    verify_parser.add_argument("key")
+    verify_parser.add_argument("messages", nargs="*")
+    args = parser.parse_args(argv[1:])
+
+    if args.command == "new":
+        key = os.urandom(KEY_BYTES)
+        print(key.hex())
+        print("#define UPLINK_KEY " + ", ".join("0x%02x" % b for b in key))
+        return 0
+    if args.command == "verify":
+        key = bytes.fromhex(args.key)
+        if len(key) != KEY_BYTES:
+            parser.error("the key must be %d bytes" % KEY_BYTES)
+        status = 0
+        for message in args.messages or [line for line in sys.stdin.read().splitlines() if line.strip()]:
+            try:
+                imei, payload = verify(key, message)
+                print(json.dumps({"imei": imei, "payload": payload}, sort_keys=True))
+            except ValueError as e:
+                print("%s: %s" % (message[:40], e), file=sys.stderr)
+                status = 1
+        return status
+    parser.print_usage(sys.stderr)
+    return 2
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))